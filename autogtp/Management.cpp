@@ -265,6 +265,8 @@ QString Management::getOptionsString(const QJsonObject& opt,
     QString options;
     options.append(getOption(opt, "playouts", " -p ", ""));
     options.append(getOption(opt, "visits", " -v ", ""));
+    options.append(getOption(opt, "full_search_prob", " --fullsearchprob ", ""));
+    options.append(getOption(opt, "fast_visits", " --fastvisits ", ""));
     options.append(getOption(opt, "resignation_percent", " -r ", "1"));
     options.append(getOption(opt, "randomcnt", " -m ", "30"));
     options.append(getOption(opt, "threads", " -t ", "6"));
@@ -31,7 +31,7 @@
 
 #include "Worker.h"
 
-constexpr int AUTOGTP_VERSION = 18;
+constexpr int AUTOGTP_VERSION = 19;
 
 class Management : public QObject {
     Q_OBJECT
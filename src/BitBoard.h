@@ -0,0 +1,182 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef BITBOARD_H_INCLUDED
+#define BITBOARD_H_INCLUDED
+
+#include "config.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+/*
+    Set of vertices in the letterboxed board layout of FastBoard, one bit
+    per vertex.  Neighbours are bit shifts by 1 and by the row stride, and
+    the letterbox border keeps them from wrapping around rows.  All
+    operations are plain loops over a few words, which the compiler
+    vectorizes.
+*/
+class BitBoard {
+public:
+    static constexpr auto NUM_BITS = (BOARD_SIZE + 2) * (BOARD_SIZE + 2);
+    static constexpr auto WORDS = (NUM_BITS + 63) / 64;
+
+    void set(const int vertex) {
+        m_words[vertex / 64] |= std::uint64_t{1} << (vertex % 64);
+    }
+    void reset(const int vertex) {
+        m_words[vertex / 64] &= ~(std::uint64_t{1} << (vertex % 64));
+    }
+    bool test(const int vertex) const {
+        return (m_words[vertex / 64] >> (vertex % 64)) & 1;
+    }
+    void clear() {
+        m_words.fill(0);
+    }
+
+    bool any() const {
+        for (const auto word : m_words) {
+            if (word) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Lowest vertex in the set, which must not be empty.
+    int first() const {
+        for (auto i = 0; i < WORDS; i++) {
+            if (m_words[i]) {
+                return i * 64 + lowest_bit(m_words[i]);
+            }
+        }
+        return -1;
+    }
+
+    int count() const {
+        auto bits = 0;
+        for (const auto word : m_words) {
+            bits += std::bitset<64>(word).count();
+        }
+        return bits;
+    }
+
+    // Calls f(vertex) for every vertex in the set, lowest first.
+    template <typename Function>
+    void for_each(Function f) const {
+        for (auto i = 0; i < WORDS; i++) {
+            auto word = m_words[i];
+            while (word) {
+                f(i * 64 + lowest_bit(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    bool operator==(const BitBoard& rhs) const {
+        return m_words == rhs.m_words;
+    }
+    bool operator!=(const BitBoard& rhs) const {
+        return m_words != rhs.m_words;
+    }
+
+    BitBoard operator|(const BitBoard& rhs) const {
+        auto res = BitBoard{};
+        for (auto i = 0; i < WORDS; i++) {
+            res.m_words[i] = m_words[i] | rhs.m_words[i];
+        }
+        return res;
+    }
+    BitBoard operator&(const BitBoard& rhs) const {
+        auto res = BitBoard{};
+        for (auto i = 0; i < WORDS; i++) {
+            res.m_words[i] = m_words[i] & rhs.m_words[i];
+        }
+        return res;
+    }
+
+    // Vertices in this set but not in rhs.
+    BitBoard and_not(const BitBoard& rhs) const {
+        auto res = BitBoard{};
+        for (auto i = 0; i < WORDS; i++) {
+            res.m_words[i] = m_words[i] & ~rhs.m_words[i];
+        }
+        return res;
+    }
+
+    // Vertices next to any vertex in the set, on a board 'stride'
+    // vertices wide.  Includes the set itself.
+    BitBoard dilate(const int stride) const {
+        auto res = *this;
+        for (auto shift : {1, stride}) {
+            auto carry_up = std::uint64_t{0};
+            auto carry_down = std::uint64_t{0};
+            for (auto i = 0; i < WORDS; i++) {
+                const auto j = WORDS - 1 - i;
+                res.m_words[i] |= (m_words[i] << shift) | carry_up;
+                carry_up = m_words[i] >> (64 - shift);
+                res.m_words[j] |= (m_words[j] >> shift) | carry_down;
+                carry_down = m_words[j] << (64 - shift);
+            }
+        }
+        return res;
+    }
+
+    // Grow the set through the vertices in 'mask' until it stops
+    // changing.
+    BitBoard flood_fill(const BitBoard& mask, const int stride) const {
+        auto res = *this;
+        auto prev = BitBoard{};
+        while (res != prev) {
+            prev = res;
+            res = res.dilate(stride) & mask;
+        }
+        return res | *this;
+    }
+
+private:
+    static int lowest_bit(const std::uint64_t word) {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, word);
+        return index;
+#else
+        return __builtin_ctzll(word);
+#endif
+    }
+
+    std::array<std::uint64_t, WORDS> m_words{};
+};
+
+#endif
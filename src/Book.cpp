@@ -0,0 +1,291 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <unordered_set>
+
+#include "Book.h"
+
+#include "FastBoard.h"
+#include "GTP.h"
+#include "Random.h"
+#include "Training.h"
+#include "UCTSearch.h"
+#include "Utils.h"
+
+using namespace Utils;
+
+static constexpr char BOOK_MAGIC[4] = {'L', 'Z', 'B', 'K'};
+
+constexpr int Book::MAX_MOVES;
+constexpr float Book::EXPAND_SHARE;
+constexpr std::uint32_t Book::VERSION;
+
+Book::Book(const std::string& filename)
+    : m_file(filename.c_str(), boost::interprocess::read_only),
+      m_region(m_file, boost::interprocess::read_only) {
+    const auto bytes = m_region.get_size();
+    if (bytes < sizeof(Header)) {
+        throw std::runtime_error("Book file is truncated.");
+    }
+    m_header = static_cast<const Header*>(m_region.get_address());
+    if (std::memcmp(m_header->magic, BOOK_MAGIC, sizeof(BOOK_MAGIC)) != 0
+        || m_header->version != VERSION) {
+        throw std::runtime_error("Not a book file of a supported version.");
+    }
+    // Checked by division, a huge count could make the product wrap.
+    if ((bytes - sizeof(Header)) % sizeof(Entry) != 0
+        || m_header->count != (bytes - sizeof(Header)) / sizeof(Entry)) {
+        throw std::runtime_error("Book file is truncated.");
+    }
+    m_entries = reinterpret_cast<const Entry*>(m_header + 1);
+}
+
+size_t Book::size() const {
+    return m_header->count;
+}
+
+int Book::get_inverse_symmetry(const int symmetry) {
+    // Flips are their own inverse. Once the axes are swapped as well,
+    // undoing the flip of x means flipping y and vice versa.
+    if ((symmetry & 4) == 0) {
+        return symmetry;
+    }
+    return 4 | ((symmetry & 1) << 1) | ((symmetry & 2) >> 1);
+}
+
+std::uint64_t Book::canonical_hash(const GameState& state, int& symmetry) {
+    symmetry = Network::IDENTITY_SYMMETRY;
+    auto hash = state.get_symmetry_hash(symmetry);
+    for (auto sym = 1; sym < Network::NUM_SYMMETRIES; sym++) {
+        const auto sym_hash = state.get_symmetry_hash(sym);
+        if (sym_hash < hash) {
+            hash = sym_hash;
+            symmetry = sym;
+        }
+    }
+    return hash;
+}
+
+bool Book::probe(const GameState& state, Moves& moves) const {
+    const auto board_size = state.board.get_boardsize();
+    if (board_size != int(m_header->board_size)
+        || state.get_komi() != m_header->komi) {
+        return false;
+    }
+
+    auto symmetry = 0;
+    const auto hash = canonical_hash(state, symmetry);
+    const auto last = m_entries + m_header->count;
+    const auto entry =
+        std::lower_bound(m_entries, last, hash,
+                         [](const Entry& entry, const std::uint64_t hash) {
+                             return entry.hash < hash;
+                         });
+    if (entry == last || entry->hash != hash) {
+        return false;
+    }
+
+    const auto inverse = get_inverse_symmetry(symmetry);
+    moves.winrate = entry->winrate;
+    moves.visits.clear();
+    for (const auto& move : entry->moves) {
+        if (move.index < 0) {
+            break;
+        }
+        auto vertex = int{FastBoard::PASS};
+        if (move.index < board_size * board_size) {
+            vertex = state.board.get_vertex(move.index % board_size,
+                                            move.index / board_size);
+            vertex = state.board.get_symmetric_vertex(vertex, inverse);
+        }
+        moves.visits.emplace_back(vertex, move.visits);
+    }
+    return !moves.visits.empty();
+}
+
+int Book::pick_move(const GameState& state,
+                    const std::vector<std::pair<int, int>>& visits) {
+    assert(!visits.empty());
+
+    auto total = 0.0;
+    for (const auto& move : visits) {
+        total += move.second;
+    }
+    auto weights = std::vector<double>{};
+    for (const auto& move : visits) {
+        weights.emplace_back(move.second / total);
+    }
+
+    if (cfg_noise) {
+        // The same noise the search puts on the root priors, so self-play
+        // games still branch out of the book.
+        const auto board_size = state.board.get_boardsize();
+        const auto alpha = 0.03 * 361.0 / (board_size * board_size);
+        auto gamma = std::gamma_distribution<double>{alpha, 1.0};
+        auto noise = std::vector<double>{};
+        auto noise_sum = 0.0;
+        for (size_t i = 0; i < weights.size(); i++) {
+            noise.emplace_back(gamma(Random::get_Rng()));
+            noise_sum += noise.back();
+        }
+        if (noise_sum >= std::numeric_limits<double>::min()) {
+            for (size_t i = 0; i < weights.size(); i++) {
+                weights[i] = 0.75 * weights[i] + 0.25 * noise[i] / noise_sum;
+            }
+        }
+    }
+
+    if (state.get_movenum() < size_t(cfg_random_cnt)) {
+        for (auto& weight : weights) {
+            weight = std::pow(weight, 1.0 / cfg_random_temp);
+        }
+        auto distribution =
+            std::discrete_distribution<size_t>{begin(weights), end(weights)};
+        return visits[distribution(Random::get_Rng())].first;
+    }
+
+    const auto best = std::max_element(begin(weights), end(weights));
+    return visits[std::distance(begin(weights), best)].first;
+}
+
+bool Book::build(const GameState& root, Network& network,
+                 const std::string& filename, const int plies) {
+    const auto board_size = root.board.get_boardsize();
+    auto to_index = [board_size, &root](const int vertex, const int sym) {
+        if (vertex == FastBoard::PASS) {
+            return board_size * board_size;
+        }
+        const auto xy =
+            root.board.get_xy(root.board.get_symmetric_vertex(vertex, sym));
+        return xy.second * board_size + xy.first;
+    };
+
+    auto entries = std::vector<Entry>{};
+    auto seen = std::unordered_set<std::uint64_t>{};
+    auto queue = std::deque<GameState>{};
+    auto symmetry = 0;
+    if (root.get_movenum() < size_t(plies)) {
+        seen.emplace(canonical_hash(root, symmetry));
+        queue.emplace_back(root);
+    }
+
+    while (!queue.empty()) {
+        auto state = std::move(queue.front());
+        queue.pop_front();
+
+        const auto color = state.get_to_move();
+        auto search = std::make_unique<UCTSearch>(state, network);
+        search->think(color);
+        // Book positions are not training data.
+        Training::clear_training();
+
+        const auto& node = search->get_root();
+        auto children = std::vector<std::pair<int, std::int64_t>>{};
+        auto total = std::int64_t{0};
+        for (const auto& child : node.get_children()) {
+            if (child->get_visits() > 0) {
+                children.emplace_back(child->get_move(), child->get_visits());
+                total += child->get_visits();
+            }
+        }
+        if (children.empty()) {
+            continue;
+        }
+        std::stable_sort(begin(children), end(children),
+                         [](const auto& a, const auto& b) {
+                             return a.second > b.second;
+                         });
+
+        auto entry = Entry{};
+        entry.hash = canonical_hash(state, symmetry);
+        entry.winrate = node.get_eval(color);
+        entry.visits = total;
+        for (auto i = size_t{0}; i < size_t(MAX_MOVES); i++) {
+            auto& move = entry.moves[i];
+            if (i < children.size()) {
+                move.index = to_index(children[i].first, symmetry);
+                move.visits = children[i].second;
+            } else {
+                move.index = -1;
+                move.visits = 0;
+            }
+        }
+        entries.emplace_back(entry);
+
+        if (state.get_movenum() + 1 < size_t(plies)) {
+            for (const auto& child : children) {
+                if (child.first == FastBoard::PASS
+                    || child.second < EXPAND_SHARE * total) {
+                    continue;
+                }
+                auto next = state;
+                next.play_move(child.first);
+                if (seen.emplace(canonical_hash(next, symmetry)).second) {
+                    queue.emplace_back(std::move(next));
+                }
+            }
+        }
+        myprintf("Book: %zu positions searched, %zu queued.\n",
+                 entries.size(), queue.size());
+    }
+
+    std::sort(begin(entries), end(entries),
+              [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+
+    auto header = Header{};
+    std::copy(std::begin(BOOK_MAGIC), std::end(BOOK_MAGIC), header.magic);
+    header.version = VERSION;
+    header.board_size = board_size;
+    header.komi = root.get_komi();
+    header.count = entries.size();
+
+    auto out = std::ofstream{filename, std::ios::out | std::ios::binary};
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(entries.data()),
+              entries.size() * sizeof(Entry));
+    out.close();
+    if (out.fail()) {
+        myprintf("Could not write book file: %s\n", filename.c_str());
+        return false;
+    }
+    myprintf("Wrote %zu positions to %s.\n", entries.size(), filename.c_str());
+    return true;
+}
@@ -0,0 +1,121 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef BOOK_H_INCLUDED
+#define BOOK_H_INCLUDED
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "GameState.h"
+#include "Network.h"
+
+/*
+    Opening book built from deep searches. The file is a sorted array of
+    fixed-size entries that is memory mapped as is, so loading is free and
+    several engine processes on one machine share the pages.
+
+    Positions are keyed by the smallest of their symmetric hashes, and moves
+    are stored in the orientation that hash belongs to, so one entry serves
+    all eight orientations of a position.
+*/
+class Book {
+public:
+    // Moves stored per position, most visited first.
+    static constexpr auto MAX_MOVES = 8;
+    // Children receiving at least this share of the visits are searched
+    // in turn when building a book.
+    static constexpr auto EXPAND_SHARE = 0.1f;
+
+    struct Moves {
+        float winrate;
+        // Pairs of vertex and visits, in the orientation of the probed state.
+        std::vector<std::pair<int, int>> visits;
+    };
+
+    explicit Book(const std::string& filename);
+
+    // Returns false if the position is not in the book.
+    bool probe(const GameState& state, Moves& moves) const;
+    size_t size() const;
+
+    // Picks a move from book visits, randomized like a search
+    // result would be.
+    static int pick_move(const GameState& state,
+                         const std::vector<std::pair<int, int>>& visits);
+
+    // Searches every position reachable through book moves within the
+    // first plies moves of root and writes the results to filename.
+    static bool build(const GameState& root, Network& network,
+                      const std::string& filename, int plies);
+
+private:
+    static constexpr std::uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        std::uint32_t version;
+        std::uint32_t board_size;
+        float komi;
+        std::uint64_t count;
+    };
+
+    struct BookMove {
+        // Row-major index in the canonical orientation, board_size^2
+        // for pass and -1 for unused slots.
+        std::int16_t index;
+        std::uint16_t padding;
+        std::uint32_t visits;
+    };
+
+    struct Entry {
+        std::uint64_t hash;
+        float winrate;
+        std::uint32_t visits;
+        BookMove moves[MAX_MOVES];
+    };
+
+    static std::uint64_t canonical_hash(const GameState& state,
+                                        int& symmetry);
+    static int get_inverse_symmetry(int symmetry);
+
+    boost::interprocess::file_mapping m_file;
+    boost::interprocess::mapped_region m_region;
+    const Header* m_header;
+    const Entry* m_entries;
+};
+
+#endif
@@ -56,16 +56,18 @@ using ConstEigenMatrixMap =
     Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
 #endif
 
-void CPUPipe::initialize(int channels) {
+void CPUPipe::initialize(const int channels, const int board_size) {
     m_input_channels = channels;
+    m_board_size = board_size;
 }
 
+template <int board_size>
 void CPUPipe::winograd_transform_in(const std::vector<float>& in,
                                     std::vector<float>& V, const int C) {
-    constexpr auto W = BOARD_SIZE;
-    constexpr auto H = BOARD_SIZE;
-    constexpr auto WTILES = WINOGRAD_WTILES;
-    constexpr auto P = WINOGRAD_P;
+    constexpr auto W = board_size;
+    constexpr auto H = board_size;
+    constexpr auto WTILES = winograd_wtiles(board_size);
+    constexpr auto P = WTILES * WTILES;
 
     constexpr auto Wpad = 2 + WINOGRAD_M * WTILES;
 
@@ -182,11 +184,13 @@ void CPUPipe::winograd_transform_in(const std::vector<float>& in,
     }
 }
 
+template <int board_size>
 void CPUPipe::winograd_sgemm(const std::vector<float>& U,
                              const std::vector<float>& V,
                              std::vector<float>& M,
                              const int C, const int K) {
-    constexpr auto P = WINOGRAD_P;
+    constexpr auto WTILES = winograd_wtiles(board_size);
+    constexpr auto P = WTILES * WTILES;
 
     for (auto b = 0; b < WINOGRAD_TILE; b++) {
         const auto offset_u = b * K * C;
@@ -209,12 +213,13 @@ void CPUPipe::winograd_sgemm(const std::vector<float>& U,
     }
 }
 
+template <int board_size>
 void CPUPipe::winograd_transform_out(const std::vector<float>& M,
                                      std::vector<float>& Y, const int K) {
-    constexpr auto W = BOARD_SIZE;
-    constexpr auto H = BOARD_SIZE;
-    constexpr auto WTILES = WINOGRAD_WTILES;
-    constexpr auto P = WINOGRAD_P;
+    constexpr auto W = board_size;
+    constexpr auto H = board_size;
+    constexpr auto WTILES = winograd_wtiles(board_size);
+    constexpr auto P = WTILES * WTILES;
 
     // multiple vector [i0..i5] by At and produce [o0..o3]
     // const auto At = std::array<float, WINOGRAD_ALPHA * WINOGRAD_M>{
@@ -283,6 +288,7 @@ void CPUPipe::winograd_transform_out(const std::vector<float>& M,
     }
 }
 
+template <int board_size>
 void CPUPipe::winograd_convolve3(const int outputs,
                                  const std::vector<float>& input,
                                  const std::vector<float>& U,
@@ -293,20 +299,19 @@ void CPUPipe::winograd_convolve3(const int outputs,
     constexpr unsigned int filter_len = WINOGRAD_ALPHA * WINOGRAD_ALPHA;
     const auto input_channels = U.size() / (outputs * filter_len);
 
-    winograd_transform_in(input, V, input_channels);
-    winograd_sgemm(U, V, M, input_channels, outputs);
-    winograd_transform_out(M, output, outputs);
+    winograd_transform_in<board_size>(input, V, input_channels);
+    winograd_sgemm<board_size>(U, V, M, input_channels, outputs);
+    winograd_transform_out<board_size>(M, output, outputs);
 }
 
-template <unsigned int filter_size>
+template <unsigned int filter_size, unsigned int board_size>
 void convolve(const size_t outputs,
               const std::vector<float>& input,
               const std::vector<float>& weights,
               const std::vector<float>& biases,
               std::vector<float>& output) {
-    // The size of the board is defined at compile time
-    constexpr unsigned int width = BOARD_SIZE;
-    constexpr unsigned int height = BOARD_SIZE;
+    constexpr unsigned int width = board_size;
+    constexpr unsigned int height = board_size;
     constexpr auto num_intersections = width * height;
     constexpr auto filter_len = filter_size * filter_size;
     const auto input_channels = weights.size() / (biases.size() * filter_len);
@@ -314,7 +319,7 @@ void convolve(const size_t outputs,
     assert(outputs * num_intersections == output.size());
 
     std::vector<float> col(filter_dim * width * height);
-    im2col<filter_size>(input_channels, input, col);
+    im2col<filter_size, board_size>(input_channels, input, col);
 
     // Weight shape (output, input, filter_size, filter_size)
     // 96 18 3 3
@@ -379,8 +384,19 @@ void batchnorm(const size_t channels,
 void CPUPipe::forward(const std::vector<float>& input,
                       std::vector<float>& output_pol,
                       std::vector<float>& output_val) {
+    dispatch_board_size(m_board_size, [&](const auto size) {
+        forward<decltype(size)::value>(input, output_pol, output_val);
+    });
+}
+
+template <int board_size>
+void CPUPipe::forward(const std::vector<float>& input,
+                      std::vector<float>& output_pol,
+                      std::vector<float>& output_val) {
+    constexpr auto num_intersections = board_size * board_size;
     // Input convolution
-    constexpr auto P = WINOGRAD_P;
+    constexpr auto WTILES = winograd_wtiles(board_size);
+    constexpr auto P = WTILES * WTILES;
     // Calculate output channels
     const auto output_channels = m_input_channels;
     // input_channels is the maximum number of input channels of any
@@ -389,41 +405,41 @@ void CPUPipe::forward(const std::vector<float>& input,
     const auto input_channels =
         std::max(static_cast<size_t>(output_channels),
                  static_cast<size_t>(Network::INPUT_CHANNELS));
-    auto conv_out = std::vector<float>(output_channels * NUM_INTERSECTIONS);
+    auto conv_out = std::vector<float>(output_channels * num_intersections);
 
     auto V = std::vector<float>(WINOGRAD_TILE * input_channels * P);
     auto M = std::vector<float>(WINOGRAD_TILE * output_channels * P);
 
-    winograd_convolve3(output_channels, input, m_weights->m_conv_weights[0], V,
+    winograd_convolve3<board_size>(output_channels, input, m_weights->m_conv_weights[0], V,
                        M, conv_out);
-    batchnorm<NUM_INTERSECTIONS>(output_channels, conv_out,
+    batchnorm<num_intersections>(output_channels, conv_out,
                                  m_weights->m_batchnorm_means[0].data(),
                                  m_weights->m_batchnorm_stddevs[0].data());
 
     // Residual tower
-    auto conv_in = std::vector<float>(output_channels * NUM_INTERSECTIONS);
-    auto res = std::vector<float>(output_channels * NUM_INTERSECTIONS);
+    auto conv_in = std::vector<float>(output_channels * num_intersections);
+    auto res = std::vector<float>(output_channels * num_intersections);
     for (auto i = size_t{1}; i < m_weights->m_conv_weights.size(); i += 2) {
         auto output_channels = m_input_channels;
         std::swap(conv_out, conv_in);
-        winograd_convolve3(output_channels, conv_in,
+        winograd_convolve3<board_size>(output_channels, conv_in,
                            m_weights->m_conv_weights[i], V, M, conv_out);
-        batchnorm<NUM_INTERSECTIONS>(output_channels, conv_out,
+        batchnorm<num_intersections>(output_channels, conv_out,
                                      m_weights->m_batchnorm_means[i].data(),
                                      m_weights->m_batchnorm_stddevs[i].data());
 
         std::swap(conv_in, res);
         std::swap(conv_out, conv_in);
-        winograd_convolve3(output_channels, conv_in,
+        winograd_convolve3<board_size>(output_channels, conv_in,
                            m_weights->m_conv_weights[i + 1], V, M, conv_out);
-        batchnorm<NUM_INTERSECTIONS>(
+        batchnorm<num_intersections>(
             output_channels, conv_out,
             m_weights->m_batchnorm_means[i + 1].data(),
             m_weights->m_batchnorm_stddevs[i + 1].data(), res.data());
     }
-    convolve<1>(Network::OUTPUTS_POLICY, conv_out, m_conv_pol_w, m_conv_pol_b,
+    convolve<1, board_size>(Network::OUTPUTS_POLICY, conv_out, m_conv_pol_w, m_conv_pol_b,
                 output_pol);
-    convolve<1>(Network::OUTPUTS_VALUE, conv_out, m_conv_val_w, m_conv_val_b,
+    convolve<1, board_size>(Network::OUTPUTS_VALUE, conv_out, m_conv_val_w, m_conv_val_b,
                 output_val);
 }
 
@@ -38,7 +38,7 @@
 
 class CPUPipe : public ForwardPipe {
 public:
-    virtual void initialize(int channels);
+    virtual void initialize(int channels, int board_size);
     virtual void forward(const std::vector<float>& input,
                          std::vector<float>& output_pol,
                          std::vector<float>& output_val);
@@ -48,16 +48,27 @@ public:
         std::shared_ptr<const ForwardPipeWeights> weights);
 
 private:
+    // All of the convolution code is instantiated for each supported
+    // board size, so smaller boards get their own buffer and tile sizes.
+    template <int board_size>
+    void forward(const std::vector<float>& input,
+                 std::vector<float>& output_pol,
+                 std::vector<float>& output_val);
+
+    template <int board_size>
     void winograd_transform_in(const std::vector<float>& in,
                                std::vector<float>& V, int C);
 
+    template <int board_size>
     void winograd_sgemm(const std::vector<float>& U,
                         const std::vector<float>& V,
                         std::vector<float>& M, int C, int K);
 
+    template <int board_size>
     void winograd_transform_out(const std::vector<float>& M,
                                 std::vector<float>& Y, int K);
 
+    template <int board_size>
     void winograd_convolve3(int outputs,
                             const std::vector<float>& input,
                             const std::vector<float>& U,
@@ -66,6 +77,7 @@ private:
                             std::vector<float>& output);
 
     int m_input_channels;
+    int m_board_size;
 
     // Input + residual block tower
     std::shared_ptr<const ForwardPipeWeights> m_weights;
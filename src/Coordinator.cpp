@@ -0,0 +1,457 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <boost/asio.hpp>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#include "Coordinator.h"
+
+#include "FastBoard.h"
+#include "Utils.h"
+
+using namespace Utils;
+
+constexpr int Coordinator::REPORT_CENTIS;
+constexpr std::chrono::milliseconds Coordinator::DEFAULT_TIMEOUT;
+
+static constexpr char UNIX_PREFIX[] = "unix:";
+// Sent after stopping an analysis, its response marks the end of it.
+static constexpr char SYNC_COMMAND[] = "1 protocol_version";
+static constexpr char SYNC_RESPONSE[] = "=1";
+
+// Splits an endpoint into host and port, or into an empty host and the
+// socket path for "unix:path".
+static bool split_endpoint(const std::string& endpoint, std::string& host,
+                           std::string& port) {
+    if (endpoint.compare(0, sizeof(UNIX_PREFIX) - 1, UNIX_PREFIX) == 0) {
+        host.clear();
+        port = endpoint.substr(sizeof(UNIX_PREFIX) - 1);
+        return false;
+    }
+    const auto colon = endpoint.rfind(':');
+    if (colon == std::string::npos) {
+        host = "localhost";
+        port = endpoint;
+    } else {
+        host = endpoint.substr(0, colon);
+        port = endpoint.substr(colon + 1);
+    }
+    return true;
+}
+
+template <typename SocketStream>
+static std::function<void()> deadline_extender(
+    SocketStream& stream, const std::chrono::milliseconds timeout) {
+    return [&stream, timeout]() { stream.expires_after(timeout); };
+}
+
+static int count_stones(const FastBoard& board, const int color) {
+    auto stones = 0;
+    for (auto i = 0; i < board.get_boardsize(); i++) {
+        for (auto j = 0; j < board.get_boardsize(); j++) {
+            stones += board.get_state(i, j) == color;
+        }
+    }
+    return stones;
+}
+
+Coordinator::Coordinator(const std::string& endpoints,
+                         const std::chrono::milliseconds timeout)
+    : m_timeout(timeout) {
+    auto list = std::istringstream{endpoints};
+    auto endpoint = std::string{};
+    while (std::getline(list, endpoint, ',')) {
+        if (endpoint.empty()) {
+            continue;
+        }
+        auto worker = std::make_unique<Worker>();
+        worker->endpoint = endpoint;
+        connect(*worker);
+        if (!send(*worker, "protocol_version")) {
+            throw std::runtime_error("No GTP engine at " + endpoint + ".");
+        }
+        m_workers.emplace_back(std::move(worker));
+    }
+    if (m_workers.empty()) {
+        throw std::runtime_error("No workers given.");
+    }
+}
+
+Coordinator::~Coordinator() {
+    stop();
+}
+
+size_t Coordinator::size() const {
+    return m_workers.size();
+}
+
+void Coordinator::connect(Worker& worker) {
+    const auto& endpoint = worker.endpoint;
+    auto host = std::string{};
+    auto port = std::string{};
+    if (split_endpoint(endpoint, host, port)) {
+        auto stream =
+            std::make_unique<boost::asio::ip::tcp::iostream>(host, port);
+        if (!*stream) {
+            throw std::runtime_error("Could not connect to " + endpoint + ": "
+                                     + stream->error().message());
+        }
+        worker.extend_deadline = deadline_extender(*stream, m_timeout);
+        worker.stream = std::move(stream);
+        return;
+    }
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    using boost::asio::local::stream_protocol;
+    auto stream = std::make_unique<stream_protocol::iostream>(
+        stream_protocol::endpoint(port));
+    if (!*stream) {
+        throw std::runtime_error("Could not connect to " + endpoint + ": "
+                                 + stream->error().message());
+    }
+    worker.extend_deadline = deadline_extender(*stream, m_timeout);
+    worker.stream = std::move(stream);
+#else
+    throw std::runtime_error("Unix sockets are not supported.");
+#endif
+}
+
+void Coordinator::serve(const std::string& endpoint) {
+#ifdef _WIN32
+    (void)endpoint;
+    throw std::runtime_error("Serving GTP on a socket is not supported.");
+#else
+    boost::asio::io_context io;
+    auto host = std::string{};
+    auto port = std::string{};
+    auto fd = -1;
+    if (split_endpoint(endpoint, host, port)) {
+        using boost::asio::ip::tcp;
+        // Resolving "localhost" keeps the engine private to this machine
+        // unless another address is asked for.
+        auto resolver = tcp::resolver{io};
+        const auto address = resolver.resolve(host, port)->endpoint();
+        if (!address.address().is_loopback()) {
+            // There is no authentication, and GTP can write files.
+            myprintf("Warning: anyone who can reach %s can control this "
+                     "engine, including writing files with lz-save_tree.\n",
+                     endpoint.c_str());
+        }
+        auto acceptor = tcp::acceptor{io, address};
+        myprintf("Waiting for a GTP connection on %s.\n", endpoint.c_str());
+        auto socket = tcp::socket{io};
+        acceptor.accept(socket);
+        socket.set_option(tcp::no_delay(true));
+        fd = ::dup(socket.native_handle());
+    } else {
+        using boost::asio::local::stream_protocol;
+        ::unlink(port.c_str());
+        auto acceptor =
+            stream_protocol::acceptor{io, stream_protocol::endpoint(port)};
+        myprintf("Waiting for a GTP connection on %s.\n", endpoint.c_str());
+        auto socket = stream_protocol::socket{io};
+        acceptor.accept(socket);
+        fd = ::dup(socket.native_handle());
+    }
+    if (fd < 0 || ::dup2(fd, 0) < 0 || ::dup2(fd, 1) < 0) {
+        throw std::runtime_error("Could not redirect GTP to the connection.");
+    }
+    ::close(fd);
+    myprintf("Serving GTP on %s.\n", endpoint.c_str());
+#endif
+}
+
+bool Coordinator::read_line(Worker& worker, std::string& line) {
+    worker.extend_deadline();
+    if (!std::getline(*worker.stream, line)) {
+        return false;
+    }
+    if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+    }
+    return true;
+}
+
+bool Coordinator::send(Worker& worker, const std::string& command,
+                       std::string* response) {
+    worker.extend_deadline();
+    *worker.stream << command << std::endl;
+    auto line = std::string{};
+    auto success = false;
+    auto first = true;
+    while (read_line(worker, line)) {
+        if (first) {
+            success = !line.empty() && line[0] == '=';
+            if (response && line.size() > 1) {
+                *response = line.substr(2);
+            }
+            first = false;
+        } else if (line.empty()) {
+            return success;
+        }
+    }
+    myprintf("Lost worker %s.\n", worker.endpoint.c_str());
+    worker.alive = false;
+    return false;
+}
+
+bool Coordinator::set_position(Worker& worker, const GameState& state) {
+    const auto board_size = state.board.get_boardsize();
+    const auto& history = state.get_move_history();
+    const auto movenum = std::min(history.size(), state.get_movenum());
+    auto moves = std::vector<GameState::HistoryMove>(
+        begin(history), begin(history) + movenum);
+
+    // Take back what the worker has beyond the common part of the game,
+    // unless that's more work than starting over.
+    auto common = size_t{0};
+    if (worker.board_size == board_size && worker.komi == state.get_komi()) {
+        while (common < worker.moves.size() && common < moves.size()
+               && worker.moves[common].color == moves[common].color
+               && worker.moves[common].vertex == moves[common].vertex) {
+            common++;
+        }
+    }
+    auto synced = worker.board_size == board_size
+                  && worker.komi == state.get_komi()
+                  && worker.moves.size() - common <= common;
+    while (synced && worker.moves.size() > common) {
+        synced = send(worker, "undo");
+        worker.moves.pop_back();
+    }
+
+    if (!synced) {
+        worker.board_size = 0;
+        worker.moves.clear();
+        common = 0;
+        if (!send(worker, "boardsize " + std::to_string(board_size))
+            || !send(worker, "komi " + std::to_string(state.get_komi()))
+            || !send(worker, "clear_board")) {
+            return false;
+        }
+        // Stones from before the first move can only be handicap stones.
+        auto start = state;
+        start.rewind();
+        const auto handicap = count_stones(start.board, FastBoard::BLACK);
+        if (count_stones(start.board, FastBoard::WHITE) > 0) {
+            return false;
+        }
+        if (handicap > 0) {
+            auto stones = std::string{};
+            if (!send(worker, "fixed_handicap " + std::to_string(handicap),
+                      &stones)
+                || stones != start.board.get_stone_list()) {
+                return false;
+            }
+        }
+        worker.board_size = board_size;
+        worker.komi = state.get_komi();
+    }
+
+    for (auto i = common; i < moves.size(); i++) {
+        const auto& move = moves[i];
+        const auto color = move.color == FastBoard::BLACK ? "b " : "w ";
+        if (!send(worker, "play " + std::string(color)
+                              + state.board.move_to_text(move.vertex))) {
+            worker.board_size = 0;
+            return false;
+        }
+        worker.moves.emplace_back(move);
+    }
+    return true;
+}
+
+void Coordinator::read_analysis(Worker& worker) {
+    auto& stream = *worker.stream;
+    auto line = std::string{};
+    // The first line acknowledges the command.
+    if (!read_line(worker, line) || line.empty() || line[0] != '=') {
+        worker.alive = false;
+        return;
+    }
+    // Only this thread uses the stream until we return, so it also ends
+    // the analysis.  Any input does that, an empty line is ignored after
+    // that.  The response to the sync command then tells where the
+    // analysis output ended.
+    auto stopped = false;
+    auto synced = false;
+    while (read_line(worker, line)) {
+        if (synced && line.empty()) {
+            return;
+        }
+        if (line.compare(0, sizeof(SYNC_RESPONSE) - 1, SYNC_RESPONSE) == 0) {
+            synced = true;
+            continue;
+        }
+        // An empty line is a report without visits or the analysis ended
+        // on its own, stop in both cases.
+        if (!stopped && (line.empty() || worker.stopping)) {
+            stream << '\n' << SYNC_COMMAND << std::endl;
+            stopped = true;
+        }
+        if (stopped) {
+            continue;
+        }
+        auto reported = std::unordered_map<std::string, MoveStats>{};
+        auto tokens = std::istringstream{line};
+        auto token = std::string{};
+        auto move = std::string{};
+        auto visits = std::int64_t{0};
+        auto winrate = 0;
+        while (tokens >> token) {
+            if (token == "info") {
+                move.clear();
+                visits = 0;
+            } else if (token == "move") {
+                tokens >> move;
+            } else if (token == "visits") {
+                tokens >> visits;
+            } else if (token == "winrate") {
+                tokens >> winrate;
+                if (!move.empty() && visits > 0) {
+                    reported[move] = {visits, visits * winrate / 10000.0};
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.reported = std::move(reported);
+    }
+    worker.alive = false;
+}
+
+void Coordinator::start(const GameState& state) {
+    const auto color =
+        state.board.get_to_move() == FastBoard::BLACK ? "b " : "w ";
+    for (auto& worker : m_workers) {
+        worker->reported.clear();
+        worker->merged.clear();
+        worker->baseline = false;
+        worker->stopping = false;
+        if (!worker->alive || !set_position(*worker, state)) {
+            continue;
+        }
+        worker->extend_deadline();
+        *worker->stream << "lz-analyze " << color << REPORT_CENTIS
+                        << std::endl;
+        worker->reader = std::thread(read_analysis, std::ref(*worker));
+    }
+    m_running = true;
+}
+
+void Coordinator::merge(const GameState& state, UCTNode& root) {
+    if (!root.has_children()) {
+        return;
+    }
+
+    // Workers list all moves equivalent by symmetry, we only have one
+    // child for them.
+    const auto symmetries = state.get_symmetries();
+    auto child_of = std::unordered_map<int, int>{};
+    const auto& children = root.get_children();
+    const auto add_child = [&](const int move) {
+        for (const auto& equivalent :
+             state.board.expand_equivalent_move(move, 0, symmetries)) {
+            child_of.emplace(equivalent.vertex, move);
+        }
+    };
+    for (const auto& child : children) {
+        add_child(child.get_move());
+    }
+    for (auto i = children.size(); i < children.total_size(); i++) {
+        add_child(children.vertex(i));
+    }
+
+    const auto to_move = state.board.get_to_move();
+    for (auto& worker : m_workers) {
+        auto totals = std::unordered_map<int, MoveStats>{};
+        {
+            std::lock_guard<std::mutex> lock(worker->mutex);
+            for (const auto& entry : worker->reported) {
+                const auto child = child_of.find(
+                    state.board.text_to_move(entry.first));
+                if (child != end(child_of)) {
+                    auto& total = totals[child->second];
+                    total.visits += entry.second.visits;
+                    total.evals += entry.second.evals;
+                }
+            }
+        }
+        // The first report includes what the worker searched before, in
+        // the tree it reused.  Those visits only reached our tree as the
+        // totals of the move that was played, not split over its children,
+        // and can't be told apart from new ones, so they are left out.
+        if (!worker->baseline) {
+            if (!totals.empty()) {
+                worker->merged = std::move(totals);
+                worker->baseline = true;
+            }
+            continue;
+        }
+        for (const auto& entry : totals) {
+            auto& merged = worker->merged[entry.first];
+            const auto visits = entry.second.visits - merged.visits;
+            if (visits <= 0) {
+                continue;
+            }
+            const auto eval = std::min(
+                1.0,
+                std::max(0.0, (entry.second.evals - merged.evals) / visits));
+            const auto black_eval =
+                to_move == FastBoard::BLACK ? eval : 1.0 - eval;
+            if (root.add_child_visits(entry.first, visits,
+                                      float(black_eval))) {
+                merged = entry.second;
+            }
+        }
+    }
+}
+
+void Coordinator::stop() {
+    if (!m_running) {
+        return;
+    }
+    // The readers stop at the next report, or give up on their worker
+    // once it doesn't answer within the timeout.
+    for (auto& worker : m_workers) {
+        worker->stopping = true;
+    }
+    for (auto& worker : m_workers) {
+        if (worker->reader.joinable()) {
+            worker->reader.join();
+        }
+    }
+    m_running = false;
+}
@@ -0,0 +1,129 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef COORDINATOR_H_INCLUDED
+#define COORDINATOR_H_INCLUDED
+
+#include "config.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "GameState.h"
+#include "UCTNode.h"
+
+/*
+    Root-parallel search over several leelaz processes. Each worker is a
+    leelaz serving GTP on a socket, see serve(). While we search, the
+    workers analyze the same position with lz-analyze, and the visits and
+    winrates they report for the root moves are added to our own root
+    children. The combined search then comes out through the usual
+    analysis output and move selection, and counts against the visit limit.
+
+    Endpoints are "host:port", "port" for localhost, or "unix:path".  A
+    worker that takes longer than the timeout to answer or to report is
+    considered lost, and left out from then on.
+*/
+class Coordinator {
+public:
+    // Centiseconds between the reports of the workers.
+    static constexpr auto REPORT_CENTIS = 10;
+    static constexpr std::chrono::milliseconds DEFAULT_TIMEOUT{10000};
+
+    // Connects to a comma separated list of endpoints, throws on failure.
+    explicit Coordinator(const std::string& endpoints,
+                         std::chrono::milliseconds timeout = DEFAULT_TIMEOUT);
+    ~Coordinator();
+
+    size_t size() const;
+
+    // Sets up state on all workers and starts their analysis.
+    void start(const GameState& state);
+    // Adds what the workers searched since the last merge to root.  The
+    // last reports of a search can still be merged after stop().
+    void merge(const GameState& state, UCTNode& root);
+    // Stops the analysis of all workers.
+    void stop();
+
+    // Accepts a single GTP connection on endpoint and makes it our
+    // standard input and output. Throws on failure.
+    static void serve(const std::string& endpoint);
+
+private:
+    struct MoveStats {
+        std::int64_t visits;
+        // Sum of the winrates of the visits, for the side to move.
+        double evals;
+    };
+
+    struct Worker {
+        std::string endpoint;
+        std::unique_ptr<std::iostream> stream;
+        // Gives the reads and writes on the stream from now on the
+        // timeout to complete.
+        std::function<void()> extend_deadline;
+        std::atomic<bool> alive{true};
+        // What the worker was last set up with.
+        int board_size{0};
+        float komi{0.0f};
+        std::vector<GameState::HistoryMove> moves;
+        // Reader of the analysis output while the worker searches.  It has
+        // the stream to itself until it ends, see read_analysis().
+        std::thread reader;
+        std::atomic<bool> stopping{false};
+        std::mutex mutex;
+        std::unordered_map<std::string, MoveStats> reported;
+        // Per root child, what was added to our tree already, or was
+        // left out as searched before, see merge().
+        std::unordered_map<int, MoveStats> merged;
+        bool baseline{false};
+    };
+
+    void connect(Worker& worker);
+    bool send(Worker& worker, const std::string& command,
+              std::string* response = nullptr);
+    bool set_position(Worker& worker, const GameState& state);
+    static bool read_line(Worker& worker, std::string& line);
+    static void read_analysis(Worker& worker);
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::chrono::milliseconds m_timeout;
+    bool m_running{false};
+};
+
+#endif
@@ -31,10 +31,10 @@
 
 #include <algorithm>
 #include <array>
+#include <bitset>
 #include <cassert>
 #include <cctype>
 #include <iostream>
-#include <queue>
 #include <sstream>
 #include <string>
 
@@ -257,42 +257,172 @@ void FastBoard::remove_neighbour(const int vtx, const int color) {
     }
 }
 
-int FastBoard::calc_reach_color(const int color) const {
-    auto reachable = 0;
-    auto bd = std::vector<bool>(m_numvertices, false);
-    auto open = std::queue<int>();
-    for (auto i = 0; i < m_boardsize; i++) {
-        for (auto j = 0; j < m_boardsize; j++) {
-            auto vertex = get_vertex(i, j);
-            if (m_state[vertex] == color) {
-                reachable++;
-                bd[vertex] = true;
-                open.push(vertex);
+int FastBoard::calc_reach_color(const int color,
+                                const std::array<BitBoard, 3>& bits) const {
+    const auto reach =
+        bits[color].flood_fill(bits[color] | bits[EMPTY], m_sidevertices);
+    return reach.count();
+}
+
+std::array<BitBoard, 3> FastBoard::get_bits() const {
+    auto bits = std::array<BitBoard, 3>{};
+    for (auto i = 0; i < m_numvertices; i++) {
+        if (m_state[i] != INVAL) {
+            bits[m_state[i]].set(i);
+        }
+    }
+    return bits;
+}
+
+// Needed for scoring passed out games not in MC playouts
+float FastBoard::area_score(const float komi) const {
+    const auto bits = get_bits();
+    auto white = calc_reach_color(WHITE, bits);
+    auto black = calc_reach_color(BLACK, bits);
+    return black - white - komi;
+}
+
+// Parts of the board that don't touch each other.  There are never more
+// of them than points on a checkerboard of one color.
+static constexpr auto MAX_PARTS = size_t{(NUM_INTERSECTIONS + 1) / 2};
+using BoardParts = std::array<BitBoard, MAX_PARTS>;
+
+// Splits 'points' into its connected parts, returns how many there are.
+static size_t split_connected(BitBoard points, const int stride,
+                              BoardParts& parts) {
+    auto count = size_t{0};
+    while (points.any()) {
+        assert(count < MAX_PARTS);
+        auto part = BitBoard{};
+        part.set(points.first());
+        part = part.flood_fill(points, stride);
+        points = points.and_not(part);
+        parts[count++] = part;
+    }
+    return count;
+}
+
+BitBoard FastBoard::calc_pass_alive(const int color) const {
+    // Benson's algorithm.  Blocks are the strings of 'color', regions the
+    // connected areas of everything else.  A region is vital to a block
+    // if all its empty points are liberties of the block.  Blocks with
+    // less than two vital regions can be captured, and so can the
+    // opponent's stones in regions next to them, so drop both until
+    // nothing changes.  The blocks that are left are alive even if
+    // 'color' passes forever.
+    const auto bits = get_bits();
+    auto blocks = BoardParts{};
+    auto regions = BoardParts{};
+    const auto block_count =
+        split_connected(bits[color], m_sidevertices, blocks);
+    const auto region_count =
+        split_connected(bits[!color] | bits[EMPTY], m_sidevertices, regions);
+
+    // The stones of the blocks next to each region, and of the blocks
+    // it is vital to.  A block is in there if its first stone is.
+    auto first_stone = std::array<int, MAX_PARTS>{};
+    for (auto b = size_t{0}; b < block_count; b++) {
+        first_stone[b] = blocks[b].first();
+    }
+    auto next_to = BoardParts{};
+    auto vital = BoardParts{};
+    for (auto r = size_t{0}; r < region_count; r++) {
+        const auto border = regions[r].dilate(m_sidevertices);
+        const auto region_empty = regions[r] & bits[EMPTY];
+        for (auto b = size_t{0}; b < block_count; b++) {
+            if (!(border & blocks[b]).any()) {
+                continue;
+            }
+            next_to[r] = next_to[r] | blocks[b];
+            const auto libs = blocks[b].dilate(m_sidevertices);
+            if (!region_empty.and_not(libs).any()) {
+                vital[r] = vital[r] | blocks[b];
             }
         }
     }
-    while (!open.empty()) {
-        /* colored field, spread */
-        auto vertex = open.front();
-        open.pop();
-
-        for (auto k = 0; k < 4; k++) {
-            auto neighbor = vertex + m_dirs[k];
-            if (!bd[neighbor] && m_state[neighbor] == EMPTY) {
-                reachable++;
-                bd[neighbor] = true;
-                open.push(neighbor);
+
+    auto block_alive = std::bitset<MAX_PARTS>{};
+    auto region_alive = std::bitset<MAX_PARTS>{};
+    block_alive.set();
+    region_alive.set();
+    auto changed = true;
+    while (changed) {
+        changed = false;
+        for (auto b = size_t{0}; b < block_count; b++) {
+            if (!block_alive[b]) {
+                continue;
+            }
+            auto vital_regions = 0;
+            for (auto r = size_t{0}; r < region_count; r++) {
+                if (region_alive[r] && vital[r].test(first_stone[b])) {
+                    vital_regions++;
+                }
             }
+            if (vital_regions < 2) {
+                block_alive[b] = false;
+                changed = true;
+                for (auto r = size_t{0}; r < region_count; r++) {
+                    if (next_to[r].test(first_stone[b])) {
+                        region_alive[r] = false;
+                    }
+                }
+            }
+        }
+    }
+
+    // Alive blocks, and the regions in which every empty point is a
+    // liberty of one of them, so the opponent can't make eyes there.
+    auto alive_blocks = BitBoard{};
+    for (auto b = size_t{0}; b < block_count; b++) {
+        if (block_alive[b]) {
+            alive_blocks = alive_blocks | blocks[b];
+        }
+    }
+    auto alive = alive_blocks;
+    for (auto r = size_t{0}; r < region_count; r++) {
+        if (region_alive[r] && (vital[r] & alive_blocks).any()) {
+            alive = alive | regions[r];
         }
     }
-    return reachable;
+    return alive;
 }
 
-// Needed for scoring passed out games not in MC playouts
-float FastBoard::area_score(const float komi) const {
-    auto white = calc_reach_color(WHITE);
-    auto black = calc_reach_color(BLACK);
-    return black - white - komi;
+BitBoard FastBoard::calc_pass_alive_eyes(const int color) const {
+    const auto bits = get_bits();
+    const auto area = calc_pass_alive(color);
+    // Leave the regions that still hold dead opponent stones, they
+    // need to be captured for the area score to count them.
+    const auto regions = area.and_not(bits[color]);
+    const auto dead = (regions & bits[!color]).flood_fill(regions,
+                                                          m_sidevertices);
+    return (regions & bits[EMPTY]).and_not(dead);
+}
+
+BitBoard FastBoard::calc_open_points() const {
+    const auto bits = get_bits();
+    const auto stones = bits[BLACK] | bits[WHITE];
+    return bits[EMPTY].and_not(stones.dilate(m_sidevertices));
+}
+
+bool FastBoard::calc_settled_score(const float komi, float& score) const {
+    // Every empty point must touch a stone before there is any chance
+    // of the whole board being decided, which is cheap to check.
+    if (calc_open_points().any()) {
+        return false;
+    }
+    const auto black = calc_pass_alive(BLACK);
+    const auto white = calc_pass_alive(WHITE);
+    if ((black | white).count() != m_boardsize * m_boardsize) {
+        return false;
+    }
+    // Dead stones still count in place when the game is passed out,
+    // only score boards on which they have been captured already.
+    const auto bits = get_bits();
+    if ((black & bits[WHITE]).any() || (white & bits[BLACK]).any()) {
+        return false;
+    }
+    score = black.count() - white.count() - komi;
+    return true;
 }
 
 void FastBoard::display_board(const int lastmove) {
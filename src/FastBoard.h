@@ -38,6 +38,8 @@
 #include <utility>
 #include <vector>
 
+#include "BitBoard.h"
+
 class FastBoard {
     friend class FastState;
 
@@ -87,6 +89,19 @@ public:
     bool is_eye(int color, int vtx) const;
 
     float area_score(float komi) const;
+    // Stones of 'color' that can't be captured even if 'color' always
+    // passes, and the area they surround in which the opponent can't
+    // live (Benson's algorithm).
+    BitBoard calc_pass_alive(int color) const;
+    // Empty points inside the pass-alive area of 'color' where playing
+    // can never gain anything for it.
+    BitBoard calc_pass_alive_eyes(int color) const;
+    // Empty points that don't touch any stone, a cheap measure of how
+    // much of the board is still open.
+    BitBoard calc_open_points() const;
+    // When both sides' pass-alive areas cover the board and hold no
+    // opponent stones the game is decided, store the area score.
+    bool calc_settled_score(float komi, float& score) const;
 
     int get_prisoners(int side) const;
     bool black_to_move() const;
@@ -131,7 +146,9 @@ protected:
     int m_boardsize;
     int m_sidevertices;
 
-    int calc_reach_color(int color) const;
+    // Stones of each color and the empty intersections.
+    std::array<BitBoard, 3> get_bits() const;
+    int calc_reach_color(int color, const std::array<BitBoard, 3>& bits) const;
 
     int count_neighbours(int color, int i) const;
     void merge_strings(int ip, int aip);
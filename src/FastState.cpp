@@ -82,6 +82,30 @@ bool FastState::is_move_legal(const int color, const int vertex) const {
                    && !board.is_suicide(vertex, color)));
 }
 
+BitBoard FastState::get_legal_moves(const int color) const {
+    // Only visit the empty intersections, and most of them have a
+    // liberty, which is_suicide() checks first.
+    auto legal = BitBoard{};
+    for (auto i = 0; i < board.m_empty_cnt; i++) {
+        const auto vertex = board.m_empty[i];
+        if (!board.is_suicide(vertex, color)) {
+            legal.set(vertex);
+        }
+    }
+    if (m_komove != FastBoard::NO_VERTEX) {
+        legal.reset(m_komove);
+    }
+    if (cfg_analyze_tags.has_move_restrictions()) {
+        const auto candidates = legal;
+        candidates.for_each([this, color, &legal](const int vertex) {
+            if (cfg_analyze_tags.is_to_avoid(color, vertex, m_movenum)) {
+                legal.reset(vertex);
+            }
+        });
+    }
+    return legal;
+}
+
 void FastState::play_move(const int vertex) {
     play_move(board.m_tomove, vertex);
 }
@@ -177,5 +201,5 @@ int FastState::get_handicap() const {
 }
 
 std::uint64_t FastState::get_symmetry_hash(const int symmetry) const {
-    return board.calc_symmetry_hash(m_komove, symmetry);
+    return board.get_symmetry_hash(m_komove, symmetry);
 }
@@ -45,6 +45,8 @@ public:
 
     void play_move(int vertex);
     bool is_move_legal(int color, int vertex) const;
+    // All intersections where is_move_legal() holds.
+    BitBoard get_legal_moves(int color) const;
 
     void set_komi(float komi);
     float get_komi() const;
@@ -32,6 +32,7 @@
 
 #include "config.h"
 
+#include <functional>
 #include <memory>
 #include <vector>
 
@@ -53,15 +54,28 @@ public:
         std::vector<float> m_conv_val_b;
     };
 
+    using PrefetchCallback =
+        std::function<void(const std::vector<float>& output_pol,
+                           const std::vector<float>& output_val)>;
+
     virtual ~ForwardPipe() = default;
 
-    virtual void initialize(int channels) = 0;
+    virtual void initialize(int channels, int board_size) = 0;
     virtual bool needs_autodetect() {
         return false;
     };
     virtual void forward(const std::vector<float>& input,
                          std::vector<float>& output_pol,
                          std::vector<float>& output_val) = 0;
+    // Whether prefetch() queues anything.  Pipes that don't batch have
+    // no spare slots to run prefetches in.
+    virtual bool accepts_prefetch() const {
+        return false;
+    }
+    // Queue a speculative evaluation that only runs in otherwise unused
+    // batch slots, 'done' gets the outputs if it ever does.
+    virtual void prefetch(std::vector<float>&& /*input*/,
+                          PrefetchCallback /*done*/) {}
     virtual void push_weights(
         unsigned int filter_size, unsigned int channels, unsigned int outputs,
         std::shared_ptr<const ForwardPipeWeights> weights) = 0;
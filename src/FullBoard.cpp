@@ -29,8 +29,10 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <array>
 #include <cassert>
+#include <iterator>
 
 #include "FullBoard.h"
 
@@ -48,6 +50,7 @@ int FullBoard::remove_string(const int i) {
     do {
         m_hash    ^= Zobrist::zobrist[m_state[pos]][pos];
         m_ko_hash ^= Zobrist::zobrist[m_state[pos]][pos];
+        update_symmetry_hashes(m_state[pos], pos);
 
         m_state[pos] = EMPTY;
         m_parent[pos] = NUM_VERTICES;
@@ -60,6 +63,7 @@ int FullBoard::remove_string(const int i) {
 
         m_hash    ^= Zobrist::zobrist[m_state[pos]][pos];
         m_ko_hash ^= Zobrist::zobrist[m_state[pos]][pos];
+        update_symmetry_hashes(m_state[pos], pos);
 
         removed++;
         pos = m_next[pos];
@@ -121,6 +125,81 @@ std::uint64_t FullBoard::calc_symmetry_hash(const int komove,
     });
 }
 
+int FullBoard::get_symmetric_vertex(const int vertex,
+                                    const int symmetry) const {
+    if (vertex == PASS || vertex == RESIGN) {
+        return vertex;
+    }
+    const auto newvtx =
+        Network::get_symmetry(get_xy(vertex), symmetry, m_boardsize);
+    return get_vertex(newvtx.first, newvtx.second);
+}
+
+std::vector<std::pair<int, int>> FullBoard::get_equivalent_vertices(
+    const int vertex, const std::vector<int>& symmetries) const {
+    auto res = std::vector<std::pair<int, int>>{
+        {vertex, Network::IDENTITY_SYMMETRY}};
+    for (const auto sym : symmetries) {
+        const auto newvtx = get_symmetric_vertex(vertex, sym);
+        const auto seen =
+            std::any_of(cbegin(res), cend(res), [newvtx](const auto& entry) {
+                return entry.first == newvtx;
+            });
+        if (!seen) {
+            res.emplace_back(newvtx, sym);
+        }
+    }
+    return res;
+}
+
+std::vector<FullBoard::EquivalentMove> FullBoard::expand_equivalent_move(
+    const int vertex, const std::int64_t visits,
+    const std::vector<int>& symmetries) const {
+    const auto equivalents = get_equivalent_vertices(vertex, symmetries);
+    const auto members = static_cast<std::int64_t>(equivalents.size());
+    auto res = std::vector<EquivalentMove>{};
+    res.reserve(equivalents.size());
+    for (auto i = std::int64_t{0}; i < members; i++) {
+        // The remainder goes to the first ones.
+        const auto share = visits / members + (i < visits % members ? 1 : 0);
+        res.push_back({equivalents[i].first, equivalents[i].second, share});
+    }
+    return res;
+}
+
+void FullBoard::update_symmetry_hashes(const int color, const int vertex) {
+    if (!m_sym_tables) {
+        return;
+    }
+    const auto& keys = m_sym_tables->stones[color][vertex];
+    for (auto sym = 0; sym < Zobrist::NUM_SYMMETRIES; sym++) {
+        m_sym_ko_hash[sym] ^= keys[sym];
+    }
+}
+
+void FullBoard::calc_symmetry_ko_hashes() {
+    m_sym_ko_hash.fill(Zobrist::zobrist_empty);
+    m_sym_tables = Zobrist::zobrist_sym[m_boardsize].get();
+    for (auto i = 0; i < m_numvertices; i++) {
+        if (m_state[i] != INVAL) {
+            update_symmetry_hashes(m_state[i], i);
+        }
+    }
+}
+
+std::uint64_t FullBoard::get_symmetry_hash(const int komove,
+                                           const int symmetry) const {
+    // Board sizes that can't be played have no symmetry tables.
+    if (!m_sym_tables) {
+        return calc_symmetry_hash(komove, symmetry);
+    }
+    // m_hash ^ m_ko_hash leaves the terms that don't depend on the stones,
+    // only the ko vertex among them needs transforming.
+    return m_sym_ko_hash[symmetry] ^ m_ko_hash ^ m_hash
+           ^ Zobrist::zobrist_ko[komove]
+           ^ m_sym_tables->ko[komove][symmetry];
+}
+
 std::uint64_t FullBoard::get_hash() const {
     return m_hash;
 }
@@ -142,6 +221,7 @@ int FullBoard::update_board(const int color, const int i) {
 
     m_hash ^= Zobrist::zobrist[m_state[i]][i];
     m_ko_hash ^= Zobrist::zobrist[m_state[i]][i];
+    update_symmetry_hashes(m_state[i], i);
 
     m_state[i] = vertex_t(color);
     m_next[i] = i;
@@ -151,6 +231,7 @@ int FullBoard::update_board(const int color, const int i) {
 
     m_hash ^= Zobrist::zobrist[m_state[i]][i];
     m_ko_hash ^= Zobrist::zobrist[m_state[i]][i];
+    update_symmetry_hashes(m_state[i], i);
 
     /* update neighbor liberties (they all lose 1) */
     add_neighbour(i, color);
@@ -221,4 +302,5 @@ void FullBoard::reset_board(const int size) {
 
     m_hash = calc_hash();
     m_ko_hash = calc_ko_hash();
+    calc_symmetry_ko_hashes();
 }
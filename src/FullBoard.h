@@ -33,8 +33,11 @@
 #include "config.h"
 
 #include <cstdint>
+#include <utility>
+#include <vector>
 
 #include "FastBoard.h"
+#include "Zobrist.h"
 
 class FullBoard : public FastBoard {
 public:
@@ -51,11 +54,39 @@ public:
     std::uint64_t calc_hash(int komove = NO_VERTEX) const;
     std::uint64_t calc_symmetry_hash(int komove, int symmetry) const;
     std::uint64_t calc_ko_hash() const;
+    // Same as calc_symmetry_hash, from incrementally updated hashes.
+    std::uint64_t get_symmetry_hash(int komove, int symmetry) const;
+
+    // Image of 'vertex' under a symmetry, PASS and RESIGN map to themselves.
+    int get_symmetric_vertex(int vertex, int symmetry) const;
+    // The distinct vertices 'vertex' maps to under the identity and the
+    // given symmetries, each paired with a symmetry that maps it there.
+    std::vector<std::pair<int, int>> get_equivalent_vertices(
+        int vertex, const std::vector<int>& symmetries) const;
+    // A child stands for all moves equivalent to its own.  Expands it
+    // into those, each with the symmetry that maps the child's subtree
+    // onto it and an even share of the child's visits.
+    struct EquivalentMove {
+        int vertex;
+        int symmetry;
+        std::int64_t visits;
+    };
+    std::vector<EquivalentMove> expand_equivalent_move(
+        int vertex, std::int64_t visits,
+        const std::vector<int>& symmetries) const;
 
     std::uint64_t m_hash;
     std::uint64_t m_ko_hash;
 
 private:
+    void update_symmetry_hashes(int color, int vertex);
+    void calc_symmetry_ko_hashes();
+
+    // Ko hash of the board with each symmetry applied.
+    Zobrist::SymmetryKeys m_sym_ko_hash;
+    // Symmetry keys for this board size, nullptr if there are none.
+    const Zobrist::SymmetryTables* m_sym_tables{nullptr};
+
     template <class Function>
     std::uint64_t calc_hash(int komove, Function transform) const;
 };
@@ -61,11 +61,14 @@ using namespace Utils;
 bool cfg_gtp_mode;
 bool cfg_allow_pondering;
 unsigned int cfg_num_threads;
+bool cfg_numa;
 unsigned int cfg_batch_size;
-int cfg_max_playouts;
-int cfg_max_visits;
+unsigned int cfg_prefetch;
+std::int64_t cfg_max_playouts;
+std::int64_t cfg_max_visits;
 size_t cfg_max_memory;
 size_t cfg_max_tree_size;
+bool cfg_tree_eviction;
 int cfg_max_cache_ratio_percent;
 TimeManagement::enabled_t cfg_timemanage;
 int cfg_lagbuffer_cs;
@@ -74,8 +77,15 @@ int cfg_noise;
 int cfg_random_cnt;
 int cfg_random_min_visits;
 float cfg_random_temp;
+float cfg_full_search_prob;
+std::int64_t cfg_fast_visits;
 std::uint64_t cfg_rng_seed;
 bool cfg_dumbpass;
+std::string cfg_book_file;
+std::string cfg_build_book;
+int cfg_book_plies;
+std::string cfg_workers;
+std::string cfg_listen;
 #ifdef USE_OPENCL
 std::vector<int> cfg_gpus;
 bool cfg_sgemm_exhaustive;
@@ -91,6 +101,7 @@ float cfg_softmax_temp;
 float cfg_fpu_reduction;
 float cfg_fpu_root_reduction;
 float cfg_ci_alpha;
+float cfg_kl_threshold;
 float cfg_lcb_min_visit_ratio;
 std::string cfg_weightsfile;
 std::string cfg_logfile;
@@ -298,6 +309,8 @@ bool AnalyzeTags::has_move_restrictions() const {
 }
 
 std::unique_ptr<Network> GTP::s_network;
+std::unique_ptr<Book> GTP::s_book;
+std::unique_ptr<Coordinator> GTP::s_coordinator;
 
 void GTP::initialize(std::unique_ptr<Network>&& net) {
     s_network = std::move(net);
@@ -322,14 +335,17 @@ void GTP::setup_default_parameters() {
 
     // we will re-calculate this on Leela.cpp
     cfg_num_threads = 1;
+    cfg_numa = false;
     // we will re-calculate this on Leela.cpp
     cfg_batch_size = 1;
+    cfg_prefetch = 0;
 
     cfg_max_memory = UCTSearch::DEFAULT_MAX_MEMORY;
     cfg_max_playouts = UCTSearch::UNLIMITED_PLAYOUTS;
     cfg_max_visits = UCTSearch::UNLIMITED_PLAYOUTS;
     // This will be overwriiten in initialize() after network size is known.
     cfg_max_tree_size = UCTSearch::DEFAULT_MAX_MEMORY;
+    cfg_tree_eviction = false;
     cfg_max_cache_ratio_percent = 10;
     cfg_timemanage = TimeManagement::AUTO;
     cfg_lagbuffer_cs = 100;
@@ -353,11 +369,19 @@ void GTP::setup_default_parameters() {
     cfg_noise = false;
     cfg_fpu_root_reduction = cfg_fpu_reduction;
     cfg_ci_alpha = 1e-5f;
+    cfg_kl_threshold = 5e-6f;
     cfg_lcb_min_visit_ratio = 0.10f;
     cfg_random_cnt = 0;
     cfg_random_min_visits = 1;
     cfg_random_temp = 1.0f;
+    cfg_full_search_prob = 1.0f;
+    cfg_fast_visits = 400;
     cfg_dumbpass = false;
+    cfg_book_file = "";
+    cfg_build_book = "";
+    cfg_book_plies = 10;
+    cfg_workers = "";
+    cfg_listen = "";
     cfg_logfile_handle = nullptr;
     cfg_quiet = false;
     cfg_benchmark = false;
@@ -415,6 +439,8 @@ const std::string GTP::s_commands[] = {
     "lz-genmove_analyze",
     "lz-memory_report",
     "lz-setoption",
+    "lz-save_tree",
+    "lz-load_tree",
     "gomill-explain_last_move",
     ""
 };
@@ -437,12 +463,20 @@ std::string GTP::get_life_list(const GameState& game, const bool live) {
     std::string result;
     const auto& board = game.board;
 
-    if (live) {
-        for (int i = 0; i < board.get_boardsize(); i++) {
-            for (int j = 0; j < board.get_boardsize(); j++) {
-                int vertex = board.get_vertex(i, j);
+    // Stones are dead when they sit in the other side's pass-alive
+    // area, everything else is considered alive.
+    const auto black_area = board.calc_pass_alive(FastBoard::BLACK);
+    const auto white_area = board.calc_pass_alive(FastBoard::WHITE);
 
-                if (board.get_state(vertex) != FastBoard::EMPTY) {
+    for (int i = 0; i < board.get_boardsize(); i++) {
+        for (int j = 0; j < board.get_boardsize(); j++) {
+            int vertex = board.get_vertex(i, j);
+            const auto color = board.get_state(vertex);
+
+            if (color == FastBoard::BLACK || color == FastBoard::WHITE) {
+                const auto& other_area =
+                    color == FastBoard::BLACK ? white_area : black_area;
+                if (other_area.test(vertex) != live) {
                     stringlist.push_back(board.get_string(vertex));
                 }
             }
@@ -469,7 +503,9 @@ void GTP::execute(GameState& game, const std::string& xinput) {
     bool transform_lowercase = true;
 
     // Required on Unixy systems
-    if (xinput.find("loadsgf") != std::string::npos) {
+    if (xinput.find("loadsgf") != std::string::npos
+        || xinput.find("lz-save_tree") != std::string::npos
+        || xinput.find("lz-load_tree") != std::string::npos) {
         transform_lowercase = false;
     }
 
@@ -562,7 +598,7 @@ void GTP::execute(GameState& game, const std::string& xinput) {
         cmdstream >> tmp;
 
         if (!cmdstream.fail()) {
-            if (tmp != BOARD_SIZE) {
+            if (tmp != s_network->get_board_size()) {
                 gtp_fail_printf(id, "unacceptable size");
             } else {
                 float old_komi = game.get_komi();
@@ -912,16 +948,13 @@ void GTP::execute(GameState& game, const std::string& xinput) {
         gtp_printf_raw("=%s %s",
                        id == -1 ? "" : std::to_string(id).c_str(),
                        game.get_movenum() == 0 ? "\n" : "");
-        auto game_history = game.get_game_history();
-        // undone moves may still be present, so reverse the portion of the
-        // array we need and resize to trim it down for iteration.
-        std::reverse(begin(game_history),
-                     begin(game_history) + game.get_movenum() + 1);
-        game_history.resize(game.get_movenum());
-        for (const auto& state : game_history) {
-            auto coordinate = game.move_to_text(state->get_last_move());
-            auto color =
-                state->get_to_move() == FastBoard::WHITE ? "black" : "white";
+        const auto& move_history = game.get_move_history();
+        // undone moves may still be present, so only walk back from the
+        // current move.
+        for (auto i = game.get_movenum(); i > 0; i--) {
+            const auto& move = move_history[i - 1];
+            auto coordinate = game.move_to_text(move.vertex);
+            auto color = move.color == FastBoard::BLACK ? "black" : "white";
             gtp_printf_raw("%s %s\n", color, coordinate.c_str());
         }
         gtp_printf_raw("\n");
@@ -994,7 +1027,11 @@ void GTP::execute(GameState& game, const std::string& xinput) {
 
         try {
             sgftree->load_from_file(filename);
-            game = sgftree->follow_mainline_state(movenum - 1);
+            auto state = sgftree->follow_mainline_state(movenum - 1);
+            if (state.board.get_boardsize() != s_network->get_board_size()) {
+                throw std::runtime_error("Board size not supported.");
+            }
+            game = std::move(state);
             gtp_printf(id, "");
         } catch (const std::exception&) {
             gtp_fail_printf(id, "cannot load file");
@@ -1193,6 +1230,28 @@ void GTP::execute(GameState& game, const std::string& xinput) {
         return;
     } else if (command.find("lz-setoption") == 0) {
         return execute_setoption(*search.get(), id, command);
+    } else if (command.find("lz-save_tree") == 0
+               || command.find("lz-load_tree") == 0) {
+        std::istringstream cmdstream(command);
+        std::string tmp, filename;
+
+        cmdstream >> tmp >> filename;
+        if (cmdstream.fail()) {
+            gtp_fail_printf(id, "Missing filename.");
+            return;
+        }
+
+        try {
+            if (tmp == "lz-save_tree") {
+                search->save_tree(filename);
+            } else {
+                search->load_tree(filename);
+            }
+            gtp_printf(id, "");
+        } catch (const std::exception& e) {
+            gtp_fail_printf(id, "%s", e.what());
+        }
+        return;
     } else if (command.find("gomill-explain_last_move") == 0) {
         gtp_printf(id, "%s\n", search->explain_last_think().c_str());
         return;
@@ -1345,7 +1404,7 @@ void GTP::execute_setoption(UCTSearch& search, const int id,
         return;
     } else if (name == "visits") {
         std::istringstream valuestream(value);
-        int visits;
+        std::int64_t visits;
         valuestream >> visits;
         cfg_max_visits = visits;
 
@@ -1361,7 +1420,7 @@ void GTP::execute_setoption(UCTSearch& search, const int id,
         gtp_printf(id, "");
     } else if (name == "playouts") {
         std::istringstream valuestream(value);
-        int playouts;
+        std::int64_t playouts;
         valuestream >> playouts;
         cfg_max_playouts = playouts;
 
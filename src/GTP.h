@@ -32,10 +32,13 @@
 
 #include "config.h"
 
+#include <cstdint>
 #include <cstdio>
 #include <string>
 #include <vector>
 
+#include "Book.h"
+#include "Coordinator.h"
 #include "GameState.h"
 #include "Network.h"
 #include "UCTSearch.h"
@@ -81,11 +84,14 @@ private:
 extern bool cfg_gtp_mode;
 extern bool cfg_allow_pondering;
 extern unsigned int cfg_num_threads;
+extern bool cfg_numa;
 extern unsigned int cfg_batch_size;
-extern int cfg_max_playouts;
-extern int cfg_max_visits;
+extern unsigned int cfg_prefetch;
+extern std::int64_t cfg_max_playouts;
+extern std::int64_t cfg_max_visits;
 extern size_t cfg_max_memory;
 extern size_t cfg_max_tree_size;
+extern bool cfg_tree_eviction;
 extern int cfg_max_cache_ratio_percent;
 extern TimeManagement::enabled_t cfg_timemanage;
 extern int cfg_lagbuffer_cs;
@@ -94,8 +100,15 @@ extern int cfg_noise;
 extern int cfg_random_cnt;
 extern int cfg_random_min_visits;
 extern float cfg_random_temp;
+extern float cfg_full_search_prob;
+extern std::int64_t cfg_fast_visits;
 extern std::uint64_t cfg_rng_seed;
 extern bool cfg_dumbpass;
+extern std::string cfg_book_file;
+extern std::string cfg_build_book;
+extern int cfg_book_plies;
+extern std::string cfg_workers;
+extern std::string cfg_listen;
 #ifdef USE_OPENCL
 extern std::vector<int> cfg_gpus;
 extern bool cfg_sgemm_exhaustive;
@@ -114,6 +127,7 @@ extern float cfg_softmax_temp;
 extern float cfg_fpu_reduction;
 extern float cfg_fpu_root_reduction;
 extern float cfg_ci_alpha;
+extern float cfg_kl_threshold;
 extern float cfg_lcb_min_visit_ratio;
 extern std::string cfg_logfile;
 extern std::string cfg_weightsfile;
@@ -134,6 +148,10 @@ static constexpr size_t MiB = 1024LL * 1024LL;
 class GTP {
 public:
     static std::unique_ptr<Network> s_network;
+    // Opening book, null if none was loaded.
+    static std::unique_ptr<Book> s_book;
+    // Other engines searching along with us, null if none.
+    static std::unique_ptr<Coordinator> s_coordinator;
     static void initialize(std::unique_ptr<Network>&& network);
     static void execute(GameState& game, const std::string& xinput);
     static void setup_default_parameters();
@@ -39,15 +39,18 @@
 #include "FastBoard.h"
 #include "FastState.h"
 #include "FullBoard.h"
+#include "GTP.h"
 #include "KoState.h"
 #include "Network.h"
 #include "UCTSearch.h"
 
+constexpr size_t GameState::HISTORY_BOARDS;
+constexpr size_t GameState::CHECKPOINT_INTERVAL;
+
 void GameState::init_game(const int size, const float komi) {
     KoState::init_game(size, komi);
 
-    m_game_history.clear();
-    m_game_history.emplace_back(std::make_shared<KoState>(*this));
+    anchor_game_history();
 
     m_timecontrol.reset_clocks();
 
@@ -57,8 +60,7 @@ void GameState::init_game(const int size, const float komi) {
 void GameState::reset_game() {
     KoState::reset_game();
 
-    m_game_history.clear();
-    m_game_history.emplace_back(std::make_shared<KoState>(*this));
+    anchor_game_history();
 
     m_timecontrol.reset_clocks();
 
@@ -66,9 +68,10 @@ void GameState::reset_game() {
 }
 
 bool GameState::forward_move() {
-    if (m_game_history.size() > m_movenum + 1) {
-        m_movenum++;
-        *(static_cast<KoState*>(this)) = *m_game_history[m_movenum];
+    if (m_move_history.size() > m_movenum) {
+        const auto move = m_move_history[m_movenum];
+        KoState::play_move(move.color, move.vertex);
+        record_position();
         return true;
     } else {
         return false;
@@ -77,12 +80,7 @@ bool GameState::forward_move() {
 
 bool GameState::undo_move() {
     if (m_movenum > 0) {
-        m_movenum--;
-
-        // this is not so nice, but it should work
-        *(static_cast<KoState*>(this)) = *m_game_history[m_movenum];
-
-        // This also restores hashes as they're part of state
+        restore_position(m_movenum - 1);
         return true;
     } else {
         return false;
@@ -90,8 +88,42 @@ bool GameState::undo_move() {
 }
 
 void GameState::rewind() {
-    *(static_cast<KoState*>(this)) = *m_game_history[0];
-    m_movenum = 0;
+    restore_position(0);
+}
+
+void GameState::restore_position(const size_t movenum) {
+    assert(movenum <= m_move_history.size());
+    // Oldest position the board ring needs.
+    const auto first =
+        movenum >= HISTORY_BOARDS ? movenum - HISTORY_BOARDS + 1 : 0;
+    // Komi and handicap belong to the game, they can be set after the
+    // checkpoint was taken.
+    const auto komi = get_komi();
+    const auto handicap = get_handicap();
+
+    // This also restores hashes as they're part of state.  Moves played
+    // after set_unmake_point() have no checkpoints, replay those from the
+    // last one there is.
+    const auto checkpoint =
+        std::min(first / CHECKPOINT_INTERVAL, m_checkpoints.size() - 1);
+    *(static_cast<KoState*>(this)) = *m_checkpoints[checkpoint];
+    set_komi(komi);
+    set_handicap(handicap);
+    while (true) {
+        if (m_movenum >= first) {
+            record_position();
+        }
+        if (m_movenum == movenum) {
+            break;
+        }
+        const auto move = m_move_history[m_movenum];
+        KoState::play_move(move.color, move.vertex);
+    }
+    m_unmake_state.reset();
+}
+
+void GameState::record_position() {
+    m_board_ring[m_movenum % HISTORY_BOARDS].set(board);
 }
 
 void GameState::play_move(const int vertex) {
@@ -99,15 +131,44 @@ void GameState::play_move(const int vertex) {
 }
 
 void GameState::play_move(const int color, const int vertex) {
+    // cut off any leftover moves from navigating
+    m_move_history.resize(m_movenum);
+    if (m_checkpoints.size() > m_movenum / CHECKPOINT_INTERVAL + 1) {
+        m_checkpoints.resize(m_movenum / CHECKPOINT_INTERVAL + 1);
+    }
+    if (m_unmake_state && m_unmake_state->get_movenum() > m_movenum) {
+        m_unmake_state.reset();
+    }
+
     if (vertex == FastBoard::RESIGN) {
         m_resigned = color;
-    } else {
-        KoState::play_move(color, vertex);
+        return;
     }
 
-    // cut off any leftover moves from navigating
-    m_game_history.resize(m_movenum);
-    m_game_history.emplace_back(std::make_shared<KoState>(*this));
+    KoState::play_move(color, vertex);
+    m_move_history.push_back({color, vertex});
+    // Moves of a playout are taken back right away, so they don't get
+    // checkpoints, and neither do any moves after a missing one.
+    if (m_movenum % CHECKPOINT_INTERVAL == 0 && !m_unmake_state
+        && m_checkpoints.size() == m_movenum / CHECKPOINT_INTERVAL) {
+        m_checkpoints.emplace_back(std::make_shared<KoState>(*this));
+    }
+    record_position();
+}
+
+void GameState::set_unmake_point() {
+    m_unmake_state = std::make_shared<KoState>(*this);
+    m_unmake_ring = m_board_ring;
+}
+
+void GameState::unmake_moves() {
+    assert(m_unmake_state && m_unmake_state->get_movenum() <= m_movenum);
+    const auto movenum = m_unmake_state->get_movenum();
+    *(static_cast<KoState*>(this)) = *m_unmake_state;
+    m_board_ring = m_unmake_ring;
+    m_move_history.resize(movenum);
+    assert(m_checkpoints.size() <= movenum / CHECKPOINT_INTERVAL + 1);
+    m_resigned = FastBoard::EMPTY;
 }
 
 bool GameState::play_textmove(std::string color, const std::string& vertex) {
@@ -178,8 +239,11 @@ void GameState::adjust_time(const int color, const int time, const int stones) {
 void GameState::anchor_game_history() {
     // handicap moves don't count in game history
     m_movenum = 0;
-    m_game_history.clear();
-    m_game_history.emplace_back(std::make_shared<KoState>(*this));
+    m_move_history.clear();
+    m_checkpoints.clear();
+    m_checkpoints.emplace_back(std::make_shared<KoState>(*this));
+    m_unmake_state.reset();
+    record_position();
 }
 
 bool GameState::set_fixed_handicap(const int handicap) {
@@ -311,13 +375,50 @@ void GameState::place_free_handicap(int stones, Network& network) {
     set_handicap(orgstones);
 }
 
-const FullBoard& GameState::get_past_board(const int moves_ago) const {
-    assert(moves_ago >= 0 && (unsigned)moves_ago <= m_movenum);
-    assert(m_movenum + 1 <= m_game_history.size());
-    return m_game_history[m_movenum - moves_ago]->board;
+const PackedBoard& GameState::get_past_board(const int moves_ago) const {
+    assert(moves_ago >= 0 && size_t(moves_ago) < HISTORY_BOARDS
+           && size_t(moves_ago) <= m_movenum);
+    return m_board_ring[(m_movenum - moves_ago) % HISTORY_BOARDS];
+}
+
+std::vector<int> GameState::get_symmetries() const {
+    auto symmetries = std::vector<int>{};
+    // Moves to avoid or allow need not be symmetric, so a move can't
+    // stand for its equivalents then.
+    if (cfg_analyze_tags.has_move_restrictions()) {
+        return symmetries;
+    }
+    const auto size = board.get_boardsize();
+    const auto hash = board.get_hash();
+    const auto past_boards = std::min(m_movenum, HISTORY_BOARDS - 1);
+    for (auto sym = 0; sym < Network::NUM_SYMMETRIES; ++sym) {
+        if (sym == Network::IDENTITY_SYMMETRY
+            || get_symmetry_hash(sym) != hash) {
+            continue;
+        }
+        auto symmetric = true;
+        for (auto i = size_t{1}; i <= past_boards && symmetric; i++) {
+            const auto& past = get_past_board(i);
+            for (auto y = 0; y < size && symmetric; y++) {
+                for (auto x = 0; x < size; x++) {
+                    const auto sym_xy =
+                        Network::get_symmetry({x, y}, sym, size);
+                    if (past.get_state(x, y)
+                        != past.get_state(sym_xy.first, sym_xy.second)) {
+                        symmetric = false;
+                        break;
+                    }
+                }
+            }
+        }
+        if (symmetric) {
+            symmetries.emplace_back(sym);
+        }
+    }
+    return symmetries;
 }
 
-const std::vector<std::shared_ptr<const KoState>>&
-GameState::get_game_history() const {
-    return m_game_history;
+const std::vector<GameState::HistoryMove>&
+GameState::get_move_history() const {
+    return m_move_history;
 }
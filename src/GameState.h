@@ -30,6 +30,7 @@
 #ifndef GAMESTATE_H_INCLUDED
 #define GAMESTATE_H_INCLUDED
 
+#include <array>
 #include <memory>
 #include <string>
 #include <vector>
@@ -37,12 +38,26 @@
 #include "FastState.h"
 #include "FullBoard.h"
 #include "KoState.h"
+#include "PackedBoard.h"
 #include "TimeControl.h"
 
 class Network;
 
 class GameState : public KoState {
+    friend class LeelaTest;
+
 public:
+    // Number of past positions kept for get_past_board().
+    static constexpr size_t HISTORY_BOARDS = 8;
+    // A full position is kept every this many moves, other positions
+    // are reconstructed by replaying the moves after it.
+    static constexpr size_t CHECKPOINT_INTERVAL = 16;
+
+    struct HistoryMove {
+        int color;
+        int vertex;
+    };
+
     explicit GameState() = default;
     explicit GameState(const KoState* rhs) {
         // Copy in fields from base class.
@@ -59,13 +74,28 @@ public:
     void rewind(); /* undo infinite */
     bool undo_move();
     bool forward_move();
-    const FullBoard& get_past_board(int moves_ago) const;
-    const std::vector<std::shared_ptr<const KoState>>& get_game_history() const;
+    const PackedBoard& get_past_board(int moves_ago) const;
+    // Symmetries other than the identity that leave both the position
+    // and the past positions the network sees unchanged.  None while
+    // lz-analyze restricts the moves.
+    std::vector<int> get_symmetries() const;
+    // Moves from the start of the game, including undone ones that
+    // forward_move() can replay.
+    const std::vector<HistoryMove>& get_move_history() const;
 
     void play_move(int color, int vertex);
     void play_move(int vertex);
     bool play_textmove(std::string color, const std::string& vertex);
 
+    // Make/unmake interface for the search.  set_unmake_point() remembers
+    // the position as it is, including komi and side to move set after
+    // the last move.  unmake_moves() takes back every move played since
+    // and forgets them, which is a plain copy of the remembered position.
+    // Moves in between take no checkpoints, so once the vectors have
+    // grown a playout allocates nothing.
+    void set_unmake_point();
+    void unmake_moves();
+
     void start_clock(int color);
     void stop_clock(int color);
     const TimeControl& get_timecontrol() const;
@@ -80,8 +110,18 @@ public:
 
 private:
     bool valid_handicap(int stones);
-
-    std::vector<std::shared_ptr<const KoState>> m_game_history;
+    void restore_position(size_t movenum);
+    void record_position();
+
+    std::vector<HistoryMove> m_move_history;
+    // Position after every CHECKPOINT_INTERVAL moves.
+    std::vector<std::shared_ptr<const KoState>> m_checkpoints;
+    // Stones of the last HISTORY_BOARDS positions, indexed by
+    // movenum % HISTORY_BOARDS.
+    std::array<PackedBoard, HISTORY_BOARDS> m_board_ring;
+    // Position unmake_moves() returns to.
+    std::shared_ptr<const KoState> m_unmake_state;
+    std::array<PackedBoard, HISTORY_BOARDS> m_unmake_ring;
     TimeControl m_timecontrol;
     int m_resigned{FastBoard::EMPTY};
 };
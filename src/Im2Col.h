@@ -34,11 +34,20 @@
 #include <cassert>
 #include <vector>
 
-template <unsigned long filter_size>
+template <unsigned long filter_size, unsigned int board_size>
 void im2col(const int channels, const std::vector<float>& input,
             std::vector<float>& output) {
-    constexpr unsigned int height = BOARD_SIZE;
-    constexpr unsigned int width = BOARD_SIZE;
+    constexpr unsigned int height = board_size;
+    constexpr unsigned int width = board_size;
+    constexpr auto num_intersections = width * height;
+
+    if (filter_size == 1) {
+        // Nothing to rearrange for 1x1 filters
+        const auto outSize = size_t{channels * size_t{num_intersections}};
+        assert(output.size() == outSize);
+        std::copy(begin(input), begin(input) + outSize, begin(output));
+        return;
+    }
 
     constexpr int pad = (filter_size / 2);
     constexpr unsigned int output_h = height + 2 * pad - filter_size + 1;
@@ -47,7 +56,7 @@ void im2col(const int channels, const std::vector<float>& input,
     const float* data_im = input.data();
     float* data_col = output.data();
 
-    for (int channel = channels; channel--; data_im += NUM_INTERSECTIONS) {
+    for (int channel = channels; channel--; data_im += num_intersections) {
         for (unsigned int kernel_row = 0; kernel_row < filter_size;
              kernel_row++) {
             for (unsigned int kernel_col = 0; kernel_col < filter_size;
@@ -79,12 +88,4 @@ void im2col(const int channels, const std::vector<float>& input,
     }
 }
 
-template <>
-void im2col<1>(const int channels, const std::vector<float>& input,
-               std::vector<float>& output) {
-    auto outSize = size_t{channels * static_cast<size_t>(NUM_INTERSECTIONS)};
-    assert(output.size() == outSize);
-    std::copy(begin(input), begin(input) + outSize, begin(output));
-}
-
 #endif
@@ -39,29 +39,66 @@
 #include "FastState.h"
 #include "FullBoard.h"
 
+constexpr size_t KoState::MIN_KO_HASH_SLOTS;
+
 void KoState::init_game(const int size, const float komi) {
     assert(size <= BOARD_SIZE);
 
     FastState::init_game(size, komi);
 
-    m_ko_hash_history.clear();
-    m_ko_hash_history.emplace_back(board.get_ko_hash());
+    clear_ko_hashes();
 }
 
 bool KoState::superko() const {
-    auto first = crbegin(m_ko_hash_history);
-    auto last = crend(m_ko_hash_history);
-
-    auto res = std::find(++first, last, board.get_ko_hash());
-
-    return (res != last);
+    return m_superko;
 }
 
 void KoState::reset_game() {
     FastState::reset_game();
 
-    m_ko_hash_history.clear();
-    m_ko_hash_history.push_back(board.get_ko_hash());
+    clear_ko_hashes();
+}
+
+void KoState::clear_ko_hashes() {
+    m_ko_hashes.assign(MIN_KO_HASH_SLOTS, 0);
+    m_ko_hash_count = 0;
+    insert_ko_hash(board.get_ko_hash());
+    m_superko = false;
+}
+
+bool KoState::insert_ko_hash(std::uint64_t ko_hash) {
+    // Zero marks empty slots, store a (vanishingly unlikely) zero hash
+    // as one instead.
+    ko_hash = std::max(ko_hash, std::uint64_t{1});
+
+    // Keep the load factor at or below 1/2 so probe runs stay short.
+    if (2 * (m_ko_hash_count + 1) > m_ko_hashes.size()) {
+        // Both vectors keep their capacity, so a search growing the set
+        // again after unmake_moves() doesn't allocate.
+        static thread_local auto old_hashes = std::vector<std::uint64_t>{};
+        old_hashes.assign(cbegin(m_ko_hashes), cend(m_ko_hashes));
+        m_ko_hashes.assign(2 * old_hashes.size(), 0);
+        for (const auto hash : old_hashes) {
+            if (hash != 0) {
+                auto slot = hash & (m_ko_hashes.size() - 1);
+                while (m_ko_hashes[slot] != 0) {
+                    slot = (slot + 1) & (m_ko_hashes.size() - 1);
+                }
+                m_ko_hashes[slot] = hash;
+            }
+        }
+    }
+
+    auto slot = ko_hash & (m_ko_hashes.size() - 1);
+    while (m_ko_hashes[slot] != 0) {
+        if (m_ko_hashes[slot] == ko_hash) {
+            return false;
+        }
+        slot = (slot + 1) & (m_ko_hashes.size() - 1);
+    }
+    m_ko_hashes[slot] = ko_hash;
+    m_ko_hash_count++;
+    return true;
 }
 
 void KoState::play_move(const int vertex) {
@@ -72,5 +109,5 @@ void KoState::play_move(const int color, const int vertex) {
     if (vertex != FastBoard::RESIGN) {
         FastState::play_move(color, vertex);
     }
-    m_ko_hash_history.push_back(board.get_ko_hash());
+    m_superko = !insert_ko_hash(board.get_ko_hash());
 }
@@ -32,13 +32,19 @@
 
 #include "config.h"
 
+#include <cstdint>
 #include <vector>
 
 #include "FastState.h"
 #include "FullBoard.h"
 
 class KoState : public FastState {
+    friend class LeelaTest;
+
 public:
+    // Initial size of the ko hash set, must be a power of two.
+    static constexpr size_t MIN_KO_HASH_SLOTS = 64;
+
     void init_game(int size, float komi);
     bool superko() const;
     void reset_game();
@@ -47,7 +53,16 @@ public:
     void play_move(int vertex);
 
 private:
-    std::vector<std::uint64_t> m_ko_hash_history;
+    void clear_ko_hashes();
+    // Returns false if the hash was already in the set.
+    bool insert_ko_hash(std::uint64_t ko_hash);
+
+    // Ko hashes of every position so far, as an open addressing hash
+    // set with linear probing.  A zero marks an empty slot.
+    std::vector<std::uint64_t> m_ko_hashes;
+    size_t m_ko_hash_count{0};
+    // The current position appeared before.
+    bool m_superko{false};
 };
 
 #endif
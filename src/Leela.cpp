@@ -41,11 +41,14 @@
 #include <string>
 #include <vector>
 
+#include "Book.h"
+#include "Coordinator.h"
 #include "GTP.h"
 #include "GameState.h"
 #include "NNCache.h"
 #include "Network.h"
 #include "Random.h"
+#include "SMP.h"
 #include "ThreadPool.h"
 #include "Utils.h"
 #include "Zobrist.h"
@@ -142,10 +145,12 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         ("gtp,g", "Enable GTP mode.")
         ("threads,t", po::value<unsigned int>()->default_value(0),
                       "Number of threads to use. Select 0 to let leela-zero pick a reasonable default.")
-        ("playouts,p", po::value<int>(),
+        ("numa", "Pin threads to NUMA nodes and keep weights and cache "
+                 "node-local.")
+        ("playouts,p", po::value<std::int64_t>(),
                        "Weaken engine by limiting the number of playouts. "
                        "Requires --noponder.")
-        ("visits,v", po::value<int>(),
+        ("visits,v", po::value<std::int64_t>(),
                      "Weaken engine by limiting the number of visits.")
         ("lagbuffer,b", po::value<int>()->default_value(cfg_lagbuffer_cs),
                         "Safety margin for time usage in centiseconds.")
@@ -158,13 +163,18 @@ static void parse_commandline(const int argc, const char* const argv[]) {
                       "File to log input/output to.")
         ("quiet,q", "Disable all diagnostic output.")
         ("timemanage", po::value<std::string>()->default_value("auto"),
-                       "[auto|on|off|fast|no_pruning] Enable time management features.\n"
+                       "[auto|on|off|fast|no_pruning|converge] Enable time management features.\n"
                        "auto = no_pruning when using -n, otherwise on.\n"
                        "on = Cut off search when the best move can't change"
                        ", but use full time if moving faster doesn't save time.\n"
                        "fast = Same as on but always plays faster.\n"
-                       "no_pruning = For self play training use.\n")
+                       "no_pruning = For self play training use.\n"
+                       "converge = Same as on, but also stop once the "
+                       "visit distribution has stopped changing.\n")
         ("noponder", "Disable thinking on opponent's time.")
+        ("tree-eviction", "Evict rarely visited parts of the search tree "
+                          "instead of stopping the search when the tree "
+                          "memory is full.")
         ("benchmark", "Test network and exit. Default args:\n-v3200 --noponder "
                       "-m0 -t1 -s1.")
 #ifndef USE_CPU_ONLY
@@ -180,6 +190,9 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         ("tune-only", "Tune OpenCL only and then exit.")
         ("batchsize", po::value<unsigned int>()->default_value(0),
                       "Max batch size.  Select 0 to let leela-zero pick a reasonable default.")
+        ("prefetch", po::value<unsigned int>()->default_value(cfg_prefetch),
+                     "Evaluate the x most likely children of new nodes "
+                     "in spare batch slots.")
 #ifdef USE_HALF
         ("precision", po::value<std::string>(),
                       "Floating-point precision (single/half/auto).\n"
@@ -198,7 +211,33 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         ("randomvisits", po::value<int>()->default_value(cfg_random_min_visits),
                          "Don't play random moves if they have <= x visits.")
         ("randomtemp", po::value<float>()->default_value(cfg_random_temp),
-                       "Temperature to use for random move selection.");
+                       "Temperature to use for random move selection.")
+        ("fullsearchprob", po::value<float>()->default_value(cfg_full_search_prob),
+                           "Only search this share of the moves with full "
+                           "visits and noise, and record only those for "
+                           "training. The others get a fast search.")
+        ("fastvisits", po::value<std::int64_t>()->default_value(cfg_fast_visits),
+                       "Visits of the fast searches.");
+    po::options_description book_desc("Opening book options");
+    book_desc.add_options()
+        ("book", po::value<std::string>(),
+                 "Play the opening from this book file.")
+        ("book-plies", po::value<int>()->default_value(cfg_book_plies),
+                       "Use the book, or build it, for the first x moves.")
+        ("build-book", po::value<std::string>(),
+                       "Search the openings and write a book to this file, "
+                       "then exit. Use -v to set the visits per position.");
+    po::options_description dist_desc("Multi-process options");
+    dist_desc.add_options()
+        ("workers", po::value<std::string>(),
+                    "Search together with the engines serving GTP on these "
+                    "comma separated endpoints. An endpoint is host:port, "
+                    "port for localhost, or unix:path.")
+        ("listen", po::value<std::string>(),
+                   "Serve GTP on this endpoint instead of the console, "
+                   "to act as a worker. Implies --gtp. There is no "
+                   "authentication, anyone who can connect controls "
+                   "the engine, keep it on localhost or a trusted network.");
 #ifdef USE_TUNER
     po::options_description tuner_desc("Tuning options");
     tuner_desc.add_options()
@@ -207,7 +246,8 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         ("logconst", po::value<float>())
         ("softmax_temp", po::value<float>())
         ("fpu_reduction", po::value<float>())
-        ("ci_alpha", po::value<float>());
+        ("ci_alpha", po::value<float>())
+        ("kl_threshold", po::value<float>());
 #endif
     // These won't be shown, we use them to catch incorrect usage of the
     // command line.
@@ -227,6 +267,8 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         .add(gpu_desc)
 #endif
         .add(selfplay_desc)
+        .add(book_desc)
+        .add(dist_desc)
 #ifdef USE_TUNER
         .add(tuner_desc);
 #else
@@ -295,6 +337,9 @@ static void parse_commandline(const int argc, const char* const argv[]) {
     if (vm.count("ci_alpha")) {
         cfg_ci_alpha = vm["ci_alpha"].as<float>();
     }
+    if (vm.count("kl_threshold")) {
+        cfg_kl_threshold = vm["kl_threshold"].as<float>();
+    }
 #endif
 
     if (vm.count("logfile")) {
@@ -369,10 +414,16 @@ static void parse_commandline(const int argc, const char* const argv[]) {
 #ifdef USE_OPENCL
         calculate_thread_count_gpu(vm);
         myprintf("Using OpenCL batch size of %d\n", cfg_batch_size);
+        cfg_prefetch = vm["prefetch"].as<unsigned int>();
 #endif
     }
     myprintf("Using %d thread(s).\n", cfg_num_threads);
 
+    if (vm.count("numa")) {
+        cfg_numa = true;
+        myprintf("Using %zu NUMA node(s).\n", SMP::get_num_numa_nodes());
+    }
+
     if (vm.count("seed")) {
         cfg_rng_seed = vm["seed"].as<std::uint64_t>();
         if (cfg_num_threads > 1) {
@@ -382,6 +433,10 @@ static void parse_commandline(const int argc, const char* const argv[]) {
     }
     myprintf("RNG seed: %llu\n", cfg_rng_seed);
 
+    if (vm.count("tree-eviction")) {
+        cfg_tree_eviction = true;
+    }
+
     if (vm.count("noponder")) {
         cfg_allow_pondering = false;
     }
@@ -395,7 +450,7 @@ static void parse_commandline(const int argc, const char* const argv[]) {
     }
 
     if (vm.count("playouts")) {
-        cfg_max_playouts = vm["playouts"].as<int>();
+        cfg_max_playouts = vm["playouts"].as<std::int64_t>();
         if (!vm.count("noponder")) {
             printf("Nonsensical options: Playouts are restricted but "
                    "thinking on the opponent's time is still allowed. "
@@ -410,7 +465,7 @@ static void parse_commandline(const int argc, const char* const argv[]) {
     }
 
     if (vm.count("visits")) {
-        cfg_max_visits = vm["visits"].as<int>();
+        cfg_max_visits = vm["visits"].as<std::int64_t>();
 
         // 0 may be specified to mean "no limit"
         if (cfg_max_visits == 0) {
@@ -434,6 +489,36 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         cfg_random_temp = vm["randomtemp"].as<float>();
     }
 
+    if (vm.count("fullsearchprob")) {
+        cfg_full_search_prob = vm["fullsearchprob"].as<float>();
+        if (!(cfg_full_search_prob >= 0.0f && cfg_full_search_prob <= 1.0f)) {
+            printf("Nonsensical options: --fullsearchprob must be "
+                   "between 0 and 1.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (vm.count("fastvisits")) {
+        cfg_fast_visits = vm["fastvisits"].as<std::int64_t>();
+    }
+
+    if (vm.count("book")) {
+        cfg_book_file = vm["book"].as<std::string>();
+    }
+
+    if (vm.count("book-plies")) {
+        cfg_book_plies = vm["book-plies"].as<int>();
+    }
+
+    if (vm.count("workers")) {
+        cfg_workers = vm["workers"].as<std::string>();
+    }
+
+    if (vm.count("listen")) {
+        cfg_listen = vm["listen"].as<std::string>();
+        cfg_gtp_mode = true;
+    }
+
     if (vm.count("timemanage")) {
         auto tm = vm["timemanage"].as<std::string>();
         if (tm == "auto") {
@@ -446,6 +531,8 @@ static void parse_commandline(const int argc, const char* const argv[]) {
             cfg_timemanage = TimeManagement::FAST;
         } else if (tm == "no_pruning") {
             cfg_timemanage = TimeManagement::NO_PRUNING;
+        } else if (tm == "converge") {
+            cfg_timemanage = TimeManagement::CONVERGE;
         } else {
             printf("Invalid timemanage value.\n");
             exit(EXIT_FAILURE);
@@ -478,6 +565,20 @@ static void parse_commandline(const int argc, const char* const argv[]) {
         }
     }
 
+    if (vm.count("build-book")) {
+        cfg_build_book = vm["build-book"].as<std::string>();
+        // The book should hold the best moves, not random ones.
+        cfg_allow_pondering = false;
+        cfg_noise = false;
+        cfg_random_cnt = 0;
+        cfg_timemanage = TimeManagement::OFF;
+        cfg_book_file = "";
+
+        if (!vm.count("playouts") && !vm.count("visits")) {
+            cfg_max_visits = 3200;
+        }
+    }
+
     // Do not lower the expected eval for root moves that are likely not
     // the best if we have introduced noise there exactly to explore more.
     cfg_fpu_root_reduction = cfg_noise ? 0.0f : cfg_fpu_reduction;
@@ -500,9 +601,37 @@ static void initialize_network() {
     GTP::initialize(std::move(network));
 }
 
+static void initialize_book() {
+    try {
+        GTP::s_book = std::make_unique<Book>(cfg_book_file);
+    } catch (const std::exception& e) {
+        myprintf("Could not load book file %s: %s\n", cfg_book_file.c_str(),
+                 e.what());
+        exit(EXIT_FAILURE);
+    }
+    myprintf("Loaded %zu book positions.\n", GTP::s_book->size());
+}
+
+static void initialize_coordinator() {
+    try {
+        GTP::s_coordinator = std::make_unique<Coordinator>(cfg_workers);
+    } catch (const std::exception& e) {
+        myprintf("Could not connect to workers: %s\n", e.what());
+        exit(EXIT_FAILURE);
+    }
+    myprintf("Searching with %zu worker(s).\n", GTP::s_coordinator->size());
+}
+
 // Setup global objects after command line has been parsed
 void init_global_objects() {
-    thread_pool.initialize(cfg_num_threads);
+    if (cfg_numa) {
+        for (auto i = size_t{0}; i < cfg_num_threads; i++) {
+            const auto node = SMP::numa_node_for_thread(i, cfg_num_threads);
+            thread_pool.add_thread([node] { SMP::bind_to_numa_node(node); });
+        }
+    } else {
+        thread_pool.initialize(cfg_num_threads);
+    }
 
     // Use deterministic random numbers for hashing
     auto rng = std::make_unique<Random>(5489);
@@ -516,6 +645,14 @@ void init_global_objects() {
     Utils::create_z_table();
 
     initialize_network();
+
+    if (!cfg_book_file.empty()) {
+        initialize_book();
+    }
+
+    if (!cfg_workers.empty()) {
+        initialize_coordinator();
+    }
 }
 
 void benchmark(GameState& game) {
@@ -549,12 +686,22 @@ int main(int argc, char* argv[]) {
         license_blurb();
     }
 
+    if (!cfg_listen.empty()) {
+        try {
+            Coordinator::serve(cfg_listen);
+        } catch (const std::exception& e) {
+            myprintf("Could not serve GTP on %s: %s\n", cfg_listen.c_str(),
+                     e.what());
+            exit(EXIT_FAILURE);
+        }
+    }
+
     init_global_objects();
 
     auto maingame = std::make_unique<GameState>();
 
     /* set board limits */
-    maingame->init_game(BOARD_SIZE, KOMI);
+    maingame->init_game(GTP::s_network->get_board_size(), KOMI);
 
     if (cfg_benchmark) {
         cfg_quiet = false;
@@ -562,6 +709,13 @@ int main(int argc, char* argv[]) {
         return 0;
     }
 
+    if (!cfg_build_book.empty()) {
+        maingame->set_timecontrol(0, 1, 0, 0); // Set infinite time.
+        const auto built = Book::build(*maingame, *GTP::s_network,
+                                       cfg_build_book, cfg_book_plies);
+        return built ? 0 : 1;
+    }
+
     for (;;) {
         if (!cfg_gtp_mode) {
             maingame->display_state();
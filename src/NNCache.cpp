@@ -29,12 +29,14 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <functional>
 #include <memory>
 
 #include "NNCache.h"
 
 #include "GTP.h"
+#include "SMP.h"
 #include "UCTSearch.h"
 #include "Utils.h"
 
@@ -42,75 +44,167 @@ const int NNCache::MAX_CACHE_COUNT;
 const int NNCache::MIN_CACHE_COUNT;
 const size_t NNCache::ENTRY_SIZE;
 
-NNCache::NNCache(const int size) : m_size(size) {}
+NNCache::NNCache(const int size) : m_size(size) {
+    set_partitions(1);
+}
+
+void NNCache::set_partitions(const size_t count) {
+    m_partitions.clear();
+    for (auto i = size_t{0}; i < std::max(count, size_t{1}); i++) {
+        m_partitions.emplace_back(std::make_unique<Partition>());
+    }
+    resize(m_size);
+}
+
+NNCache::Partition& NNCache::local_partition() {
+    return *m_partitions[SMP::get_numa_node() % m_partitions.size()];
+}
 
 bool NNCache::lookup(const std::uint64_t hash, Netresult& result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    ++m_lookups;
+    auto& local = local_partition();
+    {
+        std::lock_guard<std::mutex> lock(local.mutex);
+        ++local.lookups;
+
+        auto iter = local.cache.find(hash);
+        if (iter != local.cache.end()) {
+            local.hit(*iter->second);
+            result = iter->second->result;
+            return true;
+        }
+    }
 
-    auto iter = m_cache.find(hash);
-    if (iter == m_cache.end()) {
-        return false; // Not found.
+    // Another node may have evaluated this position already.
+    for (auto& partition : m_partitions) {
+        if (partition.get() == &local) {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(partition->mutex);
+        auto iter = partition->cache.find(hash);
+        if (iter != partition->cache.end()) {
+            partition->hit(*iter->second);
+            result = iter->second->result;
+            return true;
+        }
     }
+    return false; // Not found.
+}
 
-    const auto& entry = iter->second;
+void NNCache::Partition::hit(const Entry& entry) {
+    ++hits;
+    if (entry.prefetched) {
+        entry.prefetched = false;
+        ++prefetch_hits;
+    }
+}
 
-    // Found it.
-    ++m_hits;
-    result = entry->result;
-    return true;
+bool NNCache::contains(const std::uint64_t hash) {
+    for (auto& partition : m_partitions) {
+        std::lock_guard<std::mutex> lock(partition->mutex);
+        if (partition->cache.find(hash) != partition->cache.end()) {
+            return true;
+        }
+    }
+    return false;
 }
 
-void NNCache::insert(const std::uint64_t hash, const Netresult& result) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+void NNCache::insert(const std::uint64_t hash, const Netresult& result,
+                     const bool prefetched) {
+    auto& partition = local_partition();
+    std::lock_guard<std::mutex> lock(partition.mutex);
 
-    if (m_cache.find(hash) != m_cache.end()) {
+    if (partition.cache.find(hash) != partition.cache.end()) {
         return; // Already in the cache.
     }
 
-    m_cache.emplace(hash, std::make_unique<Entry>(result));
-    m_order.push_back(hash);
-    ++m_inserts;
+    partition.cache.emplace(hash, std::make_unique<Entry>(result, prefetched));
+    partition.order.push_back(hash);
+    ++partition.inserts;
+    if (prefetched) {
+        ++partition.prefetch_inserts;
+    }
 
     // If the cache is too large, remove the oldest entry.
-    if (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+    partition.trim();
+}
+
+void NNCache::Partition::trim() {
+    while (order.size() > size) {
+        cache.erase(order.front());
+        order.pop_front();
     }
 }
 
 void NNCache::resize(const int size) {
     m_size = size;
-    while (m_order.size() > m_size) {
-        m_cache.erase(m_order.front());
-        m_order.pop_front();
+    const auto count = m_partitions.size();
+    for (auto& partition : m_partitions) {
+        std::lock_guard<std::mutex> lock(partition->mutex);
+        partition->size = (m_size + count - 1) / count;
+        partition->trim();
     }
 }
 
 void NNCache::clear() {
-    m_cache.clear();
-    m_order.clear();
+    for (auto& partition : m_partitions) {
+        std::lock_guard<std::mutex> lock(partition->mutex);
+        partition->cache.clear();
+        partition->order.clear();
+    }
+}
+
+std::pair<int, int> NNCache::hit_rate() const {
+    auto hits = 0;
+    auto lookups = 0;
+    for (const auto& partition : m_partitions) {
+        hits += partition->hits;
+        lookups += partition->lookups;
+    }
+    return {hits, lookups};
 }
 
-void NNCache::set_size_from_playouts(const int max_playouts) {
+void NNCache::set_size_from_playouts(const std::int64_t max_playouts) {
     // cache hits are generally from last several moves so setting cache
     // size based on playouts increases the hit rate while balancing memory
     // usage for low playout instances. 150'000 cache entries is ~208 MiB
     constexpr auto num_cache_moves = 3;
     auto max_playouts_per_move =
         std::min(max_playouts, UCTSearch::UNLIMITED_PLAYOUTS / num_cache_moves);
-    auto max_size = num_cache_moves * max_playouts_per_move;
-    max_size = std::min(MAX_CACHE_COUNT, std::max(MIN_CACHE_COUNT, max_size));
-    resize(max_size);
+    const auto max_size =
+        std::min(std::int64_t{MAX_CACHE_COUNT},
+                 std::max(std::int64_t{MIN_CACHE_COUNT},
+                          num_cache_moves * max_playouts_per_move));
+    resize(int(max_size));
 }
 
 void NNCache::dump_stats() {
+    auto inserts = 0;
+    auto prefetch_inserts = 0;
+    auto prefetch_hits = 0;
+    auto entries = size_t{0};
+    for (const auto& partition : m_partitions) {
+        inserts += partition->inserts;
+        prefetch_inserts += partition->prefetch_inserts;
+        prefetch_hits += partition->prefetch_hits;
+        entries += partition->cache.size();
+    }
+    const auto hits = hit_rate();
     Utils::myprintf(
-        "NNCache: %d/%d hits/lookups = %.1f%% hitrate, %d inserts, %u size\n",
-        m_hits, m_lookups, 100. * m_hits / (m_lookups + 1), m_inserts,
-        m_cache.size());
+        "NNCache: %d/%d hits/lookups = %.1f%% hitrate, %d inserts, %zu size\n",
+        hits.first, hits.second, 100. * hits.first / (hits.second + 1),
+        inserts, entries);
+    if (prefetch_inserts > 0) {
+        // Prefetches that were never looked up are wasted evaluations.
+        Utils::myprintf("NNCache: %d prefetches, %d hits, %d wasted\n",
+                        prefetch_inserts, prefetch_hits,
+                        prefetch_inserts - prefetch_hits);
+    }
 }
 
 size_t NNCache::get_estimated_size() {
-    return m_order.size() * NNCache::ENTRY_SIZE;
+    auto entries = size_t{0};
+    for (const auto& partition : m_partitions) {
+        entries += partition->order.size();
+    }
+    return entries * NNCache::ENTRY_SIZE;
 }
@@ -33,10 +33,12 @@
 #include "config.h"
 
 #include <array>
+#include <cstdint>
 #include <deque>
 #include <memory>
 #include <mutex>
 #include <unordered_map>
+#include <vector>
 
 class NNCache {
 public:
@@ -68,22 +70,30 @@ public:
     NNCache(int size = MAX_CACHE_COUNT); // ~ 208MiB
 
     // Set a reasonable size gives max number of playouts
-    void set_size_from_playouts(int max_playouts);
+    void set_size_from_playouts(std::int64_t max_playouts);
 
     // Resize NNCache
     void resize(int size);
     void clear();
 
+    // Split the cache into one partition per NUMA node.  Entries are
+    // inserted into the partition of the calling thread's node, lookups
+    // check the local partition first.
+    void set_partitions(size_t count);
+
     // Try and find an existing entry.
     bool lookup(std::uint64_t hash, Netresult& result);
 
-    // Insert a new entry.
-    void insert(std::uint64_t hash, const Netresult& result);
+    // Check for an entry without counting it as a lookup.
+    bool contains(std::uint64_t hash);
+
+    // Insert a new entry.  Prefetched entries are tracked to tell how
+    // many of them the search ended up using.
+    void insert(std::uint64_t hash, const Netresult& result,
+                bool prefetched = false);
 
     // Return the hit rate ratio.
-    std::pair<int, int> hit_rate() const {
-        return {m_hits, m_lookups};
-    }
+    std::pair<int, int> hit_rate() const;
 
     void dump_stats();
 
@@ -91,24 +101,39 @@ public:
     size_t get_estimated_size();
 
 private:
-    std::mutex m_mutex;
+    struct Entry {
+        Entry(const Netresult& r, const bool p) : result(r), prefetched(p) {}
+        Netresult result; // ~ 1.4KiB
+        // Prefetched and not looked up yet, protected by the partition lock.
+        mutable bool prefetched;
+    };
 
-    size_t m_size;
+    struct Partition {
+        std::mutex mutex;
 
-    // Statistics
-    int m_hits{0};
-    int m_lookups{0};
-    int m_inserts{0};
+        size_t size;
 
-    struct Entry {
-        Entry(const Netresult& r) : result(r) {}
-        Netresult result; // ~ 1.4KiB
+        // Statistics
+        int hits{0};
+        int lookups{0};
+        int inserts{0};
+        int prefetch_inserts{0};
+        int prefetch_hits{0};
+
+        // Map from hash to {features, result}
+        std::unordered_map<std::uint64_t, std::unique_ptr<const Entry>> cache;
+        // Order entries were added to the map.
+        std::deque<size_t> order;
+
+        void hit(const Entry& entry);
+        void trim();
     };
 
-    // Map from hash to {features, result}
-    std::unordered_map<std::uint64_t, std::unique_ptr<const Entry>> m_cache;
-    // Order entries were added to the map.
-    std::deque<size_t> m_order;
+    Partition& local_partition();
+
+    size_t m_size;
+
+    std::vector<std::unique_ptr<Partition>> m_partitions;
 };
 
 #endif
@@ -55,6 +55,7 @@
 #endif
 #include "CPUPipe.h"
 #include "Network.h"
+#include "NumaPipe.h"
 #include "zlib.h"
 #ifdef USE_OPENCL
 #include "OpenCLScheduler.h"
@@ -66,7 +67,9 @@
 #include "GTP.h"
 #include "GameState.h"
 #include "NNCache.h"
+#include "PackedBoard.h"
 #include "Random.h"
+#include "SMP.h"
 #include "ThreadPool.h"
 #include "Timing.h"
 #include "Utils.h"
@@ -86,9 +89,28 @@ using ConstEigenMatrixMap =
     Eigen::Map<const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>>;
 #endif
 
-// Symmetry helper
-static std::array<std::array<int, NUM_INTERSECTIONS>, Network::NUM_SYMMETRIES>
-    symmetry_nn_idx_table;
+// Symmetry helper, built on first use for each board size
+template <int board_size>
+using SymmetryTable = std::array<std::array<int, board_size * board_size>,
+                                 Network::NUM_SYMMETRIES>;
+
+template <int board_size>
+static const SymmetryTable<board_size>& symmetry_nn_idx_table() {
+    static const auto table = [] {
+        auto table = SymmetryTable<board_size>{};
+        for (auto s = 0; s < Network::NUM_SYMMETRIES; ++s) {
+            for (auto v = 0; v < board_size * board_size; ++v) {
+                const auto newvtx = Network::get_symmetry(
+                    {v % board_size, v / board_size}, s, board_size);
+                table[s][v] = (newvtx.second * board_size) + newvtx.first;
+                assert(table[s][v] >= 0
+                       && table[s][v] < board_size * board_size);
+            }
+        }
+        return table;
+    }();
+    return table;
+}
 
 float Network::benchmark_time(const int centiseconds) {
     const auto cpus = cfg_num_threads;
@@ -97,7 +119,7 @@ float Network::benchmark_time(const int centiseconds) {
     std::atomic<int> runcount{0};
 
     GameState state;
-    state.init_game(BOARD_SIZE, KOMI);
+    state.init_game(m_board_size, KOMI);
 
     // As a sanity run, try one run with self check.
     // Isn't enough to guarantee correctness but better than nothing,
@@ -304,11 +326,20 @@ std::pair<int, int> Network::load_v1_network(std::istream& wtfile) {
                               begin(m_bn_pol_w2));
                     break;
                 case 4:
-                    if (weights.size()
-                        != OUTPUTS_POLICY * NUM_INTERSECTIONS
-                               * POTENTIAL_MOVES) {
-                        myprintf("The weights file is not for %dx%d boards.\n",
-                                 BOARD_SIZE, BOARD_SIZE);
+                    // The policy layer maps every intersection to every
+                    // move, so its size tells which board it is for.
+                    m_board_size = 0;
+                    for (auto size = 1; size <= BOARD_SIZE; size++) {
+                        const auto points = size_t(size * size);
+                        if (is_supported_board_size(size)
+                            && weights.size()
+                                   == OUTPUTS_POLICY * points * (points + 1)) {
+                            m_board_size = size;
+                        }
+                    }
+                    if (m_board_size == 0) {
+                        myprintf("The weights file is not for a supported "
+                                 "board size.\n");
                         return {0, 0};
                     }
                     std::copy(cbegin(weights), cend(weights),
@@ -329,6 +360,13 @@ std::pair<int, int> Network::load_v1_network(std::istream& wtfile) {
                               begin(m_bn_val_w2));
                     break;
                 case 10:
+                    if (weights.size() != OUTPUTS_VALUE * VALUE_LAYER
+                                              * size_t(m_board_size)
+                                              * size_t(m_board_size)) {
+                        myprintf("The weights file is not for %dx%d boards.\n",
+                                 m_board_size, m_board_size);
+                        return {0, 0};
+                    }
                     std::copy(cbegin(weights), cend(weights),
                               begin(m_ip1_val_w));
                     break;
@@ -404,10 +442,20 @@ std::pair<int, int> Network::load_network_file(const std::string& filename) {
     return {0, 0};
 }
 
+static std::unique_ptr<ForwardPipe> make_cpu_pipe() {
+    const auto nodes = SMP::get_num_numa_nodes();
+    if (cfg_numa && nodes > 1) {
+        myprintf("Replicating weights on %zu NUMA nodes.\n", nodes);
+        return std::make_unique<NumaPipe>(
+            nodes, [] { return std::make_unique<CPUPipe>(); });
+    }
+    return std::make_unique<CPUPipe>();
+}
+
 std::unique_ptr<ForwardPipe>&& Network::init_net(
     const int channels, std::unique_ptr<ForwardPipe>&& pipe) {
 
-    pipe->initialize(channels);
+    pipe->initialize(channels, m_board_size);
     pipe->push_weights(WINOGRAD_ALPHA, INPUT_CHANNELS, channels, m_fwd_weights);
 
     return std::move(pipe);
@@ -492,7 +540,8 @@ void Network::select_precision(const int channels) {
 }
 #endif
 
-void Network::initialize(const int playouts, const std::string& weightsfile) {
+void Network::initialize(const std::int64_t playouts,
+                         const std::string& weightsfile) {
 #ifdef USE_BLAS
 #ifndef __APPLE__
 #ifdef USE_OPENBLAS
@@ -514,28 +563,24 @@ void Network::initialize(const int playouts, const std::string& weightsfile) {
 
     m_fwd_weights = std::make_shared<ForwardPipeWeights>();
 
+    if (cfg_numa) {
+        m_nncache.set_partitions(SMP::get_num_numa_nodes());
+    }
+
     // Make a guess at a good size as long as the user doesn't
     // explicitly set a maximum memory usage.
     m_nncache.set_size_from_playouts(playouts);
 
-    // Prepare symmetry table
-    for (auto s = 0; s < NUM_SYMMETRIES; ++s) {
-        for (auto v = 0; v < NUM_INTERSECTIONS; ++v) {
-            const auto newvtx =
-                get_symmetry({v % BOARD_SIZE, v / BOARD_SIZE}, s);
-            symmetry_nn_idx_table[s][v] =
-                (newvtx.second * BOARD_SIZE) + newvtx.first;
-            assert(symmetry_nn_idx_table[s][v] >= 0
-                   && symmetry_nn_idx_table[s][v] < NUM_INTERSECTIONS);
-        }
-    }
-
     // Load network from file
     size_t channels, residual_blocks;
     std::tie(channels, residual_blocks) = load_network_file(weightsfile);
     if (channels == 0) {
         exit(EXIT_FAILURE);
     }
+    if (m_board_size != BOARD_SIZE) {
+        myprintf("Weights are for %dx%d boards.\n", m_board_size,
+                 m_board_size);
+    }
 
     auto weight_index = size_t{0};
     // Input convolution
@@ -576,9 +621,10 @@ void Network::initialize(const int playouts, const std::string& weightsfile) {
     }
 
 #ifdef USE_OPENCL
-    if (cfg_cpu_only) {
+    // The OpenCL kernels are compiled for BOARD_SIZE boards only.
+    if (cfg_cpu_only || m_board_size != BOARD_SIZE) {
         myprintf("Initializing CPU-only evaluation.\n");
-        m_forward = init_net(channels, std::make_unique<CPUPipe>());
+        m_forward = init_net(channels, make_cpu_pipe());
     } else {
 #ifdef USE_OPENCL_SELFCHECK
         // initialize CPU reference first, so that we can self-check
@@ -598,7 +644,7 @@ void Network::initialize(const int playouts, const std::string& weightsfile) {
 
 #else // !USE_OPENCL
     myprintf("Initializing CPU-only evaluation.\n");
-    m_forward = init_net(channels, std::make_unique<CPUPipe>());
+    m_forward = init_net(channels, make_cpu_pipe());
 #endif
 
     // Need to estimate size before clearing up the pipe.
@@ -606,10 +652,13 @@ void Network::initialize(const int playouts, const std::string& weightsfile) {
     m_fwd_weights.reset();
 }
 
-template <unsigned int inputs, unsigned int outputs, bool ReLU, size_t W>
+template <unsigned int inputs, unsigned int outputs, bool ReLU, size_t W,
+          size_t B>
 std::vector<float> innerproduct(const std::vector<float>& input,
                                 const std::array<float, W>& weights,
-                                const std::array<float, outputs>& biases) {
+                                const std::array<float, B>& biases) {
+    static_assert(inputs * outputs <= W && outputs <= B,
+                  "Layer doesn't fit in its weights");
     std::vector<float> output(outputs);
 
 #ifdef USE_BLAS
@@ -711,28 +760,40 @@ std::vector<float> softmax(const std::vector<float>& input,
     return output;
 }
 
+bool Network::use_symmetric_lookups(const GameState* const state) const {
+    // If we are not generating a self-play game, try to find
+    // symmetries if we are in the early opening.
+    return !cfg_noise && !cfg_random_cnt
+           && state->get_movenum()
+                  < (state->get_timecontrol().opening_moves(m_board_size) / 2);
+}
+
+void Network::correct_symmetry(Netresult& result, const int symmetry) const {
+    dispatch_board_size(m_board_size, [&](const auto size) {
+        constexpr auto board_size = decltype(size)::value;
+        const auto& table = symmetry_nn_idx_table<board_size>();
+        decltype(result.policy) corrected_policy{};
+        for (auto idx = 0; idx < board_size * board_size; ++idx) {
+            const auto sym_idx = table[symmetry][idx];
+            corrected_policy[idx] = result.policy[sym_idx];
+        }
+        result.policy = std::move(corrected_policy);
+    });
+}
+
 bool Network::probe_cache(const GameState* const state,
                           Network::Netresult& result) {
     if (m_nncache.lookup(state->board.get_hash(), result)) {
         return true;
     }
-    // If we are not generating a self-play game, try to find
-    // symmetries if we are in the early opening.
-    if (!cfg_noise && !cfg_random_cnt
-        && state->get_movenum()
-               < (state->get_timecontrol().opening_moves(BOARD_SIZE) / 2)) {
+    if (use_symmetric_lookups(state)) {
         for (auto sym = 0; sym < Network::NUM_SYMMETRIES; ++sym) {
             if (sym == Network::IDENTITY_SYMMETRY) {
                 continue;
             }
             const auto hash = state->get_symmetry_hash(sym);
             if (m_nncache.lookup(hash, result)) {
-                decltype(result.policy) corrected_policy;
-                for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; ++idx) {
-                    const auto sym_idx = symmetry_nn_idx_table[sym][idx];
-                    corrected_policy[idx] = result.policy[sym_idx];
-                }
-                result.policy = std::move(corrected_policy);
+                correct_symmetry(result, sym);
                 return true;
             }
         }
@@ -741,11 +802,63 @@ bool Network::probe_cache(const GameState* const state,
     return false;
 }
 
+bool Network::wait_in_flight(const GameState* const state,
+                             Network::Netresult& result) {
+    const auto hash = state->board.get_hash();
+    auto symmetry = int{IDENTITY_SYMMETRY};
+    auto future = std::shared_future<Netresult>{};
+    {
+        std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+        auto iter = m_in_flight.find(hash);
+        if (iter == end(m_in_flight) && use_symmetric_lookups(state)) {
+            for (auto sym = 0; sym < NUM_SYMMETRIES; ++sym) {
+                if (sym == IDENTITY_SYMMETRY) {
+                    continue;
+                }
+                iter = m_in_flight.find(state->get_symmetry_hash(sym));
+                if (iter != end(m_in_flight)) {
+                    symmetry = sym;
+                    break;
+                }
+            }
+        }
+        if (iter == end(m_in_flight)) {
+            // Nobody is on it, we are.
+            auto promise = std::make_shared<std::promise<Netresult>>();
+            m_in_flight.emplace(
+                hash, InFlight{promise, promise->get_future().share()});
+            return false;
+        }
+        future = iter->second.future;
+    }
+
+    m_dedup_evals++;
+    // Rethrows NetworkHaltException if the evaluation was drained.
+    result = future.get();
+    if (symmetry != IDENTITY_SYMMETRY) {
+        correct_symmetry(result, symmetry);
+    }
+    return true;
+}
+
+void Network::finish_in_flight(const std::uint64_t hash,
+                               const Netresult* const result) {
+    std::lock_guard<std::mutex> lock(m_in_flight_mutex);
+    auto iter = m_in_flight.find(hash);
+    assert(iter != end(m_in_flight));
+    if (result != nullptr) {
+        iter->second.promise->set_value(*result);
+    } else {
+        iter->second.promise->set_exception(std::current_exception());
+    }
+    m_in_flight.erase(iter);
+}
+
 Network::Netresult Network::get_output(
     const GameState* const state, const Ensemble ensemble, const int symmetry,
     const bool read_cache, const bool write_cache, const bool force_selfcheck) {
     Netresult result;
-    if (state->board.get_boardsize() != BOARD_SIZE) {
+    if (state->board.get_boardsize() != m_board_size) {
         return result;
     }
 
@@ -756,6 +869,38 @@ Network::Netresult Network::get_output(
         }
     }
 
+    // Only results that go into the cache can be shared with other
+    // threads asking for the same position at the same time.
+    const auto share = read_cache && write_cache;
+    if (share && wait_in_flight(state, result)) {
+        return result;
+    }
+    try {
+        result = get_output_uncached(state, ensemble, symmetry,
+                                     force_selfcheck);
+    } catch (...) {
+        if (share) {
+            finish_in_flight(state->board.get_hash(), nullptr);
+        }
+        throw;
+    }
+
+    if (write_cache) {
+        // Insert result into cache.
+        m_nncache.insert(state->board.get_hash(), result);
+    }
+    if (share) {
+        finish_in_flight(state->board.get_hash(), &result);
+    }
+
+    return result;
+}
+
+Network::Netresult Network::get_output_uncached(const GameState* const state,
+                                                const Ensemble ensemble,
+                                                const int symmetry,
+                                                const bool force_selfcheck) {
+    Netresult result;
     if (ensemble == DIRECT) {
         assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
         result = get_output_internal(state, symmetry);
@@ -801,22 +946,61 @@ Network::Netresult Network::get_output(
         }
     }
 
-    if (write_cache) {
-        // Insert result into cache.
-        m_nncache.insert(state->board.get_hash(), result);
+    return result;
+}
+
+bool Network::accepts_prefetch() const {
+    return m_forward->accepts_prefetch();
+}
+
+void Network::prefetch(const GameState* const state) {
+    const auto hash = state->board.get_hash();
+    if (!accepts_prefetch() || state->board.get_boardsize() != m_board_size
+        || m_nncache.contains(hash)) {
+        return;
     }
 
-    return result;
+    const auto symmetry = Random::get_Rng().randfix<NUM_SYMMETRIES>();
+    const auto flip_winrate =
+        m_value_head_not_stm && state->board.get_to_move() == FastBoard::WHITE;
+    m_forward->prefetch(
+        gather_features(state, symmetry),
+        [this, hash, symmetry, flip_winrate](
+            const std::vector<float>& output_pol,
+            const std::vector<float>& output_val) {
+            auto policy_data = output_pol;
+            auto value_data = output_val;
+            auto result =
+                dispatch_board_size(m_board_size, [&](const auto size) {
+                    return process_output<decltype(size)::value>(
+                        policy_data, value_data, symmetry);
+                });
+            // v2 format (ELF Open Go) returns black value, not stm
+            if (flip_winrate) {
+                result.winrate = 1.0f - result.winrate;
+            }
+            m_nncache.insert(hash, result, true);
+        });
 }
 
 Network::Netresult Network::get_output_internal(const GameState* const state,
                                                 const int symmetry,
-                                                bool selfcheck) {
+                                                const bool selfcheck) {
+    return dispatch_board_size(m_board_size, [&](const auto size) {
+        return get_output_internal<decltype(size)::value>(state, symmetry,
+                                                          selfcheck);
+    });
+}
+
+template <int board_size>
+Network::Netresult Network::get_output_internal(const GameState* const state,
+                                                const int symmetry,
+                                                const bool selfcheck) {
     assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
-    constexpr auto width = BOARD_SIZE;
-    constexpr auto height = BOARD_SIZE;
+    constexpr auto width = board_size;
+    constexpr auto height = board_size;
 
-    const auto input_data = gather_features(state, symmetry);
+    const auto input_data = gather_features<board_size>(state, symmetry);
     std::vector<float> policy_data(OUTPUTS_POLICY * width * height);
     std::vector<float> value_data(OUTPUTS_VALUE * width * height);
 #ifdef USE_OPENCL_SELFCHECK
@@ -830,19 +1014,28 @@ Network::Netresult Network::get_output_internal(const GameState* const state,
     (void)selfcheck;
 #endif
 
+    return process_output<board_size>(policy_data, value_data, symmetry);
+}
+
+template <int board_size>
+Network::Netresult Network::process_output(std::vector<float>& policy_data,
+                                           std::vector<float>& value_data,
+                                           const int symmetry) const {
+    constexpr auto num_intersections = board_size * board_size;
+
     // Get the moves
-    batchnorm<NUM_INTERSECTIONS>(OUTPUTS_POLICY, policy_data,
+    batchnorm<num_intersections>(OUTPUTS_POLICY, policy_data,
                                  m_bn_pol_w1.data(), m_bn_pol_w2.data());
     const auto policy_out =
-        innerproduct<OUTPUTS_POLICY * NUM_INTERSECTIONS, POTENTIAL_MOVES,
+        innerproduct<OUTPUTS_POLICY * num_intersections, num_intersections + 1,
                      false>(policy_data, m_ip_pol_w, m_ip_pol_b);
     const auto outputs = softmax(policy_out, cfg_softmax_temp);
 
     // Now get the value
-    batchnorm<NUM_INTERSECTIONS>(OUTPUTS_VALUE, value_data, m_bn_val_w1.data(),
+    batchnorm<num_intersections>(OUTPUTS_VALUE, value_data, m_bn_val_w1.data(),
                                  m_bn_val_w2.data());
     const auto winrate_data =
-        innerproduct<OUTPUTS_VALUE * NUM_INTERSECTIONS, VALUE_LAYER, true>(
+        innerproduct<OUTPUTS_VALUE * num_intersections, VALUE_LAYER, true>(
             value_data, m_ip1_val_w, m_ip1_val_b);
     const auto winrate_out = innerproduct<VALUE_LAYER, 1, false>(
         winrate_data, m_ip2_val_w, m_ip2_val_b);
@@ -852,12 +1045,13 @@ Network::Netresult Network::get_output_internal(const GameState* const state,
 
     Netresult result;
 
-    for (auto idx = size_t{0}; idx < NUM_INTERSECTIONS; idx++) {
-        const auto sym_idx = symmetry_nn_idx_table[symmetry][idx];
+    const auto& table = symmetry_nn_idx_table<board_size>();
+    for (auto idx = 0; idx < num_intersections; idx++) {
+        const auto sym_idx = table[symmetry][idx];
         result.policy[sym_idx] = outputs[idx];
     }
 
-    result.policy_pass = outputs[NUM_INTERSECTIONS];
+    result.policy_pass = outputs[num_intersections];
     result.winrate = winrate;
 
     return result;
@@ -868,12 +1062,13 @@ void Network::show_heatmap(const FastState* const state,
     std::vector<std::string> display_map;
     std::string line;
 
-    for (unsigned int y = 0; y < BOARD_SIZE; y++) {
-        for (unsigned int x = 0; x < BOARD_SIZE; x++) {
+    const auto board_size = state->board.get_boardsize();
+    for (auto y = 0; y < board_size; y++) {
+        for (auto x = 0; x < board_size; x++) {
             auto policy = 0;
             const auto vertex = state->board.get_vertex(x, y);
             if (state->board.get_state(vertex) == FastBoard::EMPTY) {
-                policy = result.policy[y * BOARD_SIZE + x] * 1000;
+                policy = result.policy[y * board_size + x] * 1000;
             }
 
             line += boost::str(boost::format("%3d ") % policy);
@@ -892,9 +1087,9 @@ void Network::show_heatmap(const FastState* const state,
 
     if (topmoves) {
         std::vector<Network::PolicyVertexPair> moves;
-        for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
-            const auto x = i % BOARD_SIZE;
-            const auto y = i / BOARD_SIZE;
+        for (auto i = 0; i < board_size * board_size; i++) {
+            const auto x = i % board_size;
+            const auto y = i / board_size;
             const auto vertex = state->board.get_vertex(x, y);
             if (state->board.get_state(vertex) == FastBoard::EMPTY) {
                 moves.emplace_back(result.policy[i], vertex);
@@ -915,14 +1110,16 @@ void Network::show_heatmap(const FastState* const state,
     }
 }
 
-void Network::fill_input_plane_pair(const FullBoard& board,
+template <int board_size>
+void Network::fill_input_plane_pair(const PackedBoard& board,
                                     std::vector<float>::iterator black,
                                     std::vector<float>::iterator white,
                                     const int symmetry) {
-    for (auto idx = 0; idx < NUM_INTERSECTIONS; idx++) {
-        const auto sym_idx = symmetry_nn_idx_table[symmetry][idx];
-        const auto x = sym_idx % BOARD_SIZE;
-        const auto y = sym_idx / BOARD_SIZE;
+    const auto& table = symmetry_nn_idx_table<board_size>();
+    for (auto idx = 0; idx < board_size * board_size; idx++) {
+        const auto sym_idx = table[symmetry][idx];
+        const auto x = sym_idx % board_size;
+        const auto y = sym_idx / board_size;
         const auto color = board.get_state(x, y);
         if (color == FastBoard::BLACK) {
             black[idx] = float(true);
@@ -932,35 +1129,47 @@ void Network::fill_input_plane_pair(const FullBoard& board,
     }
 }
 
+std::vector<float> Network::gather_features(const GameState* const state,
+                                            const int symmetry) {
+    return dispatch_board_size(
+        state->board.get_boardsize(), [&](const auto size) {
+            return gather_features<decltype(size)::value>(state, symmetry);
+        });
+}
+
+template <int board_size>
 std::vector<float> Network::gather_features(const GameState* const state,
                                             const int symmetry) {
     assert(symmetry >= 0 && symmetry < NUM_SYMMETRIES);
-    auto input_data = std::vector<float>(INPUT_CHANNELS * NUM_INTERSECTIONS);
+    constexpr auto num_intersections = board_size * board_size;
+    auto input_data = std::vector<float>(INPUT_CHANNELS * num_intersections);
 
     const auto to_move = state->get_to_move();
     const auto blacks_move = to_move == FastBoard::BLACK;
 
     const auto black_it =
         blacks_move ? begin(input_data)
-                    : begin(input_data) + INPUT_MOVES * NUM_INTERSECTIONS;
+                    : begin(input_data) + INPUT_MOVES * num_intersections;
     const auto white_it =
-        blacks_move ? begin(input_data) + INPUT_MOVES * NUM_INTERSECTIONS
+        blacks_move ? begin(input_data) + INPUT_MOVES * num_intersections
                     : begin(input_data);
     const auto to_move_it =
         blacks_move
-            ? begin(input_data) + 2 * INPUT_MOVES * NUM_INTERSECTIONS
-            : begin(input_data) + (2 * INPUT_MOVES + 1) * NUM_INTERSECTIONS;
+            ? begin(input_data) + 2 * INPUT_MOVES * num_intersections
+            : begin(input_data) + (2 * INPUT_MOVES + 1) * num_intersections;
 
+    static_assert(INPUT_MOVES <= GameState::HISTORY_BOARDS,
+                  "GameState doesn't keep enough past positions");
     const auto moves = std::min<size_t>(state->get_movenum() + 1, INPUT_MOVES);
     // Go back in time, fill history boards
     for (auto h = size_t{0}; h < moves; h++) {
         // collect white, black occupation planes
-        fill_input_plane_pair(state->get_past_board(h),
-                              black_it + h * NUM_INTERSECTIONS,
-                              white_it + h * NUM_INTERSECTIONS, symmetry);
+        fill_input_plane_pair<board_size>(state->get_past_board(h),
+                              black_it + h * num_intersections,
+                              white_it + h * num_intersections, symmetry);
     }
 
-    std::fill(to_move_it, to_move_it + NUM_INTERSECTIONS, float(true));
+    std::fill(to_move_it, to_move_it + num_intersections, float(true));
 
     return input_data;
 }
@@ -1049,6 +1258,24 @@ void Network::nncache_clear() {
     m_nncache.clear();
 }
 
+void Network::nncache_dump_stats() {
+    m_nncache.dump_stats();
+    if (m_dedup_evals > 0) {
+        myprintf("NNCache: %d evals shared with a concurrent request\n",
+                 m_dedup_evals.load());
+    }
+}
+
+Network::~Network() {
+    // Batching pipes can still insert prefetched results into the cache,
+    // stop them before it goes away.
+    m_forward.reset();
+}
+
+int Network::get_board_size() const {
+    return m_board_size;
+}
+
 void Network::drain_evals() {
     m_forward->drain();
 }
@@ -33,10 +33,17 @@
 #include "config.h"
 
 #include <array>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
 #include <deque>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
@@ -57,16 +64,42 @@
 // Winograd filter transformation changes 3x3 filters to M + 3 - 1
 constexpr auto WINOGRAD_M = 4;
 constexpr auto WINOGRAD_ALPHA = WINOGRAD_M + 3 - 1;
-constexpr auto WINOGRAD_WTILES =
-    BOARD_SIZE / WINOGRAD_M + (BOARD_SIZE % WINOGRAD_M != 0);
+constexpr int winograd_wtiles(const int board_size) {
+    return board_size / WINOGRAD_M + (board_size % WINOGRAD_M != 0);
+}
+constexpr auto WINOGRAD_WTILES = winograd_wtiles(BOARD_SIZE);
 constexpr auto WINOGRAD_TILE = WINOGRAD_ALPHA * WINOGRAD_ALPHA;
 constexpr auto WINOGRAD_P = WINOGRAD_WTILES * WINOGRAD_WTILES;
 constexpr auto SQ2 = 1.4142135623730951f; // Square root of 2
 
+// Sizes that don't fit in BOARD_SIZE are never selected, but still need
+// a valid instantiation.
+template <int board_size>
+using BoardSizeConstant =
+    std::integral_constant<int, (board_size <= BOARD_SIZE ? board_size
+                                                          : BOARD_SIZE)>;
+
+// Calls f with a BoardSizeConstant for the runtime board size, so that
+// code templated on the board size is instantiated for all of them.
+template <typename F>
+auto dispatch_board_size(const int board_size, F&& f) {
+    assert(is_supported_board_size(board_size));
+    if (board_size == 9) {
+        return f(BoardSizeConstant<9>{});
+    } else if (board_size == 13) {
+        return f(BoardSizeConstant<13>{});
+    } else if (board_size == 19) {
+        return f(BoardSizeConstant<19>{});
+    }
+    return f(BoardSizeConstant<BOARD_SIZE>{});
+}
+
 // See drain_evals() / resume_evals() for details.
 class NetworkHaltException : public std::exception {};
 
 class Network {
+    friend class LeelaTest;
+
     using ForwardPipeWeights = ForwardPipe::ForwardPipeWeights;
 
 public:
@@ -78,11 +111,15 @@ public:
     using PolicyVertexPair = std::pair<float, int>;
     using Netresult = NNCache::Netresult;
 
-    virtual ~Network() = default;
+    virtual ~Network();
 
     Netresult get_output(const GameState* state, Ensemble ensemble,
                          int symmetry = -1, bool read_cache = true,
                          bool write_cache = true, bool force_selfcheck = false);
+    // Evaluate the position into the cache if the pipe has spare batch
+    // slots at some point, without waiting for it.
+    void prefetch(const GameState* state);
+    bool accepts_prefetch() const;
 
     static constexpr auto INPUT_MOVES = 8;
     static constexpr auto INPUT_CHANNELS = 2 * INPUT_MOVES + 2;
@@ -90,7 +127,7 @@ public:
     static constexpr auto OUTPUTS_VALUE = 1;
     static constexpr auto VALUE_LAYER = 256;
 
-    void initialize(int playouts, const std::string& weightsfile);
+    void initialize(std::int64_t playouts, const std::string& weightsfile);
 
     float benchmark_time(int centiseconds);
     void benchmark(const GameState* state, int iterations = 1600);
@@ -99,6 +136,8 @@ public:
 
     static std::vector<float> gather_features(const GameState* state,
                                               int symmetry);
+    // Board size of the loaded weights.
+    int get_board_size() const;
     static std::pair<int, int> get_symmetry(const std::pair<int, int>& vertex,
                                             int symmetry,
                                             int board_size = BOARD_SIZE);
@@ -107,6 +146,7 @@ public:
     size_t get_estimated_cache_size();
     void nncache_resize(int max_count);
     void nncache_clear();
+    void nncache_dump_stats();
 
     // 'Drain' evaluations.  Threads with an evaluation will throw a
     // NetworkHaltException if possible, or will just proceed and drain ASAP.
@@ -140,11 +180,33 @@ private:
                                std::vector<float>& M, int C, int K);
     Netresult get_output_internal(const GameState* state, int symmetry,
                                   bool selfcheck = false);
-    static void fill_input_plane_pair(const FullBoard& board,
+    template <int board_size>
+    Netresult get_output_internal(const GameState* state, int symmetry,
+                                  bool selfcheck);
+    template <int board_size>
+    Netresult process_output(std::vector<float>& policy_data,
+                             std::vector<float>& value_data,
+                             int symmetry) const;
+    template <int board_size>
+    static std::vector<float> gather_features(const GameState* state,
+                                              int symmetry);
+    template <int board_size>
+    static void fill_input_plane_pair(const PackedBoard& board,
                                       std::vector<float>::iterator black,
                                       std::vector<float>::iterator white,
                                       int symmetry);
+    Netresult get_output_uncached(const GameState* state, Ensemble ensemble,
+                                  int symmetry, bool force_selfcheck);
+    bool use_symmetric_lookups(const GameState* state) const;
+    void correct_symmetry(Netresult& result, int symmetry) const;
     bool probe_cache(const GameState* state, Network::Netresult& result);
+    // Wait for another thread evaluating the same position, or register
+    // this one as evaluating it if there is none.  Returns true if
+    // 'result' was filled in.
+    bool wait_in_flight(const GameState* state, Network::Netresult& result);
+    // Hand the result to the waiting threads, or the current exception
+    // if 'result' is null.
+    void finish_in_flight(std::uint64_t hash, const Netresult* result);
     std::unique_ptr<ForwardPipe>&& init_net(
         int channels, std::unique_ptr<ForwardPipe>&& pipe);
 #ifdef USE_HALF
@@ -158,12 +220,23 @@ private:
 
     NNCache m_nncache;
 
+    struct InFlight {
+        std::shared_ptr<std::promise<Netresult>> promise;
+        std::shared_future<Netresult> future;
+    };
+    std::mutex m_in_flight_mutex;
+    std::unordered_map<std::uint64_t, InFlight> m_in_flight;
+    std::atomic<int> m_dedup_evals{0};
+
     size_t estimated_size{0};
 
+    int m_board_size{BOARD_SIZE};
+
     // Residual tower
     std::shared_ptr<ForwardPipeWeights> m_fwd_weights;
 
-    // Policy head
+    // Policy head, the fully connected layers are sized for BOARD_SIZE
+    // and only their beginning is used on smaller boards.
     std::array<float, OUTPUTS_POLICY> m_bn_pol_w1;
     std::array<float, OUTPUTS_POLICY> m_bn_pol_w2;
 
@@ -0,0 +1,105 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+
+#include "config.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "NumaPipe.h"
+#include "SMP.h"
+
+NumaPipe::NumaPipe(const size_t nodes, Factory factory) {
+    m_pipes.resize(std::max(nodes, size_t{1}));
+    on_each_node([this, &factory](const size_t node) {
+        m_pipes[node] = factory();
+    });
+}
+
+void NumaPipe::on_each_node(const std::function<void(size_t)>& f) {
+    for (auto node = size_t{0}; node < m_pipes.size(); node++) {
+        std::exception_ptr error;
+        std::thread worker([&f, &error, node] {
+            SMP::bind_to_numa_node(node);
+            try {
+                f(node);
+            } catch (...) {
+                error = std::current_exception();
+            }
+        });
+        worker.join();
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+void NumaPipe::initialize(const int channels, const int board_size) {
+    on_each_node([this, channels, board_size](const size_t node) {
+        m_pipes[node]->initialize(channels, board_size);
+    });
+}
+
+bool NumaPipe::needs_autodetect() {
+    return m_pipes[0]->needs_autodetect();
+}
+
+void NumaPipe::forward(const std::vector<float>& input,
+                       std::vector<float>& output_pol,
+                       std::vector<float>& output_val) {
+    const auto node = SMP::get_numa_node() % m_pipes.size();
+    m_pipes[node]->forward(input, output_pol, output_val);
+}
+
+void NumaPipe::push_weights(
+    const unsigned int filter_size, const unsigned int channels,
+    const unsigned int outputs,
+    std::shared_ptr<const ForwardPipeWeights> weights) {
+
+    on_each_node([&](const size_t node) {
+        // Copying on the bound thread places the copy on this node.
+        auto local = std::make_shared<const ForwardPipeWeights>(*weights);
+        m_pipes[node]->push_weights(filter_size, channels, outputs,
+                                    std::move(local));
+    });
+}
+
+void NumaPipe::drain() {
+    for (auto& pipe : m_pipes) {
+        pipe->drain();
+    }
+}
+
+void NumaPipe::resume() {
+    for (auto& pipe : m_pipes) {
+        pipe->resume();
+    }
+}
@@ -0,0 +1,69 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef NUMAPIPE_H_INCLUDED
+#define NUMAPIPE_H_INCLUDED
+#include "config.h"
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "ForwardPipe.h"
+
+// Keeps one copy of a forward pipe, including its weights, on every NUMA
+// node.  Each copy is created and filled from a thread bound to its node,
+// so its memory is node-local, and forward() uses the copy belonging to
+// the node of the calling thread.
+class NumaPipe : public ForwardPipe {
+public:
+    using Factory = std::function<std::unique_ptr<ForwardPipe>()>;
+
+    NumaPipe(size_t nodes, Factory factory);
+
+    virtual void initialize(int channels, int board_size);
+    virtual bool needs_autodetect();
+    virtual void forward(const std::vector<float>& input,
+                         std::vector<float>& output_pol,
+                         std::vector<float>& output_val);
+
+    virtual void push_weights(
+        unsigned int filter_size, unsigned int channels, unsigned int outputs,
+        std::shared_ptr<const ForwardPipeWeights> weights);
+
+    virtual void drain();
+    virtual void resume();
+
+private:
+    // Run f(node) on a thread bound to each node, one node at a time.
+    void on_each_node(const std::function<void(size_t)>& f);
+
+    std::vector<std::unique_ptr<ForwardPipe>> m_pipes;
+};
+#endif
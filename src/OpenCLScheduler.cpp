@@ -34,6 +34,7 @@
 #include "Network.h"
 #include "OpenCLScheduler.h"
 #include "Random.h"
+#include "SMP.h"
 #include "Utils.h"
 
 using Utils::ceilMultiple;
@@ -106,7 +107,12 @@ OpenCLScheduler<net_t>::OpenCLScheduler() {
 }
 
 template <typename net_t>
-void OpenCLScheduler<net_t>::initialize(const int channels) {
+void OpenCLScheduler<net_t>::initialize(const int channels,
+                                        const int board_size) {
+    // The kernels are built for BOARD_SIZE boards only.
+    assert(board_size == BOARD_SIZE);
+    (void)board_size;
+
     // Launch the worker threads.  Minimum 1 worker per GPU, but use enough
     // threads so that we can at least concurrently schedule something to the
     // GPU.
@@ -276,6 +282,20 @@ void OpenCLScheduler<net_t>::forward(const std::vector<float>& input,
     }
 }
 
+template <typename net_t>
+void OpenCLScheduler<net_t>::prefetch(std::vector<float>&& input,
+                                      PrefetchCallback done) {
+    // Never wake up a worker for these, they only ride along with
+    // real evaluations.  Old entries are the least likely to still be
+    // useful, so drop those once there are more than fit in a batch
+    // for every worker.
+    std::unique_lock<std::mutex> lk(m_mutex);
+    m_prefetch_queue.push_back({std::move(input), std::move(done)});
+    if (m_prefetch_queue.size() > cfg_batch_size * m_worker_threads.size()) {
+        m_prefetch_queue.pop_front();
+    }
+}
+
 #ifndef NDEBUG
 struct batch_stats_t batch_stats;
 #endif
@@ -288,6 +308,12 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
     constexpr auto out_val_size =
         Network::OUTPUTS_VALUE * BOARD_SIZE * BOARD_SIZE;
 
+    // We don't know which node a device hangs off, so spread the devices
+    // over the nodes.  Buffers this thread allocates are then node-local.
+    if (cfg_numa) {
+        SMP::bind_to_numa_node(gnum % SMP::get_num_numa_nodes());
+    }
+
     OpenCLContext context;
 
     // batch scheduling heuristic.
@@ -308,7 +334,7 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
     // while that single eval was being processed, it means that we made
     // the wrong decision.  Wait 2ms longer next time.
 
-    auto pickup_task = [this]() {
+    auto pickup_task = [this](std::vector<PrefetchEntry>& prefetches) {
         std::list<std::shared_ptr<ForwardQueueEntry>> inputs;
         size_t count = 0;
 
@@ -349,6 +375,13 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
         std::move(begin(m_forward_queue), end, std::back_inserter(inputs));
         m_forward_queue.erase(begin(m_forward_queue), end);
 
+        // Fill up the rest of the batch with prefetches.
+        while (count + prefetches.size() < cfg_batch_size
+               && !m_prefetch_queue.empty()) {
+            prefetches.emplace_back(std::move(m_prefetch_queue.back()));
+            m_prefetch_queue.pop_back();
+        }
+
         return inputs;
     };
 
@@ -356,9 +389,13 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
     auto batch_output_pol = std::vector<float>();
     auto batch_output_val = std::vector<float>();
 
+    auto prefetches = std::vector<PrefetchEntry>();
+
     while (true) {
-        auto inputs = pickup_task();
+        prefetches.clear();
+        auto inputs = pickup_task(prefetches);
         auto count = inputs.size();
+        auto batch_count = count + prefetches.size();
 
         if (!m_running) {
             return;
@@ -373,9 +410,9 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
 #endif
 
         // prepare input for forward() call
-        batch_input.resize(in_size * count);
-        batch_output_pol.resize(out_pol_size * count);
-        batch_output_val.resize(out_val_size * count);
+        batch_input.resize(in_size * batch_count);
+        batch_output_pol.resize(out_pol_size * batch_count);
+        batch_output_val.resize(out_val_size * batch_count);
 
         auto index = size_t{0};
         for (auto& x : inputs) {
@@ -384,10 +421,15 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
                       begin(batch_input) + in_size * index);
             index++;
         }
+        for (auto& x : prefetches) {
+            std::copy(begin(x.in), end(x.in),
+                      begin(batch_input) + in_size * index);
+            index++;
+        }
 
         // run the NN evaluation
         m_networks[gnum]->forward(batch_input, batch_output_pol,
-                                  batch_output_val, context, count);
+                                  batch_output_val, context, batch_count);
 
         // Get output and copy back
         index = 0;
@@ -405,6 +447,20 @@ void OpenCLScheduler<net_t>::batch_worker(const size_t gnum) {
         if (count == 1) {
             m_single_eval_in_progress = false;
         }
+
+        // Only after the waiting threads are released.
+        auto out_pol = std::vector<float>(out_pol_size);
+        auto out_val = std::vector<float>(out_val_size);
+        for (auto& x : prefetches) {
+            std::copy(begin(batch_output_pol) + out_pol_size * index,
+                      begin(batch_output_pol) + out_pol_size * (index + 1),
+                      begin(out_pol));
+            std::copy(begin(batch_output_val) + out_val_size * index,
+                      begin(batch_output_val) + out_val_size * (index + 1),
+                      begin(out_val));
+            x.done(out_pol, out_val);
+            index++;
+        }
     }
 }
 
@@ -421,6 +477,8 @@ void OpenCLScheduler<net_t>::drain() {
         std::move(m_forward_queue.begin(), m_forward_queue.end(),
                   std::back_inserter(fq));
         m_forward_queue.clear();
+        // These are for positions the search won't come back to.
+        m_prefetch_queue.clear();
     }
 
     for (auto& x : fq) {
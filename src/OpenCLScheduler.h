@@ -31,6 +31,7 @@
 #define OPENCLSCHEDULER_H_INCLUDED
 #include "config.h"
 
+#include <deque>
 #include <list>
 #include <thread>
 #include <vector>
@@ -63,14 +64,23 @@ class OpenCLScheduler : public ForwardPipe {
             : in(input), out_p(output_pol), out_v(output_val) {}
     };
 
+    struct PrefetchEntry {
+        std::vector<float> in;
+        PrefetchCallback done;
+    };
+
 public:
     virtual ~OpenCLScheduler();
     OpenCLScheduler();
 
-    virtual void initialize(int channels);
+    virtual void initialize(int channels, int board_size);
     virtual void forward(const std::vector<float>& input,
                          std::vector<float>& output_pol,
                          std::vector<float>& output_val);
+    virtual bool accepts_prefetch() const {
+        return true;
+    }
+    virtual void prefetch(std::vector<float>&& input, PrefetchCallback done);
     virtual bool needs_autodetect();
     virtual void push_weights(
         unsigned int filter_size, unsigned int channels, unsigned int outputs,
@@ -92,6 +102,8 @@ private:
     std::atomic<bool> m_single_eval_in_progress{false};
 
     std::list<std::shared_ptr<ForwardQueueEntry>> m_forward_queue;
+    // Only picked up to fill batches, newest first : lock protected
+    std::deque<PrefetchEntry> m_prefetch_queue;
     std::list<std::thread> m_worker_threads;
 
     void batch_worker(size_t gnum);
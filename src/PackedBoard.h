@@ -0,0 +1,80 @@
+/*
+    This file is part of Leela Zero.
+    Copyright (C) 2017-2019 Gian-Carlo Pascutto and contributors
+
+    Leela Zero is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Leela Zero is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Leela Zero.  If not, see <http://www.gnu.org/licenses/>.
+
+    Additional permission under GNU GPL version 3 section 7
+
+    If you modify this Program, or any covered work, by linking or
+    combining it with NVIDIA Corporation's libraries from the
+    NVIDIA CUDA Toolkit and/or the NVIDIA CUDA Deep Neural
+    Network library and/or the NVIDIA TensorRT inference library
+    (or a modified version of those libraries), containing parts covered
+    by the terms of the respective license agreement, the licensors of
+    this Program grant you additional permission to convey the resulting
+    work.
+*/
+
+#ifndef PACKEDBOARD_H_INCLUDED
+#define PACKEDBOARD_H_INCLUDED
+
+#include "config.h"
+
+#include <array>
+#include <cstdint>
+
+#include "FastBoard.h"
+
+/*
+    Stone layout of a position at 2 bits per intersection, which is all
+    the network input needs from past positions.
+*/
+class PackedBoard {
+public:
+    void set(const FastBoard& board) {
+        m_stones.fill(0);
+        const auto size = board.get_boardsize();
+        for (auto y = 0; y < BOARD_SIZE; y++) {
+            for (auto x = 0; x < BOARD_SIZE; x++) {
+                const auto color = (x < size && y < size)
+                                       ? board.get_state(x, y)
+                                       : FastBoard::EMPTY;
+                const auto idx = y * BOARD_SIZE + x;
+                m_stones[idx / PER_WORD] |= std::uint64_t(color)
+                                            << (BITS * (idx % PER_WORD));
+            }
+        }
+    }
+
+    bool operator==(const PackedBoard& other) const {
+        return m_stones == other.m_stones;
+    }
+
+    FastBoard::vertex_t get_state(const int x, const int y) const {
+        const auto idx = y * BOARD_SIZE + x;
+        const auto bits = m_stones[idx / PER_WORD] >> (BITS * (idx % PER_WORD));
+        return FastBoard::vertex_t(bits & MASK);
+    }
+
+private:
+    static constexpr auto BITS = 2;
+    static constexpr auto MASK = (1 << BITS) - 1;
+    static constexpr auto PER_WORD = 64 / BITS;
+
+    std::array<std::uint64_t, (NUM_INTERSECTIONS + PER_WORD - 1) / PER_WORD>
+        m_stones;
+};
+
+#endif
@@ -156,7 +156,7 @@ void SGFTree::populate_states() {
         std::istringstream strm(size);
         int bsize;
         strm >> bsize;
-        if (bsize == BOARD_SIZE) {
+        if (is_supported_board_size(bsize)) {
             // Assume default komi in config.h if not specified
             m_state.init_game(bsize, KOMI);
             valid_size = true;
@@ -178,7 +178,7 @@ void SGFTree::populate_states() {
         if (valid_size) {
             bsize = m_state.board.get_boardsize();
         }
-        if (bsize == BOARD_SIZE) {
+        if (is_supported_board_size(bsize)) {
             m_state.init_game(bsize, komi);
             m_state.set_handicap(handicap);
         } else {
@@ -28,7 +28,17 @@
 */
 
 #include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "SMP.h"
 
@@ -76,3 +86,105 @@ SMP::Lock::~Lock() {
 size_t SMP::get_num_cpus() {
     return std::thread::hardware_concurrency();
 }
+
+#ifdef __linux__
+// Parse a kernel cpulist such as "0-3,8-11".
+static std::vector<int> parse_cpulist(const std::string& list) {
+    auto result = std::vector<int>{};
+    auto ss = std::stringstream{list};
+    auto range = std::string{};
+    while (std::getline(ss, range, ',')) {
+        auto first = 0;
+        auto last = 0;
+        const auto count = sscanf(range.c_str(), "%d-%d", &first, &last);
+        if (count < 1) {
+            continue;
+        }
+        if (count == 1) {
+            last = first;
+        }
+        for (auto i = first; i <= last; i++) {
+            result.push_back(i);
+        }
+    }
+    return result;
+}
+
+static std::string read_sysfs(const std::string& path) {
+    auto file = std::ifstream{path};
+    auto line = std::string{};
+    std::getline(file, line);
+    return line;
+}
+#endif
+
+// CPUs we may run on, per NUMA node.
+static const std::vector<std::vector<int>>& numa_topology() {
+    static const auto topology = [] {
+        auto nodes = std::vector<std::vector<int>>{};
+#ifdef __linux__
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            const auto online =
+                parse_cpulist(read_sysfs("/sys/devices/system/node/online"));
+            for (const auto node : online) {
+                const auto path = "/sys/devices/system/node/node"
+                                  + std::to_string(node) + "/cpulist";
+                auto cpus = std::vector<int>{};
+                for (const auto cpu : parse_cpulist(read_sysfs(path))) {
+                    if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+                        cpus.push_back(cpu);
+                    }
+                }
+                if (!cpus.empty()) {
+                    nodes.emplace_back(std::move(cpus));
+                }
+            }
+        }
+#endif
+        if (nodes.empty()) {
+            nodes.emplace_back();
+        }
+        return nodes;
+    }();
+    return topology;
+}
+
+static thread_local size_t s_numa_node = 0;
+
+size_t SMP::get_num_numa_nodes() {
+    return numa_topology().size();
+}
+
+bool SMP::bind_to_numa_node(const size_t node) {
+    const auto& topology = numa_topology();
+    if (node >= topology.size() || topology[node].empty()) {
+        return false;
+    }
+#ifdef __linux__
+    cpu_set_t mask;
+    CPU_ZERO(&mask);
+    for (const auto cpu : topology[node]) {
+        CPU_SET(cpu, &mask);
+    }
+    if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0) {
+        return false;
+    }
+    s_numa_node = node;
+    return true;
+#else
+    return false;
+#endif
+}
+
+size_t SMP::get_numa_node() {
+    return s_numa_node;
+}
+
+size_t SMP::numa_node_for_thread(const size_t index, const size_t count) {
+    if (count == 0) {
+        return 0;
+    }
+    return (index % count) * get_num_numa_nodes() / count;
+}
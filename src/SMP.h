@@ -38,6 +38,22 @@
 namespace SMP {
     size_t get_num_cpus();
 
+    // NUMA topology as seen by this process.  Nodes without any CPU we are
+    // allowed to run on are skipped, so running under e.g.
+    // "numactl --cpunodebind=0" reports a single node.  Systems where the
+    // topology can't be read report a single node.
+    size_t get_num_numa_nodes();
+
+    // Restrict the calling thread to the CPUs of the given node.  Memory
+    // the thread touches first is then allocated on that node.
+    bool bind_to_numa_node(size_t node);
+
+    // Node the calling thread was bound to, 0 if it was never bound.
+    size_t get_numa_node();
+
+    // Spread 'count' threads over the nodes in contiguous blocks.
+    size_t numa_node_for_thread(size_t index, size_t count);
+
     class Mutex {
     public:
         Mutex();
@@ -26,21 +26,151 @@
     distribution.
 */
 
+#include "config.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <condition_variable>
 #include <cstddef>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <stdexcept>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
 namespace Utils {
 
+// Move-only, type-erased callable.  Small callables (the common case:
+// a lambda or functor holding a few pointers) are stored inline so that
+// queueing a task does not touch the allocator.  Larger ones fall back
+// to a heap copy.
+class Task {
+public:
+    static constexpr size_t INLINE_SIZE = 64;
+
+    Task() = default;
+    template <class F,
+              class = typename std::enable_if<!std::is_same<
+                  typename std::decay<F>::type, Task>::value>::type>
+    Task(F&& f) {
+        using Fn = typename std::decay<F>::type;
+        constexpr auto fits_inline =
+            sizeof(Fn) <= INLINE_SIZE
+            && alignof(Fn) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<Fn>::value;
+        emplace<Fn>(std::forward<F>(f),
+                    std::integral_constant<bool, fits_inline>{});
+    }
+    Task(Task&& other) noexcept {
+        move_from(other);
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            move_from(other);
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        reset();
+    }
+
+    explicit operator bool() const {
+        return m_ops != nullptr;
+    }
+    void operator()() {
+        m_ops->invoke(&m_storage);
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void*);
+        void (*move)(void* dst, void* src);
+        void (*destroy)(void*);
+    };
+
+    template <class Fn>
+    static const Ops* inline_ops() {
+        static const Ops ops = {
+            [](void* p) { (*static_cast<Fn*>(p))(); },
+            [](void* dst, void* src) {
+                new (dst) Fn(std::move(*static_cast<Fn*>(src)));
+                static_cast<Fn*>(src)->~Fn();
+            },
+            [](void* p) { static_cast<Fn*>(p)->~Fn(); }};
+        return &ops;
+    }
+
+    template <class Fn>
+    static const Ops* heap_ops() {
+        static const Ops ops = {
+            [](void* p) { (**static_cast<Fn**>(p))(); },
+            [](void* dst, void* src) {
+                *static_cast<Fn**>(dst) = *static_cast<Fn**>(src);
+            },
+            [](void* p) { delete *static_cast<Fn**>(p); }};
+        return &ops;
+    }
+
+    template <class Fn, class F>
+    void emplace(F&& f, std::true_type /* fits_inline */) {
+        new (&m_storage) Fn(std::forward<F>(f));
+        m_ops = inline_ops<Fn>();
+    }
+
+    template <class Fn, class F>
+    void emplace(F&& f, std::false_type /* fits_inline */) {
+        *reinterpret_cast<Fn**>(&m_storage) = new Fn(std::forward<F>(f));
+        m_ops = heap_ops<Fn>();
+    }
+
+    void move_from(Task& other) {
+        if (other.m_ops) {
+            other.m_ops->move(&m_storage, &other.m_storage);
+            m_ops = other.m_ops;
+            other.m_ops = nullptr;
+        }
+    }
+
+    void reset() {
+        if (m_ops) {
+            m_ops->destroy(&m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    typename std::aligned_storage<INLINE_SIZE,
+                                  alignof(std::max_align_t)>::type m_storage;
+    const Ops* m_ops{nullptr};
+};
+
+// Work-stealing thread pool.  Every worker owns a deque of tasks.  A worker
+// runs its own work in the order it was queued, like the old single-queue
+// pool did, and when it runs dry steals the newest task from the back of
+// the other workers' deques.
+// Tasks queued from a worker thread go to that worker's own deque, tasks
+// queued from outside the pool are spread round-robin, unless the caller
+// passes an affinity hint naming the worker it prefers.  Pinned tasks
+// are never stolen and only run on the worker they were queued for.
 class ThreadPool {
 public:
-    ThreadPool() = default;
+    static constexpr size_t MAX_THREADS = MAX_CPUS;
+    static constexpr size_t ANY_THREAD = ~size_t{0};
+
+    ThreadPool() {
+        // Tasks queued before the first worker starts wait here.
+        m_queues[0] = std::make_unique<WorkQueue>();
+    }
     ~ThreadPool();
 
     // create worker threads.  This version has no initializers.
@@ -54,33 +184,154 @@ public:
     auto add_task(F&& f, Args&&... args)
         -> std::future<typename std::result_of<F(Args...)>::type>;
 
+    // Queue a task without creating a future.  'thread' is a hint, the
+    // task may still be stolen by an idle worker.
+    void submit(Task task, size_t thread = ANY_THREAD);
+    // Queue a task that only the given worker may run, e.g. because the
+    // worker is bound to the NUMA node the task needs to run on.
+    void submit_pinned(Task task, size_t thread);
+
+    size_t get_num_threads() const {
+        return m_num_workers.load(std::memory_order_acquire);
+    }
+
+    // Index of the calling worker in this pool, or ANY_THREAD if the
+    // caller is not one of our workers.
+    size_t current_thread() const;
+
+    // Run one queued task on the calling worker, if there is one.
+    // Lets a worker that waits on other tasks help instead of blocking.
+    bool run_one_task();
+
 private:
+    // Padded by hand so the queues of different workers do not share a
+    // cache line.  alignas would not do: C++14 operator new ignores
+    // over-alignment, and the compiler would still assume it.
+    struct WorkQueue {
+        char pad_front[64];
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::deque<Task> pinned;
+        std::atomic<size_t> num_pinned{0};
+        char pad_back[64];
+    };
+
+    struct WorkerId {
+        const ThreadPool* pool{nullptr};
+        size_t index{ANY_THREAD};
+    };
+    static WorkerId& this_worker() {
+        static thread_local WorkerId id;
+        return id;
+    }
+
+    bool pop_local(size_t index, Task& task);
+    bool steal(size_t thief, Task& task);
+    void worker_loop(size_t index);
+
     std::vector<std::thread> m_threads;
-    std::queue<std::function<void()>> m_tasks;
+    std::array<std::unique_ptr<WorkQueue>, MAX_THREADS> m_queues;
+    std::atomic<size_t> m_num_workers{0};
+    std::atomic<size_t> m_next_queue{0};
+
+    // Number of stealable tasks sitting in the deques, and number of
+    // workers blocked on m_condvar waiting for that, or for pinned tasks
+    // of their own, to become non-zero.
+    std::atomic<size_t> m_pending{0};
+    std::atomic<size_t> m_sleeping{0};
 
     std::mutex m_mutex;
     std::condition_variable m_condvar;
     bool m_exit{false};
 };
 
-inline void ThreadPool::add_thread(std::function<void()> initializer) {
-    m_threads.emplace_back([this, initializer] {
-        initializer();
-        for (;;) {
-            std::function<void()> task;
-            {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                m_condvar.wait(lock,
-                               [this] { return m_exit || !m_tasks.empty(); });
-                if (m_exit && m_tasks.empty()) {
-                    return;
-                }
-                task = std::move(m_tasks.front());
-                m_tasks.pop();
-            }
+inline size_t ThreadPool::current_thread() const {
+    const auto& id = this_worker();
+    return id.pool == this ? id.index : ANY_THREAD;
+}
+
+inline bool ThreadPool::pop_local(const size_t index, Task& task) {
+    auto& queue = *m_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (!queue.pinned.empty()) {
+        task = std::move(queue.pinned.front());
+        queue.pinned.pop_front();
+        queue.num_pinned--;
+        return true;
+    }
+    if (queue.tasks.empty()) {
+        return false;
+    }
+    task = std::move(queue.tasks.front());
+    queue.tasks.pop_front();
+    m_pending--;
+    return true;
+}
+
+inline bool ThreadPool::steal(const size_t thief, Task& task) {
+    const auto workers = get_num_threads();
+    for (auto i = size_t{1}; i < workers; i++) {
+        auto& queue = *m_queues[(thief + i) % workers];
+        std::unique_lock<std::mutex> lock(queue.mutex, std::try_to_lock);
+        if (!lock.owns_lock() || queue.tasks.empty()) {
+            continue;
+        }
+        task = std::move(queue.tasks.back());
+        queue.tasks.pop_back();
+        m_pending--;
+        return true;
+    }
+    return false;
+}
+
+inline bool ThreadPool::run_one_task() {
+    const auto index = current_thread();
+    if (index == ANY_THREAD) {
+        return false;
+    }
+    Task task;
+    if (pop_local(index, task) || steal(index, task)) {
+        task();
+        return true;
+    }
+    return false;
+}
+
+inline void ThreadPool::worker_loop(const size_t index) {
+    for (;;) {
+        Task task;
+        if (pop_local(index, task) || steal(index, task)) {
             task();
+            continue;
+        }
+        const auto& pinned = m_queues[index]->num_pinned;
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if (m_exit && m_pending.load() == 0 && pinned.load() == 0) {
+            return;
         }
+        m_sleeping++;
+        m_condvar.wait(lock, [this, &pinned] {
+            return m_exit || m_pending.load() > 0 || pinned.load() > 0;
+        });
+        m_sleeping--;
+    }
+}
+
+inline void ThreadPool::add_thread(std::function<void()> initializer) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const auto index = m_threads.size();
+    if (index >= MAX_THREADS) {
+        throw std::runtime_error("Too many threads in thread pool.");
+    }
+    if (!m_queues[index]) {
+        m_queues[index] = std::make_unique<WorkQueue>();
+    }
+    m_threads.emplace_back([this, index, initializer] {
+        this_worker() = WorkerId{this, index};
+        initializer();
+        worker_loop(index);
     });
+    m_num_workers.store(index + 1, std::memory_order_release);
 }
 
 inline void ThreadPool::initialize(const size_t threads) {
@@ -89,20 +340,55 @@ inline void ThreadPool::initialize(const size_t threads) {
     }
 }
 
+inline void ThreadPool::submit(Task task, const size_t thread) {
+    const auto workers = std::max(get_num_threads(), size_t{1});
+    auto index = thread;
+    if (index == ANY_THREAD) {
+        index = current_thread();
+    }
+    if (index == ANY_THREAD) {
+        index = m_next_queue.fetch_add(1, std::memory_order_relaxed);
+    }
+    {
+        auto& queue = *m_queues[index % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.emplace_back(std::move(task));
+    }
+    m_pending++;
+    // Only pay for the mutex if somebody might be asleep.  A worker
+    // increments m_sleeping before re-checking m_pending, so one of the
+    // two sides always sees the other's update.
+    if (m_sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_condvar.notify_one();
+    }
+}
+
+inline void ThreadPool::submit_pinned(Task task, const size_t thread) {
+    const auto workers = std::max(get_num_threads(), size_t{1});
+    {
+        auto& queue = *m_queues[thread % workers];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pinned.emplace_back(std::move(task));
+        queue.num_pinned++;
+    }
+    // Any worker could be the one woken by notify_one, so wake them all.
+    if (m_sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lock(m_mutex); }
+        m_condvar.notify_all();
+    }
+}
+
 template <class F, class... Args>
 auto ThreadPool::add_task(F&& f, Args&&... args)
     -> std::future<typename std::result_of<F(Args...)>::type> {
     using return_type = typename std::result_of<F(Args...)>::type;
 
-    auto task = std::make_shared<std::packaged_task<return_type()>>(
+    auto task = std::packaged_task<return_type()>(
         std::bind(std::forward<F>(f), std::forward<Args>(args)...));
 
-    std::future<return_type> res = task->get_future();
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_tasks.emplace([task]() { (*task)(); });
-    }
-    m_condvar.notify_one();
+    std::future<return_type> res = task.get_future();
+    submit(Task(std::move(task)));
     return res;
 }
 
@@ -117,23 +403,82 @@ inline ThreadPool::~ThreadPool() {
     }
 }
 
+// A batch of tasks that can be waited on together.  Completion is tracked
+// with a single counter shared by the whole group, so adding a task does
+// not allocate a future per task.
 class ThreadGroup {
 public:
-    ThreadGroup(ThreadPool& pool) : m_pool(pool) {}
+    ThreadGroup(ThreadPool& pool)
+        : m_pool(pool), m_state(std::make_shared<State>()) {}
     template <class F, class... Args>
     void add_task(F&& f, Args&&... args) {
-        m_taskresults.emplace_back(
-            m_pool.add_task(std::forward<F>(f), std::forward<Args>(args)...));
+        add_task_on(ThreadPool::ANY_THREAD, std::forward<F>(f),
+                    std::forward<Args>(args)...);
+    }
+    // As add_task, but prefer running on the given worker.
+    template <class F, class... Args>
+    void add_task_on(const size_t thread, F&& f, Args&&... args) {
+        m_pool.submit(
+            make_task(std::forward<F>(f), std::forward<Args>(args)...),
+            thread);
+    }
+    // As add_task, but only ever run on the given worker.
+    template <class F, class... Args>
+    void add_pinned_task(const size_t thread, F&& f, Args&&... args) {
+        m_pool.submit_pinned(
+            make_task(std::forward<F>(f), std::forward<Args>(args)...),
+            thread);
     }
     void wait_all() {
-        for (auto&& result : m_taskresults) {
-            result.get();
+        // A worker waiting on its own sub-tasks must not go to sleep while
+        // they sit in its deque, so keep executing queued work instead.
+        if (m_pool.current_thread() != ThreadPool::ANY_THREAD) {
+            while (m_state->pending.load() > 0) {
+                if (!m_pool.run_one_task()) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+        std::unique_lock<std::mutex> lock(m_state->mutex);
+        m_state->cv.wait(lock, [this] { return m_state->pending.load() == 0; });
+        if (m_state->exception) {
+            auto exception = m_state->exception;
+            m_state->exception = nullptr;
+            std::rethrow_exception(exception);
         }
     }
 
 private:
+    struct State {
+        std::atomic<size_t> pending{0};
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::exception_ptr exception;
+    };
+
+    template <class F, class... Args>
+    Task make_task(F&& f, Args&&... args) {
+        m_state->pending++;
+        return Task([state = m_state,
+                     fn = std::bind(std::forward<F>(f),
+                                    std::forward<Args>(args)...)]() mutable {
+            try {
+                fn();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                if (!state->exception) {
+                    state->exception = std::current_exception();
+                }
+            }
+            if (--state->pending == 0) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->cv.notify_all();
+            }
+        });
+    }
+
     ThreadPool& m_pool;
-    std::vector<std::future<void>> m_taskresults;
+    std::shared_ptr<State> m_state;
 };
 
 }
@@ -164,6 +164,39 @@ TimeStep::NNPlanes Training::get_planes(const GameState* const state) {
 
 void Training::record(Network& network, const GameState& state,
                       const UCTNode& root) {
+    // The training data format is laid out for BOARD_SIZE boards.
+    if (state.board.get_boardsize() != BOARD_SIZE) {
+        return;
+    }
+    const auto to_move = state.board.get_to_move();
+    const auto& best_node = root.get_best_root_child(to_move);
+
+    auto visits = std::vector<std::pair<int, std::int64_t>>{};
+    for (const auto& child : root.get_children()) {
+        visits.emplace_back(child->get_move(), child->get_visits());
+    }
+    record(network, state, visits, root.get_eval(to_move),
+           best_node.get_eval(to_move), best_node.get_visits());
+}
+
+void Training::record(Network& network, const GameState& state,
+                      const std::vector<std::pair<int, int>>& visits,
+                      const float winrate) {
+    if (state.board.get_boardsize() != BOARD_SIZE || visits.empty()) {
+        return;
+    }
+    const auto best = std::max_element(
+        cbegin(visits), cend(visits),
+        [](const auto& a, const auto& b) { return a.second < b.second; });
+    const auto wide_visits =
+        std::vector<std::pair<int, std::int64_t>>(cbegin(visits), cend(visits));
+    record(network, state, wide_visits, winrate, winrate, best->second);
+}
+
+void Training::record(Network& network, const GameState& state,
+                      const std::vector<std::pair<int, std::int64_t>>& visits,
+                      const float root_winrate, const float child_winrate,
+                      const std::int64_t bestmove_visits) {
     auto step = TimeStep{};
     step.to_move = state.board.get_to_move();
     step.planes = get_planes(&state);
@@ -172,18 +205,17 @@ void Training::record(Network& network, const GameState& state,
                                            Network::IDENTITY_SYMMETRY);
     step.net_winrate = result.winrate;
 
-    const auto& best_node = root.get_best_root_child(step.to_move);
-    step.root_uct_winrate = root.get_eval(step.to_move);
-    step.child_uct_winrate = best_node.get_eval(step.to_move);
-    step.bestmove_visits = best_node.get_visits();
+    step.root_uct_winrate = root_winrate;
+    step.child_uct_winrate = child_winrate;
+    step.bestmove_visits = bestmove_visits;
 
     step.probabilities.resize(POTENTIAL_MOVES);
 
     // Get total visit amount. We count rather
     // than trust the root to avoid ttable issues.
     auto sum_visits = 0.0;
-    for (const auto& child : root.get_children()) {
-        sum_visits += child->get_visits();
+    for (const auto& move : visits) {
+        sum_visits += move.second;
     }
 
     // In a terminal position (with 2 passes), we can have children, but we
@@ -194,14 +226,18 @@ void Training::record(Network& network, const GameState& state,
         return;
     }
 
-    for (const auto& child : root.get_children()) {
-        auto prob = static_cast<float>(child->get_visits() / sum_visits);
-        auto move = child->get_move();
-        if (move != FastBoard::PASS) {
-            auto xy = state.board.get_xy(move);
-            step.probabilities[xy.second * BOARD_SIZE + xy.first] = prob;
-        } else {
-            step.probabilities[NUM_INTERSECTIONS] = prob;
+    const auto symmetries = state.get_symmetries();
+    for (const auto& move : visits) {
+        for (const auto& equivalent : state.board.expand_equivalent_move(
+                 move.first, move.second, symmetries)) {
+            auto prob = static_cast<float>(equivalent.visits / sum_visits);
+            auto move = equivalent.vertex;
+            if (move != FastBoard::PASS) {
+                auto xy = state.board.get_xy(move);
+                step.probabilities[xy.second * BOARD_SIZE + xy.first] = prob;
+            } else {
+                step.probabilities[NUM_INTERSECTIONS] = prob;
+            }
         }
     }
 
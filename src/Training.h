@@ -34,6 +34,7 @@
 
 #include <bitset>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <utility>
 #include <vector>
@@ -52,7 +53,7 @@ public:
     float net_winrate;
     float root_uct_winrate;
     float child_uct_winrate;
-    int bestmove_visits;
+    std::int64_t bestmove_visits;
 };
 
 std::ostream& operator<<(std::ostream& stream, const TimeStep& timestep);
@@ -78,6 +79,8 @@ private:
 };
 
 class Training {
+    friend class LeelaTest;
+
 public:
     static void clear_training();
     static void dump_training(int winner_color,
@@ -85,6 +88,11 @@ public:
     static void dump_debug(const std::string& out_filename);
     static void record(Network& network, const GameState& state,
                        const UCTNode& node);
+    // Record a position from move visits that did not come from a search
+    // tree, like an opening book entry.
+    static void record(Network& network, const GameState& state,
+                       const std::vector<std::pair<int, int>>& visits,
+                       float winrate);
 
     static void dump_supervised(const std::string& sgf_file,
                                 const std::string& out_filename);
@@ -93,6 +101,10 @@ public:
 
 private:
     static TimeStep::NNPlanes get_planes(const GameState* state);
+    static void record(Network& network, const GameState& state,
+                       const std::vector<std::pair<int, std::int64_t>>& visits,
+                       float root_winrate, float child_winrate,
+                       std::int64_t bestmove_visits);
     static void process_game(GameState& state, size_t& train_pos, int who_won,
                              const std::vector<int>& tree_moves,
                              OutputChunker& outchunker);
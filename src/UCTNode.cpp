@@ -30,14 +30,17 @@
 #include "config.h"
 
 #include <algorithm>
+#include <bitset>
 #include <cassert>
 #include <cmath>
 #include <cstdint>
 #include <cstdio>
 #include <functional>
+#include <istream>
 #include <iterator>
 #include <limits>
 #include <numeric>
+#include <ostream>
 #include <utility>
 #include <vector>
 
@@ -52,14 +55,77 @@
 
 using namespace Utils;
 
+constexpr std::uint64_t UCTNode::EVAL_ONE;
+constexpr std::int64_t UCTNode::MAX_VISITS;
+constexpr std::uint8_t UCTNode::STATUS_MASK;
+constexpr int UCTNode::PROVEN_SHIFT;
+
+// Added to the sum of squared differences to avoid accidental zero
+// variances at low visits.
+static constexpr auto MIN_SQUARED_EVAL_DIFF = 1e-4;
+
+static std::uint64_t to_fixed(const float eval) {
+    return static_cast<std::uint64_t>(
+        std::llround(double(eval) * UCTNode::EVAL_ONE));
+}
+
 UCTNode::UCTNode(const int vertex, const float policy)
     : m_move(vertex), m_policy(policy) {}
 
 bool UCTNode::first_visit() const {
-    return m_visits == 0;
+    return get_visits() == 0;
+}
+
+// Queue evaluations of the most likely children, batching pipes run them
+// in spare slots so they are cached once the search gets there.
+static void prefetch_children(
+    Network& network, const GameState& state,
+    const std::vector<Network::PolicyVertexPair>& nodelist) {
+    auto child_state = state;
+    child_state.set_unmake_point();
+    const auto count = std::min(size_t{cfg_prefetch}, nodelist.size());
+    for (auto i = size_t{0}; i < count; i++) {
+        child_state.play_move(nodelist[i].second);
+        network.prefetch(&child_state);
+        child_state.unmake_moves();
+    }
+}
+
+// Keep the lowest vertex of each set of equivalent moves, with the
+// summed prior of the set.
+static void merge_symmetric_moves(
+    const GameState& state, const std::vector<int>& symmetries,
+    std::vector<Network::PolicyVertexPair>& nodelist) {
+    auto policy_sum = std::vector<float>(FastBoard::NUM_VERTICES, 0.0f);
+    auto representative = std::vector<int>(nodelist.size());
+    for (auto i = size_t{0}; i < nodelist.size(); i++) {
+        const auto vertex = nodelist[i].second;
+        auto rep = vertex;
+        for (const auto sym : symmetries) {
+            rep = std::min(rep, state.board.get_symmetric_vertex(vertex, sym));
+        }
+        representative[i] = rep;
+        if (rep != FastBoard::PASS) {
+            policy_sum[rep] += nodelist[i].first;
+        }
+    }
+
+    auto kept = size_t{0};
+    for (auto i = size_t{0}; i < nodelist.size(); i++) {
+        const auto vertex = nodelist[i].second;
+        if (representative[i] != vertex) {
+            continue;
+        }
+        if (vertex != FastBoard::PASS) {
+            nodelist[i].first = policy_sum[vertex];
+        }
+        nodelist[kept++] = nodelist[i];
+    }
+    nodelist.resize(kept);
 }
 
-bool UCTNode::create_children(Network& network, std::atomic<int>& nodecount,
+bool UCTNode::create_children(Network& network,
+                              std::atomic<std::int64_t>& nodecount,
                               const GameState& state, float& eval,
                               const float min_psa_ratio) {
     // no successors in final state
@@ -98,24 +164,31 @@ bool UCTNode::create_children(Network& network, std::atomic<int>& nodecount,
     }
     eval = m_net_eval;
 
+    // Filling our own eyes in pass-alive territory can't change the
+    // outcome, so don't spend visits on it.  While most of the board is
+    // still open there is rarely any, so don't look.
+    const auto board_size = state.board.get_boardsize();
+    auto legal_moves = state.get_legal_moves(to_move);
+    if (2 * state.board.calc_open_points().count() < board_size * board_size) {
+        legal_moves =
+            legal_moves.and_not(state.board.calc_pass_alive_eyes(to_move));
+    }
     std::vector<Network::PolicyVertexPair> nodelist;
+    nodelist.reserve(legal_moves.count() + 1);
 
     auto legal_sum = 0.0f;
-    for (auto i = 0; i < NUM_INTERSECTIONS; i++) {
-        const auto x = i % BOARD_SIZE;
-        const auto y = i / BOARD_SIZE;
-        const auto vertex = state.board.get_vertex(x, y);
-        if (state.is_move_legal(to_move, vertex)) {
-            nodelist.emplace_back(raw_netlist.policy[i], vertex);
-            legal_sum += raw_netlist.policy[i];
-        }
-    }
+    legal_moves.for_each([&](const int vertex) {
+        const auto xy = state.board.get_xy(vertex);
+        const auto idx = xy.second * board_size + xy.first;
+        nodelist.emplace_back(raw_netlist.policy[idx], vertex);
+        legal_sum += raw_netlist.policy[idx];
+    });
 
     // Always try passes if we're not trying to be clever.
     auto allow_pass = cfg_dumbpass;
 
     // Less than 20 available intersections in a 19x19 game.
-    if (int(nodelist.size()) <= std::max(5, BOARD_SIZE)) {
+    if (int(nodelist.size()) <= std::max(5, board_size)) {
         allow_pass = true;
     }
 
@@ -134,6 +207,13 @@ bool UCTNode::create_children(Network& network, std::atomic<int>& nodecount,
         legal_sum += raw_netlist.policy_pass;
     }
 
+    // Equivalent moves in a symmetric position lead to equivalent
+    // subtrees, so only search one of each.
+    const auto symmetries = state.get_symmetries();
+    if (!symmetries.empty()) {
+        merge_symmetric_moves(state, symmetries, nodelist);
+    }
+
     if (legal_sum > std::numeric_limits<float>::min()) {
         // re-normalize after removing illegal moves.
         for (auto& node : nodelist) {
@@ -153,10 +233,15 @@ bool UCTNode::create_children(Network& network, std::atomic<int>& nodecount,
         update(eval);
     }
     expand_done();
+
+    // link_nodelist() left the best children at the front.
+    if (cfg_prefetch > 0 && network.accepts_prefetch()) {
+        prefetch_children(network, state, nodelist);
+    }
     return true;
 }
 
-void UCTNode::link_nodelist(std::atomic<int>& nodecount,
+void UCTNode::link_nodelist(std::atomic<std::int64_t>& nodecount,
                             std::vector<Network::PolicyVertexPair>& nodelist,
                             const float min_psa_ratio) {
     assert(min_psa_ratio < m_min_psa_ratio_children);
@@ -165,34 +250,42 @@ void UCTNode::link_nodelist(std::atomic<int>& nodecount,
         return;
     }
 
-    // Use best to worst order, so highest go first
-    std::stable_sort(rbegin(nodelist), rend(nodelist));
-
-    const auto max_psa = nodelist[0].first;
+    const auto max_psa =
+        std::max_element(cbegin(nodelist), cend(nodelist))->first;
     const auto old_min_psa = max_psa * m_min_psa_ratio_children;
     const auto new_min_psa = max_psa * min_psa_ratio;
+
+    // Move the children we keep to the front, only they need sorting.
+    // Keep their order so that equal priors sort as they would have in
+    // the full list.
+    auto kept_end = end(nodelist);
     if (new_min_psa > 0.0f) {
-        m_children.reserve(std::count_if(
-            cbegin(nodelist), cend(nodelist),
-            [=](const auto& node) { return node.first >= new_min_psa; }));
-    } else {
-        m_children.reserve(nodelist.size());
+        kept_end = std::stable_partition(
+            begin(nodelist), end(nodelist),
+            [=](const auto& node) { return node.first >= new_min_psa; });
     }
+    const auto skipped_children = kept_end != end(nodelist);
 
-    auto skipped_children = false;
-    for (const auto& node : nodelist) {
-        if (node.first < new_min_psa) {
-            skipped_children = true;
-        } else if (node.first < old_min_psa) {
-            m_children.emplace_back(node.second, node.first);
-            ++nodecount;
-        }
+    // Use best to worst order, so highest go first
+    std::stable_sort(std::make_reverse_iterator(kept_end), rend(nodelist));
+
+    // Children linked by an earlier expansion are at the front.  The new
+    // ones only get materialized when the search can reach them, but there
+    // is always a first one.
+    const auto new_begin =
+        std::find_if(begin(nodelist), kept_end, [=](const auto& node) {
+            return node.first < old_min_psa;
+        });
+    m_children.add(new_begin, kept_end);
+    nodecount += std::distance(new_begin, kept_end);
+    if (m_children.total_size() > 0) {
+        m_children.materialize(0);
     }
 
     m_min_psa_ratio_children = skipped_children ? min_psa_ratio : 0.0f;
 }
 
-const std::vector<UCTNodePointer>& UCTNode::get_children() const {
+const UCTNodeChildren& UCTNode::get_children() const {
     return m_children;
 }
 
@@ -201,24 +294,29 @@ int UCTNode::get_move() const {
 }
 
 void UCTNode::virtual_loss() {
-    m_virtual_loss += VIRTUAL_LOSS_COUNT;
+    m_visits_and_vl.fetch_add(VIRTUAL_LOSS_COUNT, std::memory_order_relaxed);
 }
 
 void UCTNode::virtual_loss_undo() {
-    m_virtual_loss -= VIRTUAL_LOSS_COUNT;
+    m_visits_and_vl.fetch_sub(VIRTUAL_LOSS_COUNT, std::memory_order_relaxed);
 }
 
 void UCTNode::update(const float eval) {
-    // Cache values to avoid race conditions.
-    auto old_eval = static_cast<float>(m_blackevals);
-    auto old_visits = static_cast<int>(m_visits);
-    auto old_delta = old_visits > 0 ? eval - old_eval / old_visits : 0.0f;
-    m_visits++;
-    accumulate_eval(eval);
-    auto new_delta = eval - (old_eval + eval) / (old_visits + 1);
-    // Welford's online algorithm for calculating variance.
-    auto delta = old_delta * new_delta;
-    atomic_add(m_squared_eval_diff, delta);
+    // The variance is derived from the sums of evals and squared evals
+    // on read, so there is nothing here that depends on the old values.
+    m_visits_and_vl.fetch_add(std::uint64_t{1} << VIRTUAL_LOSS_BITS,
+                              std::memory_order_relaxed);
+    m_blackevals.fetch_add(to_fixed(eval), std::memory_order_relaxed);
+    m_squared_evals.fetch_add(to_fixed(eval * eval),
+                              std::memory_order_relaxed);
+}
+
+void UCTNode::add_visits(const std::int64_t visits, const float eval) {
+    m_visits_and_vl.fetch_add(std::uint64_t(visits) << VIRTUAL_LOSS_BITS,
+                              std::memory_order_relaxed);
+    m_blackevals.fetch_add(visits * to_fixed(eval), std::memory_order_relaxed);
+    m_squared_evals.fetch_add(visits * to_fixed(eval * eval),
+                              std::memory_order_relaxed);
 }
 
 bool UCTNode::has_children() const {
@@ -245,11 +343,22 @@ void UCTNode::set_policy(const float policy) {
 }
 
 float UCTNode::get_eval_variance(const float default_var) const {
-    return m_visits > 1 ? m_squared_eval_diff / (m_visits - 1) : default_var;
+    const auto visits = get_visits();
+    if (visits < 2) {
+        return default_var;
+    }
+    const auto sum = get_blackevals();
+    const auto sum_squares =
+        double(m_squared_evals.load(std::memory_order_relaxed)) / EVAL_ONE;
+    // Sum of squared differences from the mean.
+    const auto squared_diff = std::max(0.0, sum_squares - sum * sum / visits);
+    return static_cast<float>((MIN_SQUARED_EVAL_DIFF + squared_diff)
+                              / (visits - 1));
 }
 
-int UCTNode::get_visits() const {
-    return m_visits;
+std::int64_t UCTNode::get_visits() const {
+    return static_cast<std::int64_t>(
+        m_visits_and_vl.load(std::memory_order_relaxed) >> VIRTUAL_LOSS_BITS);
 }
 
 float UCTNode::get_eval_lcb(const int color) const {
@@ -285,7 +394,10 @@ float UCTNode::get_eval(const int tomove) const {
     // Due to the use of atomic updates and virtual losses, it is
     // possible for the visit count to change underneath us. Make sure
     // to return a consistent result to the caller by caching the values.
-    return get_raw_eval(tomove, m_virtual_loss);
+    const auto virtual_loss = static_cast<int>(
+        m_visits_and_vl.load(std::memory_order_relaxed)
+        & ((std::uint64_t{1} << VIRTUAL_LOSS_BITS) - 1));
+    return get_raw_eval(tomove, virtual_loss);
 }
 
 float UCTNode::get_net_eval(const int tomove) const {
@@ -296,11 +408,7 @@ float UCTNode::get_net_eval(const int tomove) const {
 }
 
 double UCTNode::get_blackevals() const {
-    return m_blackevals;
-}
-
-void UCTNode::accumulate_eval(const float eval) {
-    atomic_add(m_blackevals, double(eval));
+    return double(m_blackevals.load(std::memory_order_relaxed)) / EVAL_ONE;
 }
 
 UCTNode* UCTNode::uct_select_child(const int color, const bool is_root) {
@@ -330,7 +438,9 @@ UCTNode* UCTNode::uct_select_child(const int color, const bool is_root) {
     auto best = static_cast<UCTNodePointer*>(nullptr);
     auto best_value = std::numeric_limits<double>::lowest();
 
-    for (auto& child : m_children) {
+    const auto materialized = m_children.size();
+    for (auto i = size_t{0}; i < materialized; i++) {
+        auto& child = m_children[i];
         if (!child.active()) {
             continue;
         }
@@ -356,6 +466,16 @@ UCTNode* UCTNode::uct_select_child(const int color, const bool is_root) {
         }
     }
 
+    // The children that aren't materialized have no visits and no more
+    // policy than the first of them, so that one is the only candidate.
+    if (materialized < m_children.total_size()) {
+        const auto psa = m_children.policy(materialized);
+        const auto value = fpu_eval + cfg_puct * psa * numerator;
+        if (value > best_value) {
+            best = &m_children.materialize(materialized);
+        }
+    }
+
     assert(best != nullptr);
     best->inflate();
     return best->get();
@@ -409,7 +529,7 @@ private:
 };
 
 void UCTNode::sort_children(const int color, const float lcb_min_visits) {
-    std::stable_sort(rbegin(m_children), rend(m_children),
+    std::stable_sort(m_children.rbegin(), m_children.rend(),
                      NodeComp(color, lcb_min_visits));
 }
 
@@ -418,22 +538,182 @@ UCTNode& UCTNode::get_best_root_child(const int color) const {
 
     assert(!m_children.empty());
 
-    auto max_visits = 0;
+    auto max_visits = std::int64_t{0};
     for (const auto& node : m_children) {
         max_visits = std::max(max_visits, node.get_visits());
     }
 
     auto ret =
-        std::max_element(begin(m_children), end(m_children),
+        std::max_element(m_children.begin(), m_children.end(),
                          NodeComp(color, cfg_lcb_min_visit_ratio * max_visits));
     ret->inflate();
 
     return *(ret->get());
 }
 
+size_t UCTNode::count_nodes() const {
+    auto nodecount = m_children.total_size();
+    for (const auto& child : m_children) {
+        if (child.is_inflated()) {
+            nodecount += child->count_nodes();
+        }
+    }
+    return nodecount;
+}
+
+size_t UCTNode::get_tree_memory() const {
+    auto memory = m_children.memory_used();
+    for (const auto& child : m_children) {
+        memory += sizeof(UCTNodePointer);
+        if (child.is_inflated()) {
+            memory += sizeof(UCTNode) + child->get_tree_memory();
+        }
+    }
+    return memory;
+}
+
+size_t UCTNode::clear_children() {
+    const auto nodecount = count_nodes();
+    m_children.clear();
+    m_min_psa_ratio_children = 2.0f;
+    m_expand_state = ExpandState::INITIAL;
+    return nodecount;
+}
+
+template <typename T>
+static void write_value(std::ostream& out, const T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename T>
+static bool read_value(std::istream& in, T& value) {
+    return bool(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+}
+
+void UCTNode::save(std::ostream& out) const {
+    write_value(out, m_move);
+    write_value(out, m_policy);
+    write_value(out, m_status.load());
+    write_value(out, m_expand_state.load());
+    write_value(out, m_net_eval);
+    write_value(out, m_min_psa_ratio_children.load());
+    write_value(out, m_visits_and_vl.load() >> VIRTUAL_LOSS_BITS);
+    write_value(out, m_blackevals.load());
+    write_value(out, m_squared_evals.load());
+
+    // All children as compact vertex and policy pairs, then a flag for
+    // each materialized one telling whether a subtree follows.  Sorting
+    // the root reorders the materialized children, so those come from
+    // their UCTNodePointers and only the rest from the compact arrays.
+    const auto count = std::uint16_t(m_children.total_size());
+    const auto materialized = std::uint16_t(m_children.size());
+    write_value(out, count);
+    write_value(out, materialized);
+    for (const auto& child : m_children) {
+        write_value(out, std::int16_t(child.get_move()));
+        write_value(out, child.get_policy());
+    }
+    for (auto i = size_t{materialized}; i < count; i++) {
+        write_value(out, std::int16_t(m_children.vertex(i)));
+        write_value(out, m_children.policy(i));
+    }
+    for (const auto& child : m_children) {
+        const auto inflated = child.is_inflated();
+        write_value(out, std::uint8_t(inflated));
+        if (inflated) {
+            child->save(out);
+        }
+    }
+}
+
+static bool valid_vertex(const FastBoard& board, const int vertex) {
+    return vertex == FastBoard::PASS
+           || (vertex >= 0 && vertex < FastBoard::NUM_VERTICES
+               && board.get_state(vertex) != FastBoard::INVAL);
+}
+
+bool UCTNode::load(std::istream& in, const FastBoard& board) {
+    assert(m_children.empty());
+
+    auto status = std::uint8_t{};
+    auto expand_state = ExpandState{};
+    auto min_psa_ratio = 0.0f;
+    auto visits = std::uint64_t{};
+    auto blackevals = std::uint64_t{};
+    auto squared_evals = std::uint64_t{};
+    auto count = std::uint16_t{};
+    auto materialized = std::uint16_t{};
+    if (!read_value(in, m_move) || !read_value(in, m_policy)
+        || !read_value(in, status) || !read_value(in, expand_state)
+        || !read_value(in, m_net_eval) || !read_value(in, min_psa_ratio)
+        || !read_value(in, visits) || !read_value(in, blackevals)
+        || !read_value(in, squared_evals) || !read_value(in, count)
+        || !read_value(in, materialized)) {
+        return false;
+    }
+    if (!valid_vertex(board, m_move)
+        || (status & STATUS_MASK) > ACTIVE
+        || (status >> PROVEN_SHIFT) > std::uint8_t(Proven::DRAW)
+        || expand_state == ExpandState::EXPANDING
+        || materialized > count || count > POTENTIAL_MOVES
+        || visits > std::uint64_t{MAX_VISITS}) {
+        return false;
+    }
+    m_status = status;
+    m_expand_state = expand_state;
+    m_min_psa_ratio_children = min_psa_ratio;
+    m_visits_and_vl = visits << VIRTUAL_LOSS_BITS;
+    m_blackevals = blackevals;
+    m_squared_evals = squared_evals;
+
+    auto nodelist = std::vector<Network::PolicyVertexPair>{};
+    // Indexed by vertex, with pass last.
+    auto seen = std::bitset<FastBoard::NUM_VERTICES + 1>{};
+    for (auto i = 0; i < count; i++) {
+        auto vertex = std::int16_t{};
+        auto policy = 0.0f;
+        if (!read_value(in, vertex) || !read_value(in, policy)
+            || !valid_vertex(board, vertex)) {
+            return false;
+        }
+        const auto index =
+            vertex == FastBoard::PASS ? FastBoard::NUM_VERTICES : vertex;
+        if (seen[index]) {
+            return false;
+        }
+        seen[index] = true;
+        // Children that aren't materialized are kept in policy order.
+        if (i > materialized && nodelist.back().first < policy) {
+            return false;
+        }
+        nodelist.emplace_back(policy, vertex);
+    }
+    // The materialized ones can be in any order, add them one at a time.
+    const auto tail = cbegin(nodelist) + materialized;
+    for (auto it = cbegin(nodelist); it != tail; ++it) {
+        m_children.add(it, std::next(it));
+        m_children.materialize(m_children.total_size() - 1);
+    }
+    m_children.add(tail, cend(nodelist));
+    for (auto& child : m_children) {
+        auto inflated = std::uint8_t{};
+        if (!read_value(in, inflated)) {
+            return false;
+        }
+        if (inflated) {
+            const auto vertex = child.get_move();
+            child.inflate();
+            if (!child->load(in, board) || child->get_move() != vertex) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 size_t UCTNode::count_nodes_and_clear_expand_state() {
     auto nodecount = size_t{0};
-    nodecount += m_children.size();
+    nodecount += m_children.total_size();
     if (expandable()) {
         m_expand_state = ExpandState::INITIAL;
     }
@@ -445,22 +725,91 @@ size_t UCTNode::count_nodes_and_clear_expand_state() {
     return nodecount;
 }
 
+void UCTNode::set_status(const Status status) {
+    auto v = m_status.load();
+    while (!m_status.compare_exchange_weak(
+        v, std::uint8_t((v & ~STATUS_MASK) | status))) {
+    }
+}
+
 void UCTNode::invalidate() {
-    m_status = INVALID;
+    set_status(INVALID);
 }
 
 void UCTNode::set_active(const bool active) {
     if (valid()) {
-        m_status = active ? ACTIVE : PRUNED;
+        set_status(active ? ACTIVE : PRUNED);
     }
 }
 
 bool UCTNode::valid() const {
-    return m_status != INVALID;
+    return (m_status & STATUS_MASK) != INVALID;
 }
 
 bool UCTNode::active() const {
-    return m_status == ACTIVE;
+    return (m_status & STATUS_MASK) == ACTIVE;
+}
+
+UCTNode::Proven UCTNode::get_proven() const {
+    return Proven(m_status >> PROVEN_SHIFT);
+}
+
+float UCTNode::get_proven_eval() const {
+    switch (get_proven()) {
+        case Proven::BLACK_WINS:
+            return 1.0f;
+        case Proven::WHITE_WINS:
+            return 0.0f;
+        default:
+            assert(get_proven() == Proven::DRAW);
+            return 0.5f;
+    }
+}
+
+void UCTNode::set_proven(const Proven proven) {
+    // Once known the value can't change, so only the first one counts.
+    auto v = m_status.load();
+    while ((v >> PROVEN_SHIFT) == std::uint8_t(Proven::UNKNOWN)
+           && !m_status.compare_exchange_weak(
+               v, std::uint8_t(v | (std::uint8_t(proven) << PROVEN_SHIFT)))) {
+    }
+}
+
+void UCTNode::update_proven(const int color) {
+    const auto win =
+        color == FastBoard::BLACK ? Proven::BLACK_WINS : Proven::WHITE_WINS;
+    const auto loss =
+        color == FastBoard::BLACK ? Proven::WHITE_WINS : Proven::BLACK_WINS;
+
+    // A loss needs every move proven lost, so all children must have been
+    // created, and passing must be among them.
+    auto all_lost = m_min_psa_ratio_children == 0.0f
+                    && m_children.size() == m_children.total_size();
+    auto has_pass = false;
+    for (const auto& child : m_children) {
+        if (!child.valid()) {
+            // Superko, not a move we have.
+            continue;
+        }
+        if (!child.is_inflated()) {
+            all_lost = false;
+            continue;
+        }
+        const auto proven = child->get_proven();
+        if (proven == win) {
+            set_proven(win);
+            return;
+        }
+        if (proven != loss || !child->active()) {
+            all_lost = false;
+        }
+        if (child->get_move() == FastBoard::PASS) {
+            has_pass = true;
+        }
+    }
+    if (all_lost && has_pass) {
+        set_proven(loss);
+    }
 }
 
 bool UCTNode::acquire_expanding() {
@@ -34,7 +34,10 @@
 
 #include <atomic>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
+#include <iosfwd>
+#include <limits>
 #include <memory>
 #include <vector>
 
@@ -49,21 +52,52 @@ public:
     // to it to encourage other CPUs to explore other parts of the
     // search tree.
     static constexpr auto VIRTUAL_LOSS_COUNT = 3;
+    // Bits of the packed visit counter reserved for virtual losses.
+    static constexpr auto VIRTUAL_LOSS_BITS = 16;
+    static_assert(VIRTUAL_LOSS_COUNT * MAX_CPUS < (1 << VIRTUAL_LOSS_BITS),
+                  "Virtual losses would overflow into the visit count");
+    // Fixed point representation of an eval of 1.0. This is as precise
+    // as the float evals that are summed, and leaves room for MAX_VISITS
+    // of them.
+    static constexpr std::uint64_t EVAL_ONE = std::uint64_t{1} << 24;
+    // Visits a node can take before any of its counters overflows.
+    static constexpr std::int64_t MAX_VISITS =
+        std::numeric_limits<std::uint64_t>::max() / EVAL_ONE;
+    static_assert(MAX_VISITS < (std::int64_t{1} << (64 - VIRTUAL_LOSS_BITS)),
+                  "Visits would overflow the packed visit counter");
+    // Game theoretic value of a node, known when the game ended or the
+    // outcome was proven from the children.
+    enum class Proven : std::uint8_t {
+        UNKNOWN = 0,
+        BLACK_WINS,
+        WHITE_WINS,
+        DRAW
+    };
     // Defined in UCTNode.cpp
     explicit UCTNode(int vertex, float policy);
     UCTNode() = delete;
     ~UCTNode() = default;
 
-    bool create_children(Network& network, std::atomic<int>& nodecount,
+    bool create_children(Network& network,
+                         std::atomic<std::int64_t>& nodecount,
                          const GameState& state, float& eval,
                          float min_psa_ratio = 0.0f);
 
-    const std::vector<UCTNodePointer>& get_children() const;
+    const UCTNodeChildren& get_children() const;
     void sort_children(int color, float lcb_min_visits);
     UCTNode& get_best_root_child(int color) const;
     UCTNode* uct_select_child(int color, bool is_root);
 
+    size_t count_nodes() const;
     size_t count_nodes_and_clear_expand_state();
+    // What the subtree below this node adds to
+    // UCTNodePointer::get_tree_size().
+    size_t get_tree_memory() const;
+    // Drop the whole subtree below this node and return to the unexpanded
+    // state, keeping our own statistics.  Not thread-safe, must only be
+    // called while no search threads run.  Returns the number of nodes
+    // that were removed.
+    size_t clear_children();
     bool first_visit() const;
     bool has_children() const;
     bool expandable(float min_psa_ratio = 0.0f) const;
@@ -72,7 +106,7 @@ public:
     bool valid() const;
     bool active() const;
     int get_move() const;
-    int get_visits() const;
+    std::int64_t get_visits() const;
     float get_policy() const;
     void set_policy(float policy);
     float get_eval_variance(float default_var = 0.0f) const;
@@ -82,31 +116,74 @@ public:
     void virtual_loss();
     void virtual_loss_undo();
     void update(float eval);
+    // Count visits that were searched elsewhere, all with their
+    // average eval.
+    void add_visits(std::int64_t visits, float eval);
     float get_eval_lcb(int color) const;
 
+    Proven get_proven() const;
+    // Exact eval of a proven node, from black's point of view.
+    float get_proven_eval() const;
+    void set_proven(Proven proven);
+    // Called after visiting a proven child, marks us proven when the
+    // children decide the outcome for 'color', the side to move here.
+    void update_proven(int color);
+
     // Defined in UCTNodeRoot.cpp, only to be called on m_root in UCTSearch
     void randomize_first_proportionally();
     void prepare_root_node(Network& network, int color,
-                           std::atomic<int>& nodecount, GameState& state);
+                           std::atomic<std::int64_t>& nodecount,
+                           GameState& state, bool add_noise);
 
     UCTNode* get_first_child() const;
     UCTNode* get_nopass_child(FastState& state) const;
-    std::unique_ptr<UCTNode> find_child(int move);
+    // Take the subtree for 'move' played in 'state', the position of this
+    // node.  In a symmetric position the child may stand for 'move', then
+    // the subtree is mapped through the symmetry that takes it there.
+    std::unique_ptr<UCTNode> find_child(const GameState& state, int move);
+    // Put a subtree for 'move' back in the place of the unvisited
+    // stand-in find_child() left, mapped the other way if need be.
+    // Returns false if there is no such move.  Only this node's totals
+    // change, restore subtrees bottom-up to keep the whole tree right.
+    bool restore_child(const GameState& state, int move,
+                       std::unique_ptr<UCTNode>& child);
+    // Map the moves of the subtree below this node through a board
+    // symmetry.  Only while no search threads run.
+    void map_moves(const FullBoard& board, int symmetry);
+    // Add visits searched elsewhere to the child for 'move' and to this
+    // node.  Safe while the search runs.  Returns false if there is no
+    // such move.
+    bool add_child_visits(int move, std::int64_t visits, float eval);
     void inflate_all_children();
 
     void clear_expand_state();
 
+    // Write this node and everything below it to 'out' in pre-order,
+    // or read it back.  Only while no search threads run.  load() returns
+    // false if the stream ends early or holds inconsistent data, or moves
+    // that are not on 'board'.
+    void save(std::ostream& out) const;
+    bool load(std::istream& in, const FastBoard& board);
+
 private:
-    enum Status : char {
+    enum Status : std::uint8_t {
         INVALID, // superko
         PRUNED,
         ACTIVE
     };
-    void link_nodelist(std::atomic<int>& nodecount,
+    // m_status holds the Status in the low bits and the Proven value
+    // above them.
+    static constexpr std::uint8_t STATUS_MASK = 0x3;
+    static constexpr auto PROVEN_SHIFT = 2;
+    void set_status(Status status);
+    // Swap the totals of subtree 'removed' in ours for those of 'added',
+    // either may be null.  Keeps our visits those of our children when
+    // whole subtrees are taken out or put back.
+    void replace_subtree_totals(const UCTNode* removed, const UCTNode* added);
+    void link_nodelist(std::atomic<std::int64_t>& nodecount,
                        std::vector<Network::PolicyVertexPair>& nodelist,
                        float min_psa_ratio);
     double get_blackevals() const;
-    void accumulate_eval(float eval);
     void kill_superkos(const GameState& state);
     void dirichlet_noise(float epsilon, float alpha);
 
@@ -116,19 +193,7 @@ private:
 
     // Move
     std::int16_t m_move;
-    // UCT
-    std::atomic<std::int16_t> m_virtual_loss{0};
-    std::atomic<int> m_visits{0};
-    // UCT eval
-    float m_policy;
-    // Original net eval for this node (not children).
-    float m_net_eval{0.0f};
-    // Variable used for calculating variance of evaluations.
-    // Initialized to small non-zero value to avoid accidental zero variances
-    // at low visits.
-    std::atomic<float> m_squared_eval_diff{1e-4f};
-    std::atomic<double> m_blackevals{0.0};
-    std::atomic<Status> m_status{ACTIVE};
+    std::atomic<std::uint8_t> m_status{ACTIVE};
 
     // m_expand_state acts as the lock for m_children.
     // see manipulation methods below for possible state transition
@@ -142,14 +207,31 @@ private:
         EXPANDING,
 
         // expansion done.  m_children cannot be modified on a multi-thread
-        // context, until node is destroyed.
+        // context, until node is destroyed, except for materializing the
+        // children the search reaches.
         EXPANDED,
     };
     std::atomic<ExpandState> m_expand_state{ExpandState::INITIAL};
 
+    // UCT eval
+    float m_policy;
+    // Original net eval for this node (not children).
+    float m_net_eval{0.0f};
+
     // Tree data
     std::atomic<float> m_min_psa_ratio_children{2.0f};
-    std::vector<UCTNodePointer> m_children;
+
+    // UCT statistics, each updated with a single fetch_add so that a
+    // backup step doesn't need any compare-and-swap loops.
+    // Visits live in the upper bits, virtual losses in the lower
+    // VIRTUAL_LOSS_BITS, so one load gives a consistent pair of both.
+    std::atomic<std::uint64_t> m_visits_and_vl{0};
+    // Sum of the evals from black's point of view, and of their squares
+    // for the variance, in fixed point with EVAL_ONE as 1.0.
+    std::atomic<std::uint64_t> m_blackevals{0};
+    std::atomic<std::uint64_t> m_squared_evals{0};
+
+    UCTNodeChildren m_children;
 
     //  m_expand_state manipulation methods
     // INITIAL -> EXPANDING
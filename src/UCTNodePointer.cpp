@@ -29,15 +29,19 @@
 
 #include "config.h"
 
+#include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cstring>
 #include <memory>
+#include <new>
 
 #include "UCTNode.h"
 
 std::atomic<size_t> UCTNodePointer::m_tree_size = {0};
 
+constexpr size_t UCTNodeChildren::FIRST_SEGMENT;
+
 size_t UCTNodePointer::get_tree_size() {
     return m_tree_size.load();
 }
@@ -82,6 +86,11 @@ UCTNodePointer::UCTNodePointer(const std::int16_t vertex, const float policy) {
     increment_tree_size(sizeof(UCTNodePointer));
 }
 
+UCTNodePointer::UCTNodePointer(std::unique_ptr<UCTNode>&& node) {
+    m_data = reinterpret_cast<std::uint64_t>(node.release()) | POINTER;
+    increment_tree_size(sizeof(UCTNodePointer) + sizeof(UCTNode));
+}
+
 UCTNodePointer& UCTNodePointer::operator=(UCTNodePointer&& n) {
     auto nv = std::atomic_exchange(&n.m_data, INVALID);
     auto v = std::atomic_exchange(&m_data, nv);
@@ -126,7 +135,7 @@ bool UCTNodePointer::valid() const {
     return true;
 }
 
-int UCTNodePointer::get_visits() const {
+std::int64_t UCTNodePointer::get_visits() const {
     auto v = m_data.load();
     if (is_inflated(v)) return read_ptr(v)->get_visits();
     return 0;
@@ -157,6 +166,97 @@ float UCTNodePointer::get_eval(const int tomove) const {
     return read_ptr(v)->get_eval(tomove);
 }
 
+UCTNodeChildren::Storage::~Storage() {
+    const auto count = size.load();
+    for (auto i = size_t{0}; i < count; i++) {
+        at(i).~UCTNodePointer();
+    }
+    for (const auto segment : segments) {
+        ::operator delete(segment);
+    }
+}
+
+UCTNodeChildren::~UCTNodeChildren() {
+    clear();
+}
+
+void UCTNodeChildren::grow(const size_t added) {
+    if (!m_storage) {
+        m_storage = std::make_unique<Storage>();
+        UCTNodePointer::increment_tree_size(sizeof(Storage));
+    }
+    auto& storage = *m_storage;
+    const auto count = size_t{storage.count};
+    assert(count + added <= POTENTIAL_MOVES);
+
+    auto vertices = std::make_unique<std::int16_t[]>(count + added);
+    auto policies = std::make_unique<float[]>(count + added);
+    std::copy_n(storage.vertices.get(), count, vertices.get());
+    std::copy_n(storage.policies.get(), count, policies.get());
+    storage.vertices = std::move(vertices);
+    storage.policies = std::move(policies);
+    UCTNodePointer::increment_tree_size(
+        added * (sizeof(std::int16_t) + sizeof(float)));
+}
+
+UCTNodePointer& UCTNodeChildren::materialize(const size_t index) {
+    auto& storage = *m_storage;
+    assert(index < storage.count);
+    if (index < storage.size.load(std::memory_order_acquire)) {
+        return storage.at(index);
+    }
+
+    LOCK(storage.mutex, lock);
+    auto count = size_t{storage.size.load(std::memory_order_relaxed)};
+    for (; count <= index; count++) {
+        const auto segment = segment_of(count);
+        if (storage.segments[segment] == nullptr) {
+            const auto capacity = segment == 0 ? FIRST_SEGMENT
+                                               : segment_start(segment);
+            storage.segments[segment] = static_cast<UCTNodePointer*>(
+                ::operator new(capacity * sizeof(UCTNodePointer)));
+        }
+        new (&storage.at(count))
+            UCTNodePointer(storage.vertices[count], storage.policies[count]);
+    }
+    // Publish the new children only once they are constructed.
+    storage.size.store(std::uint16_t(count), std::memory_order_release);
+    return storage.at(index);
+}
+
+void UCTNodeChildren::materialize_all() {
+    if (total_size() > 0) {
+        materialize(total_size() - 1);
+    }
+}
+
+void UCTNodeChildren::erase(const iterator first, const iterator last) {
+    assert(last == end());
+    assert(size() == total_size());
+    (void)last;
+    if (!m_storage) {
+        return;
+    }
+    const auto new_size = size_t(first - begin());
+    auto& storage = *m_storage;
+    for (auto i = new_size; i < storage.count; i++) {
+        storage.at(i).~UCTNodePointer();
+    }
+    // All children are materialized, so the compact arrays are never read
+    // again.  They keep their allocation.
+    UCTNodePointer::decrement_tree_size(
+        (storage.count - new_size) * (sizeof(std::int16_t) + sizeof(float)));
+    storage.count = std::uint16_t(new_size);
+    storage.size = std::uint16_t(new_size);
+}
+
+void UCTNodeChildren::clear() {
+    if (m_storage) {
+        UCTNodePointer::decrement_tree_size(m_storage->memory_used());
+        m_storage.reset();
+    }
+}
+
 int UCTNodePointer::get_move() const {
     auto v = m_data.load();
     if (is_inflated(v)) return read_ptr(v)->get_move();
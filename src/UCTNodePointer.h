@@ -32,10 +32,15 @@
 
 #include "config.h"
 
+#include <array>
 #include <atomic>
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
 #include <cstring>
+#include <iterator>
 #include <memory>
+#include <vector>
 
 #include "SMP.h"
 
@@ -54,6 +59,8 @@ class UCTNode;
 // the instanced is 'moved from'.
 
 class UCTNodePointer {
+    friend class UCTNodeChildren;
+
 private:
     static constexpr std::uint64_t INVALID = 2;
     static constexpr std::uint64_t POINTER = 1;
@@ -101,6 +108,7 @@ public:
     ~UCTNodePointer();
     UCTNodePointer(UCTNodePointer&& n);
     UCTNodePointer(std::int16_t vertex, float policy);
+    explicit UCTNodePointer(std::unique_ptr<UCTNode>&& node);
     UCTNodePointer(const UCTNodePointer&) = delete;
 
     bool is_inflated() const {
@@ -126,7 +134,7 @@ public:
     // proxy of UCTNode methods which can be called without
     // constructing UCTNode
     bool valid() const;
-    int get_visits() const;
+    std::int64_t get_visits() const;
     float get_policy() const;
     bool active() const;
     int get_move() const;
@@ -135,4 +143,260 @@ public:
     float get_eval_lcb(int color) const;
 };
 
+// Number of segments of 8, 8, 16, 32, ... entries needed to hold 'count'.
+static constexpr size_t children_segments(const size_t count) {
+    return count <= 8 ? 1 : 1 + children_segments((count + 1) / 2);
+}
+
+// Children of an expanded UCTNode, highest policy first.  Only a prefix
+// of them exists as UCTNodePointers, the rest are kept as compact vertex
+// and policy arrays until the search can reach them, see
+// UCTNode::uct_select_child().  The prefix lives in segments of growing
+// size that never move, so it can be read while another thread extends it.
+//
+// Sorting or erasing reorders the prefix but not the arrays, so the
+// arrays only describe the children that aren't materialized yet.
+// Iteration only covers the materialized prefix.
+class UCTNodeChildren {
+private:
+    // Each segment after the first doubles the total size.
+    static constexpr size_t FIRST_SEGMENT = 8;
+    static constexpr auto SEGMENTS = children_segments(POTENTIAL_MOVES);
+
+    static size_t segment_start(const size_t segment) {
+        return segment == 0 ? 0 : FIRST_SEGMENT << (segment - 1);
+    }
+    static size_t segment_of(const size_t index) {
+        auto segment = size_t{0};
+        while (index >= (FIRST_SEGMENT << segment)) {
+            segment++;
+        }
+        return segment;
+    }
+
+    struct Storage {
+        ~Storage();
+        size_t memory_used() const {
+            return sizeof(Storage)
+                   + count * (sizeof(std::int16_t) + sizeof(float));
+        }
+        UCTNodePointer& at(const size_t index) const {
+            const auto segment = segment_of(index);
+            return segments[segment][index - segment_start(segment)];
+        }
+
+        // Number of materialized children.
+        std::atomic<std::uint16_t> size{0};
+        // Number of children.
+        std::uint16_t count{0};
+        SMP::Mutex mutex;
+        std::unique_ptr<std::int16_t[]> vertices;
+        std::unique_ptr<float[]> policies;
+        std::array<UCTNodePointer*, SEGMENTS> segments{};
+    };
+
+    std::unique_ptr<Storage> m_storage;
+
+    void grow(size_t added);
+
+public:
+    template <typename T>
+    class Iterator {
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = UCTNodePointer;
+        using difference_type = std::ptrdiff_t;
+        using pointer = T*;
+        using reference = T&;
+
+        Iterator() = default;
+        Iterator(const Storage* storage, const size_t index)
+            : m_storage(storage), m_index(index) {}
+
+        reference operator*() const {
+            return m_storage->at(m_index);
+        }
+        pointer operator->() const {
+            return &m_storage->at(m_index);
+        }
+        reference operator[](const difference_type n) const {
+            return m_storage->at(m_index + n);
+        }
+        Iterator& operator++() {
+            ++m_index;
+            return *this;
+        }
+        Iterator operator++(int) {
+            auto tmp = *this;
+            ++m_index;
+            return tmp;
+        }
+        Iterator& operator--() {
+            --m_index;
+            return *this;
+        }
+        Iterator operator--(int) {
+            auto tmp = *this;
+            --m_index;
+            return tmp;
+        }
+        Iterator& operator+=(const difference_type n) {
+            m_index += n;
+            return *this;
+        }
+        Iterator& operator-=(const difference_type n) {
+            m_index -= n;
+            return *this;
+        }
+        Iterator operator+(const difference_type n) const {
+            return Iterator(m_storage, m_index + n);
+        }
+        friend Iterator operator+(const difference_type n, const Iterator& it) {
+            return it + n;
+        }
+        Iterator operator-(const difference_type n) const {
+            return Iterator(m_storage, m_index - n);
+        }
+        difference_type operator-(const Iterator& other) const {
+            return difference_type(m_index) - difference_type(other.m_index);
+        }
+        bool operator==(const Iterator& other) const {
+            return m_index == other.m_index;
+        }
+        bool operator!=(const Iterator& other) const {
+            return m_index != other.m_index;
+        }
+        bool operator<(const Iterator& other) const {
+            return m_index < other.m_index;
+        }
+        bool operator>(const Iterator& other) const {
+            return m_index > other.m_index;
+        }
+        bool operator<=(const Iterator& other) const {
+            return m_index <= other.m_index;
+        }
+        bool operator>=(const Iterator& other) const {
+            return m_index >= other.m_index;
+        }
+
+    private:
+        const Storage* m_storage{nullptr};
+        size_t m_index{0};
+    };
+    using iterator = Iterator<UCTNodePointer>;
+    using const_iterator = Iterator<const UCTNodePointer>;
+
+    UCTNodeChildren() = default;
+    ~UCTNodeChildren();
+
+    // Number of materialized children.
+    size_t size() const {
+        return m_storage ? m_storage->size.load(std::memory_order_acquire)
+                         : 0;
+    }
+    bool empty() const {
+        return size() == 0;
+    }
+    // Including the children that aren't materialized yet.
+    size_t total_size() const {
+        return m_storage ? m_storage->count : 0;
+    }
+    // Memory counted in the tree size, apart from the materialized
+    // UCTNodePointers and what they point to.
+    size_t memory_used() const {
+        return m_storage ? m_storage->memory_used() : 0;
+    }
+    // Policy and vertex of the child at 'index', which must be at or past
+    // size() when the prefix was last reordered.  Read the materialized
+    // children through their UCTNodePointers.
+    float policy(const size_t index) const {
+        assert(index < total_size());
+        return m_storage->policies[index];
+    }
+    int vertex(const size_t index) const {
+        assert(index < total_size());
+        return m_storage->vertices[index];
+    }
+
+    iterator begin() {
+        return iterator(m_storage.get(), 0);
+    }
+    iterator end() {
+        return iterator(m_storage.get(), size());
+    }
+    const_iterator begin() const {
+        return const_iterator(m_storage.get(), 0);
+    }
+    const_iterator end() const {
+        return const_iterator(m_storage.get(), size());
+    }
+    std::reverse_iterator<iterator> rbegin() {
+        return std::reverse_iterator<iterator>(end());
+    }
+    std::reverse_iterator<iterator> rend() {
+        return std::reverse_iterator<iterator>(begin());
+    }
+    UCTNodePointer& operator[](const size_t index) {
+        return m_storage->at(index);
+    }
+    const UCTNodePointer& operator[](const size_t index) const {
+        return m_storage->at(index);
+    }
+    const UCTNodePointer& front() const {
+        return m_storage->at(0);
+    }
+
+    // Replace the vertex of every child that isn't inflated by
+    // map(vertex).  Inflated children keep theirs in the UCTNode.
+    // Not thread-safe.
+    template <typename Map>
+    void map_vertices(Map map) {
+        if (!m_storage) {
+            return;
+        }
+        auto& storage = *m_storage;
+        for (auto i = size_t{storage.size}; i < storage.count; i++) {
+            storage.vertices[i] = std::int16_t(map(storage.vertices[i]));
+        }
+        for (auto i = size_t{0}; i < storage.size; i++) {
+            auto& child = storage.at(i);
+            const auto v = child.m_data.load();
+            if ((v & 3ULL) != UCTNodePointer::UNINFLATED) {
+                continue;
+            }
+            const auto vertex =
+                static_cast<std::uint16_t>(map(child.read_vertex(v)));
+            child.m_data = (v & ~(0xFFFFULL << 16))
+                           | (static_cast<std::uint64_t>(vertex) << 16);
+        }
+    }
+
+    // Add (policy, vertex) pairs after the other children, best first and
+    // with no more policy than any child that isn't materialized yet.
+    // Not thread-safe.
+    template <typename PairIterator>
+    void add(PairIterator first, const PairIterator last) {
+        const auto added = size_t(std::distance(first, last));
+        if (added == 0) {
+            return;
+        }
+        grow(added);
+        auto& storage = *m_storage;
+        for (; first != last; ++first) {
+            assert(storage.count == storage.size
+                   || storage.policies[storage.count - 1] >= first->first);
+            storage.vertices[storage.count] = std::int16_t(first->second);
+            storage.policies[storage.count] = first->first;
+            storage.count++;
+        }
+    }
+    // Materialize the children up to and including 'index'.  Thread-safe.
+    UCTNodePointer& materialize(size_t index);
+    void materialize_all();
+    // Remove the children from 'first' on, as left by std::remove_if().
+    // Only when all children are materialized, not thread-safe.
+    void erase(iterator first, iterator last);
+    void clear();
+};
+
 #endif
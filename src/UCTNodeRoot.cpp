@@ -89,9 +89,9 @@ void UCTNode::kill_superkos(const GameState& state) {
 
     // Now do the actual deletion.
     m_children.erase(
-        std::remove_if(begin(m_children), end(m_children),
+        std::remove_if(m_children.begin(), m_children.end(),
                        [](const auto& child) { return !child->valid(); }),
-        end(m_children));
+        m_children.end());
 }
 
 void UCTNode::dirichlet_noise(const float epsilon, const float alpha) {
@@ -163,7 +163,7 @@ void UCTNode::randomize_first_proportionally() {
     assert(m_children.size() > index);
 
     // Now swap the child at index with the first child
-    std::iter_swap(begin(m_children), begin(m_children) + index);
+    std::iter_swap(m_children.begin(), m_children.begin() + index);
 }
 
 UCTNode* UCTNode::get_nopass_child(FastState& state) const {
@@ -181,28 +181,155 @@ UCTNode* UCTNode::get_nopass_child(FastState& state) const {
 }
 
 // Used to find new root in UCTSearch.
-std::unique_ptr<UCTNode> UCTNode::find_child(const int move) {
-    for (auto& child : m_children) {
+// Finds the child that is 'move' seen through one of the symmetries of
+// 'state', 'move' itself first.  Sets 'symmetry' to the one that maps
+// the child's move to 'move'.
+static UCTNodePointer* find_equivalent_child(UCTNodeChildren& children,
+                                             const GameState& state,
+                                             const int move, int& symmetry) {
+    // The move may not have been worth a child yet.
+    children.materialize_all();
+    for (auto& child : children) {
         if (child.get_move() == move) {
-            // no guarantee that this is a non-inflated node
-            child.inflate();
-            return std::unique_ptr<UCTNode>(child.release());
+            symmetry = Network::IDENTITY_SYMMETRY;
+            return &child;
+        }
+    }
+    const auto symmetries = state.get_symmetries();
+    for (auto& child : children) {
+        for (const auto sym : symmetries) {
+            if (state.board.get_symmetric_vertex(child.get_move(), sym)
+                == move) {
+                symmetry = sym;
+                return &child;
+            }
         }
     }
-
-    // Can happen if we resigned or children are not expanded
     return nullptr;
 }
 
+std::unique_ptr<UCTNode> UCTNode::find_child(const GameState& state,
+                                             const int move) {
+    auto symmetry = Network::IDENTITY_SYMMETRY;
+    const auto child = find_equivalent_child(m_children, state, move,
+                                             symmetry);
+    if (!child) {
+        // Can happen if we resigned or children are not expanded
+        return nullptr;
+    }
+    // no guarantee that this is a non-inflated node
+    child->inflate();
+    auto node = std::unique_ptr<UCTNode>(child->release());
+    // Leave an unvisited stand-in, so this node stays a
+    // consistent tree that can be searched again later.
+    *child = UCTNodePointer(node->get_move(), node->get_policy());
+    replace_subtree_totals(node.get(), nullptr);
+    if (symmetry != Network::IDENTITY_SYMMETRY) {
+        node->m_move = move;
+        node->map_moves(state.board, symmetry);
+    }
+    return node;
+}
+
+bool UCTNode::restore_child(const GameState& state, const int move,
+                            std::unique_ptr<UCTNode>& child) {
+    auto symmetry = Network::IDENTITY_SYMMETRY;
+    const auto slot = find_equivalent_child(m_children, state, move,
+                                            symmetry);
+    if (!slot || slot->get_visits() >= child->get_visits()) {
+        return false;
+    }
+    // The slot's move is 'move' seen through 'symmetry', so the subtree
+    // needs the inverse.  Symmetries of a position come with their
+    // inverses, find it by where it takes 'move'.
+    const auto slot_move = slot->get_move();
+    if (symmetry != Network::IDENTITY_SYMMETRY) {
+        for (const auto sym : state.get_symmetries()) {
+            if (state.board.get_symmetric_vertex(move, sym) == slot_move) {
+                child->map_moves(state.board, sym);
+                break;
+            }
+        }
+    }
+    // The subtree may have been searched as a root of its own.
+    child->m_move = slot_move;
+    child->m_policy = slot->get_policy();
+    replace_subtree_totals(slot->is_inflated() ? slot->get() : nullptr,
+                           child.get());
+    *slot = UCTNodePointer(std::move(child));
+    return true;
+}
+
+void UCTNode::replace_subtree_totals(const UCTNode* const removed,
+                                     const UCTNode* const added) {
+    // Unsigned arithmetic wraps around, so the differences can be added
+    // even where they are negative.
+    auto visits = std::uint64_t{0};
+    auto evals = std::uint64_t{0};
+    auto squared_evals = std::uint64_t{0};
+    if (added) {
+        visits += added->get_visits();
+        evals += added->m_blackevals.load(std::memory_order_relaxed);
+        squared_evals += added->m_squared_evals.load(std::memory_order_relaxed);
+    }
+    if (removed) {
+        visits -= removed->get_visits();
+        evals -= removed->m_blackevals.load(std::memory_order_relaxed);
+        squared_evals -=
+            removed->m_squared_evals.load(std::memory_order_relaxed);
+    }
+    m_visits_and_vl.fetch_add(visits << VIRTUAL_LOSS_BITS,
+                              std::memory_order_relaxed);
+    m_blackevals.fetch_add(evals, std::memory_order_relaxed);
+    m_squared_evals.fetch_add(squared_evals, std::memory_order_relaxed);
+}
+
+void UCTNode::map_moves(const FullBoard& board, const int symmetry) {
+    const auto map = [&board, symmetry](const int vertex) {
+        return board.get_symmetric_vertex(vertex, symmetry);
+    };
+    m_children.map_vertices(map);
+    for (auto& child : m_children) {
+        if (child.is_inflated()) {
+            child->m_move = std::int16_t(map(child->m_move));
+            child->map_moves(board, symmetry);
+        }
+    }
+}
+
+bool UCTNode::add_child_visits(const int move, const std::int64_t visits,
+                               const float eval) {
+    auto slot = static_cast<UCTNodePointer*>(nullptr);
+    const auto materialized = m_children.size();
+    for (auto i = size_t{0}; i < materialized && !slot; i++) {
+        if (m_children[i].get_move() == move) {
+            slot = &m_children[i];
+        }
+    }
+    for (auto i = materialized; i < m_children.total_size() && !slot; i++) {
+        if (m_children.vertex(i) == move) {
+            slot = &m_children.materialize(i);
+        }
+    }
+    if (!slot) {
+        return false;
+    }
+    slot->inflate();
+    (*slot)->add_visits(visits, eval);
+    add_visits(visits, eval);
+    return true;
+}
+
 void UCTNode::inflate_all_children() {
+    m_children.materialize_all();
     for (const auto& node : get_children()) {
         node.inflate();
     }
 }
 
 void UCTNode::prepare_root_node(Network& network, const int color,
-                                std::atomic<int>& nodes,
-                                GameState& root_state) {
+                                std::atomic<std::int64_t>& nodes,
+                                GameState& root_state, const bool add_noise) {
     float root_eval;
     const auto had_children = has_children();
     if (expandable()) {
@@ -223,9 +350,10 @@ void UCTNode::prepare_root_node(Network& network, const int color,
     // This also removes a lot of special cases.
     kill_superkos(root_state);
 
-    if (cfg_noise) {
+    if (add_noise) {
         // Adjust the Dirichlet noise's alpha constant to the board size
-        auto alpha = 0.03f * 361.0f / NUM_INTERSECTIONS;
+        const auto board_size = root_state.board.get_boardsize();
+        auto alpha = 0.03f * 361.0f / (board_size * board_size);
         dirichlet_noise(0.25f, alpha);
     }
 }
@@ -35,10 +35,15 @@
 #include <cassert>
 #include <cmath>
 #include <cstddef>
+#include <fstream>
 #include <functional>
 #include <limits>
 #include <memory>
+#include <numeric>
+#include <random>
+#include <stdexcept>
 #include <type_traits>
+#include <vector>
 
 #include "UCTSearch.h"
 
@@ -47,6 +52,7 @@
 #include "FullBoard.h"
 #include "GTP.h"
 #include "GameState.h"
+#include "Random.h"
 #include "TimeControl.h"
 #include "Timing.h"
 #include "Training.h"
@@ -57,12 +63,77 @@
 
 using namespace Utils;
 
-constexpr int UCTSearch::UNLIMITED_PLAYOUTS;
+constexpr std::int64_t UCTSearch::UNLIMITED_PLAYOUTS;
+constexpr float UCTSearch::EVICT_THRESHOLD;
+constexpr float UCTSearch::EVICT_TARGET;
+constexpr int UCTSearch::CONVERGE_INTERVAL;
+constexpr int UCTSearch::RATE_PRIOR_CENTIS;
+constexpr size_t UCTSearch::MAX_STASHED_TREES;
+constexpr float UCTSearch::STASH_SHARE;
+constexpr int PlayoutRateModel::NUM_PHASES;
+constexpr int PlayoutRateModel::NUM_REUSE_BUCKETS;
+constexpr float PlayoutRateModel::DECAY;
+
+int PlayoutRateModel::get_phase(const int boardsize, const size_t movenum) {
+    const auto num_intersections = size_t(boardsize * boardsize);
+    if (movenum < num_intersections / 6) {
+        return 0;
+    } else if (movenum < num_intersections / 2) {
+        return 1;
+    }
+    return 2;
+}
+
+int PlayoutRateModel::get_reuse_bucket(const float reuse) {
+    const auto bucket = static_cast<int>(reuse * NUM_REUSE_BUCKETS);
+    return std::max(0, std::min(bucket, NUM_REUSE_BUCKETS - 1));
+}
+
+void PlayoutRateModel::update(const int boardsize, const size_t movenum,
+                              const float reuse, const std::int64_t playouts,
+                              const int centis) {
+    if (playouts <= 0 || centis <= 0) {
+        return;
+    }
+    // Longer searches give more reliable rates, so weigh by duration.
+    auto& bucket =
+        m_buckets[get_phase(boardsize, movenum)][get_reuse_bucket(reuse)];
+    const auto old_weight = bucket.weight * DECAY;
+    bucket.weight = old_weight + centis;
+    bucket.rate = (bucket.rate * old_weight + playouts) / bucket.weight;
+}
+
+float PlayoutRateModel::get_rate(const int boardsize, const size_t movenum,
+                                 const float reuse) const {
+    const auto& phase = m_buckets[get_phase(boardsize, movenum)];
+    const auto& bucket = phase[get_reuse_bucket(reuse)];
+    if (bucket.weight > 0.0f) {
+        return bucket.rate;
+    }
+    // Nothing for this amount of reuse yet, fall back to the
+    // rest of the phase, then to the whole game.
+    auto rate = 0.0f;
+    auto weight = 0.0f;
+    for (const auto& other : phase) {
+        rate += other.rate * other.weight;
+        weight += other.weight;
+    }
+    if (weight == 0.0f) {
+        for (const auto& buckets : m_buckets) {
+            for (const auto& other : buckets) {
+                rate += other.rate * other.weight;
+                weight += other.weight;
+            }
+        }
+    }
+    return weight > 0.0f ? rate / weight : 0.0f;
+}
 
 class OutputAnalysisData {
 public:
-    OutputAnalysisData(std::string move, const int visits, const float winrate,
-                       const float policy_prior, std::string pv,
+    OutputAnalysisData(std::string move, const std::int64_t visits,
+                       const float winrate, const float policy_prior,
+                       std::string pv,
                        const float lcb, const bool lcb_ratio_exceeded)
         : m_move(std::move(move)),
           m_visits(visits),
@@ -104,7 +175,7 @@ public:
 
 private:
     std::string m_move;
-    int m_visits;
+    std::int64_t m_visits;
     float m_winrate;
     float m_policy_prior;
     std::string m_pv;
@@ -120,6 +191,18 @@ UCTSearch::UCTSearch(GameState& g, Network& network)
     m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
 }
 
+UCTSearch::~UCTSearch() {
+    // The deletion tasks update our node count.
+    wait_for_deletions();
+}
+
+void UCTSearch::wait_for_deletions() {
+    while (!m_delete_futures.empty()) {
+        m_delete_futures.front().wait_all();
+        m_delete_futures.pop_front();
+    }
+}
+
 bool UCTSearch::advance_to_new_rootstate() {
     if (!m_root || !m_last_rootstate) {
         // No current state
@@ -149,10 +232,7 @@ bool UCTSearch::advance_to_new_rootstate() {
 
     // Make sure that the nodes we destroyed the previous move are
     // in fact destroyed.
-    while (!m_delete_futures.empty()) {
-        m_delete_futures.front().wait_all();
-        m_delete_futures.pop_front();
-    }
+    wait_for_deletions();
 
     // Try to replay moves advancing m_root
     for (auto i = 0; i < depth; i++) {
@@ -162,15 +242,16 @@ bool UCTSearch::advance_to_new_rootstate() {
         const auto move = test->get_last_move();
 
         auto oldroot = std::move(m_root);
-        m_root = oldroot->find_child(move);
-
-        // Lazy tree destruction.  Instead of calling the destructor of the
-        // old root node on the main thread, send the old root to a separate
-        // thread and destroy it from the child thread.  This will save a
-        // bit of time when dealing with large trees.
-        auto p = oldroot.release();
-        tg.add_task([p]() { delete p; });
+        m_root = oldroot->find_child(*m_last_rootstate, move);
+
+        // The rest of the old tree is kept, in case the game is taken
+        // back to it.  It no longer counts towards our nodes, which are
+        // counted on a separate thread, so that we don't need to walk
+        // the tree on the main thread.
+        auto p = oldroot.get();
+        tg.add_task([this, p]() { m_nodes -= p->count_nodes(); });
         m_delete_futures.push_back(std::move(tg));
+        stash_tree(std::move(oldroot), *m_last_rootstate);
 
         if (!m_root) {
             // Tree hasn't been expanded this far
@@ -189,28 +270,165 @@ bool UCTSearch::advance_to_new_rootstate() {
     return true;
 }
 
+// Whether the network sees the same inputs in both positions, so that a
+// search tree for one is valid for the other.
+static bool same_position(const GameState& a, const GameState& b) {
+    if (a.board.get_hash() != b.board.get_hash()
+        || a.get_komi() != b.get_komi()
+        || a.get_movenum() != b.get_movenum()) {
+        return false;
+    }
+    const auto past_boards =
+        std::min(a.get_movenum(), GameState::HISTORY_BOARDS - 1);
+    for (auto i = size_t{1}; i <= past_boards; i++) {
+        if (!(a.get_past_board(i) == b.get_past_board(i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void UCTSearch::stash_tree(std::unique_ptr<UCTNode> root,
+                           const GameState& state) {
+    if (root->get_visits() == 0) {
+        // Nothing worth keeping, but it may still be counted on another
+        // thread.
+        wait_for_deletions();
+        return;
+    }
+    // Only one tree per position, the one we searched last.
+    const auto it =
+        std::find_if(begin(m_stashed_trees), end(m_stashed_trees),
+                     [&state](const StashedTree& stashed) {
+                         return same_position(*stashed.state, state);
+                     });
+    if (it != end(m_stashed_trees)) {
+        take_stashed(it);
+    }
+    m_stashed_trees.push_front(
+        StashedTree{std::make_unique<GameState>(state), std::move(root)});
+
+    // The search doesn't count the stash against its memory.  Measure it
+    // on another thread, like the node count, and have everything that
+    // takes a tree out of the stash wait for that.
+    auto& stashed = m_stashed_trees.front();
+    ThreadGroup tg(thread_pool);
+    tg.add_task([this, &stashed]() {
+        stashed.memory = stashed.root->get_tree_memory();
+        m_stash_size += stashed.memory;
+    });
+    m_delete_futures.push_back(std::move(tg));
+}
+
+std::unique_ptr<UCTNode> UCTSearch::take_stashed(
+    const std::list<StashedTree>::iterator it) {
+    // It may still be measured or counted on another thread.
+    wait_for_deletions();
+    m_stash_size -= it->memory;
+    auto root = std::move(it->root);
+    m_stashed_trees.erase(it);
+    return root;
+}
+
+std::unique_ptr<UCTNode> UCTSearch::unstash_tree(const GameState& state) {
+    const auto it =
+        std::find_if(begin(m_stashed_trees), end(m_stashed_trees),
+                     [&state](const StashedTree& stashed) {
+                         return same_position(*stashed.state, state);
+                     });
+    if (it == end(m_stashed_trees)) {
+        return nullptr;
+    }
+    auto root = take_stashed(it);
+    restore_stashed_children(*root, state);
+    return root;
+}
+
+// Put stashed trees of positions one move after 'state' back into the
+// tree of 'state', so that stepping back keeps what was searched after.
+void UCTSearch::restore_stashed_children(UCTNode& node,
+                                         const GameState& state) {
+    auto it = begin(m_stashed_trees);
+    while (it != end(m_stashed_trees)) {
+        auto parent = *it->state;
+        if (parent.get_movenum() != state.get_movenum() + 1
+            || !parent.undo_move() || !same_position(parent, state)) {
+            ++it;
+            continue;
+        }
+        const auto child_state = std::move(it->state);
+        auto child = take_stashed(it);
+        restore_stashed_children(*child, *child_state);
+        node.restore_child(state, child_state->get_last_move(), child);
+        // The list may have changed below us.
+        it = begin(m_stashed_trees);
+    }
+}
+
+void UCTSearch::trim_stashed_trees() {
+    // The stash gets its own share of the memory, and gives it up when
+    // the live tree needs it.
+    const auto max_size = STASH_SHARE * cfg_max_tree_size;
+    while (!m_stashed_trees.empty()
+           && (m_stashed_trees.size() > MAX_STASHED_TREES
+               || m_stash_size > max_size
+               || UCTNodePointer::get_tree_size() > cfg_max_tree_size)) {
+        take_stashed(std::prev(end(m_stashed_trees)));
+    }
+}
+
+size_t UCTSearch::get_search_tree_size() const {
+    const auto size = UCTNodePointer::get_tree_size();
+    const auto stashed = m_stash_size.load();
+    return size > stashed ? size - stashed : 0;
+}
+
 void UCTSearch::update_root() {
     // Definition of m_playouts is playouts per search call.
     // So reset this count now.
     m_playouts = 0;
 
 #ifndef NDEBUG
-    auto start_nodes = m_root->count_nodes_and_clear_expand_state();
+    auto start_nodes = m_nodes.load();
 #endif
 
     if (!advance_to_new_rootstate() || !m_root) {
-        m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+        // The deletion tasks subtract from the node count, so let them
+        // finish before starting to count again.
+        wait_for_deletions();
+        // Navigating away from the position, maybe to one we searched
+        // before.
+        if (m_root && m_last_rootstate) {
+            stash_tree(std::move(m_root), *m_last_rootstate);
+        }
+        m_root = unstash_tree(m_rootstate);
+        if (m_root) {
+            // The tree may have been pruned while it was searched.
+            m_nodes = std::int64_t(m_root->count_nodes_and_clear_expand_state());
+        } else {
+            m_root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+            m_nodes = 0;
+        }
+        m_tree_pruned = false;
     }
     // Clear last_rootstate to prevent accidental use.
     m_last_rootstate.reset(nullptr);
-
-    // Check how big our search tree (reused or new) is.
-    m_nodes = m_root->count_nodes_and_clear_expand_state();
+    trim_stashed_trees();
+
+    // Nodes that were only partially expanded because memory was short
+    // must become expandable again.  This needs a walk over the whole
+    // tree, so only do it if it can matter.
+    if (m_tree_pruned) {
+        m_root->count_nodes_and_clear_expand_state();
+        m_tree_pruned = false;
+    }
 
 #ifndef NDEBUG
+    wait_for_deletions();
     if (m_nodes > 0) {
-        myprintf("update_root, %d -> %d nodes (%.1f%% reused)\n",
-                 start_nodes, m_nodes.load(),
+        myprintf("update_root, %lld -> %lld nodes (%.1f%% reused)\n",
+                 static_cast<long long>(start_nodes),
+                 static_cast<long long>(m_nodes.load()),
                  100.0 * m_nodes.load() / start_nodes);
     }
 #endif
@@ -218,14 +436,15 @@ void UCTSearch::update_root() {
 
 float UCTSearch::get_min_psa_ratio() const {
     const auto mem_full =
-        UCTNodePointer::get_tree_size() / static_cast<float>(cfg_max_tree_size);
+        get_search_tree_size() / static_cast<float>(cfg_max_tree_size);
     // If we are halfway through our memory budget, start trimming
     // moves with very low policy priors.
     if (mem_full > 0.5f) {
         // Memory is almost exhausted, trim more aggressively.
         if (mem_full > 0.95f) {
-            // if completely full just stop expansion by returning an impossible number
-            if (mem_full >= 1.0f) {
+            // if completely full just stop expansion by returning an
+            // impossible number, unless eviction is going to make room.
+            if (mem_full >= 1.0f && !cfg_tree_eviction) {
                 return 2.0f;
             }
             return 0.01f;
@@ -235,40 +454,171 @@ float UCTSearch::get_min_psa_ratio() const {
     return 0.0f;
 }
 
+struct EvictionCandidate {
+    UCTNode* node;
+    std::int64_t visits;
+    int depth;
+};
+
+// Collect all expanded nodes, except the ones on the principal variation
+// of each root move.  Those are the lines the search keeps coming back to.
+static void collect_eviction_candidates(
+    const UCTNode& node, const int depth, const bool on_pv,
+    std::vector<EvictionCandidate>& candidates) {
+
+    auto pv_child = static_cast<const UCTNode*>(nullptr);
+    if (on_pv) {
+        auto max_visits = std::int64_t{0};
+        for (const auto& child : node.get_children()) {
+            if (child.is_inflated() && child->get_visits() > max_visits) {
+                max_visits = child->get_visits();
+                pv_child = child.get();
+            }
+        }
+    }
+
+    for (const auto& child : node.get_children()) {
+        if (!child.is_inflated() || !child->has_children()) {
+            continue;
+        }
+        const auto child_on_pv = depth == 0 || child.get() == pv_child;
+        if (!child_on_pv) {
+            candidates.push_back({child.get(), child->get_visits(), depth + 1});
+        }
+        collect_eviction_candidates(*child, depth + 1, child_on_pv,
+                                    candidates);
+    }
+}
+
+void UCTSearch::evict_cold_subtrees(const size_t target_size) {
+    auto candidates = std::vector<EvictionCandidate>{};
+    collect_eviction_candidates(*m_root, 0, true, candidates);
+
+    // Least visited first, and deeper first among equals.  A node never has
+    // more visits than its parent, so children are always evicted before
+    // their parents and we never touch a node that was already freed.
+    std::sort(begin(candidates), end(candidates),
+              [](const EvictionCandidate& a, const EvictionCandidate& b) {
+                  if (a.visits != b.visits) {
+                      return a.visits < b.visits;
+                  }
+                  return a.depth > b.depth;
+              });
+
+    auto evicted = size_t{0};
+    for (const auto& candidate : candidates) {
+        if (get_search_tree_size() <= target_size) {
+            break;
+        }
+        // The nodes stay expandable, and the network evaluations needed
+        // to expand them again are likely to still be in the NNCache.
+        m_nodes -= candidate.node->clear_children();
+        evicted++;
+    }
+
+    myprintf("Evicted %zu subtrees, tree size now %zu MiB.\n", evicted,
+             get_search_tree_size() / (1024 * 1024));
+}
+
+void UCTSearch::evict_if_full(ThreadGroup& tg) {
+    const auto threshold = EVICT_THRESHOLD * cfg_max_tree_size;
+    if (!cfg_tree_eviction || get_search_tree_size() < threshold) {
+        return;
+    }
+
+    // The workers walk the tree without locks, so stop them while we evict
+    // and start them again afterwards.
+    m_run = false;
+    m_network.drain_evals();
+    tg.wait_all();
+    m_network.resume_evals();
+
+    evict_cold_subtrees(EVICT_TARGET * cfg_max_tree_size);
+
+    m_run = true;
+    start_workers(tg);
+}
+
+void UCTSearch::start_workers(Utils::ThreadGroup& tg) {
+    // One worker per pool thread.  With --numa each worker must stay on
+    // the node its thread is bound to, so it is pinned there rather than
+    // left for another thread to steal.
+    for (auto i = size_t{0}; i < cfg_num_threads; i++) {
+        if (cfg_numa) {
+            tg.add_pinned_task(i, UCTWorker(m_rootstate, this, m_root.get()));
+        } else {
+            tg.add_task_on(i, UCTWorker(m_rootstate, this, m_root.get()));
+        }
+    }
+}
+
 SearchResult UCTSearch::play_simulation(GameState& currstate,
                                         UCTNode* const node) {
     const auto color = currstate.get_to_move();
     auto result = SearchResult{};
     auto new_node = false;
 
-    node->virtual_loss();
+    const auto is_root = node == m_root.get();
+
+    // Virtual loss steers other threads towards the siblings of a node.
+    // The root has no siblings, and is the node every thread passes
+    // through, so don't bother there.
+    const auto use_virtual_loss = !is_root;
+    if (use_virtual_loss) {
+        node->virtual_loss();
+    }
 
     // This will undo virtual loss even if something throws an exception.
-    BOOST_SCOPE_EXIT(node) {
-        node->virtual_loss_undo();
+    BOOST_SCOPE_EXIT(node, use_virtual_loss) {
+        if (use_virtual_loss) {
+            node->virtual_loss_undo();
+        }
     } BOOST_SCOPE_EXIT_END
 
-    if (node->expandable()) {
-        if (currstate.get_passes() >= 2) {
-            auto score = currstate.final_score();
+    // Proven nodes already have their exact result.  The root keeps
+    // searching so that the proving move collects the visits.
+    if (!is_root && node->get_proven() != UCTNode::Proven::UNKNOWN) {
+        result = SearchResult::from_eval(node->get_proven_eval());
+    } else if (node->expandable()) {
+        // Once both sides are pass-alive everywhere the result can't
+        // change anymore either, without needing to play it out.
+        auto score = 0.0f;
+        auto game_over = currstate.get_passes() >= 2;
+        if (game_over) {
+            score = currstate.final_score();
+        } else {
+            game_over = currstate.board.calc_settled_score(
+                currstate.get_komi() + currstate.get_handicap(), score);
+        }
+        if (game_over) {
             result = SearchResult::from_score(score);
+            node->set_proven(score > 0.0f   ? UCTNode::Proven::BLACK_WINS
+                             : score < 0.0f ? UCTNode::Proven::WHITE_WINS
+                                            : UCTNode::Proven::DRAW);
         } else {
             float eval;
             const auto had_children = node->has_children();
+            const auto had_visits = !node->first_visit();
+            const auto min_psa_ratio = get_min_psa_ratio();
+            if (min_psa_ratio > 0.0f && !m_tree_pruned) {
+                m_tree_pruned = true;
+            }
 
             // Careful: create_children() can throw a NetworkHaltException when
             // another thread requests draining the search.
             const auto success = node->create_children(
-                m_network, m_nodes, currstate, eval, get_min_psa_ratio());
+                m_network, m_nodes, currstate, eval, min_psa_ratio);
             if (!had_children && success) {
                 result = SearchResult::from_eval(eval);
-                new_node = true;
+                // create_children() only updates a node on its first visit,
+                // evicted nodes that get expanded again still need it.
+                new_node = !had_visits;
             }
         }
     }
 
     if (node->has_children() && !result.valid()) {
-        auto next = node->uct_select_child(color, node == m_root.get());
+        auto next = node->uct_select_child(color, is_root);
         auto move = next->get_move();
 
         currstate.play_move(move);
@@ -276,6 +626,9 @@ SearchResult UCTSearch::play_simulation(GameState& currstate,
             next->invalidate();
         } else {
             result = play_simulation(currstate, next);
+            if (next->get_proven() != UCTNode::Proven::UNKNOWN) {
+                node->update_proven(color);
+            }
         }
     }
 
@@ -287,14 +640,14 @@ SearchResult UCTSearch::play_simulation(GameState& currstate,
     return result;
 }
 
-void UCTSearch::dump_stats(const FastState& state, UCTNode& parent) {
+void UCTSearch::dump_stats(const GameState& state, UCTNode& parent) {
     if (cfg_quiet || !parent.has_children()) {
         return;
     }
 
     const int color = state.get_to_move();
 
-    auto max_visits = 0;
+    auto max_visits = std::int64_t{0};
     for (const auto& node : parent.get_children()) {
         max_visits = std::max(max_visits, node->get_visits());
     }
@@ -306,27 +659,37 @@ void UCTSearch::dump_stats(const FastState& state, UCTNode& parent) {
         return;
     }
 
+    const auto symmetries = state.get_symmetries();
     int movecount = 0;
     for (const auto& node : parent.get_children()) {
         // Always display at least two moves. In the case there is
         // only one move searched the user could get an idea why.
-        if (++movecount > 2 && !node->get_visits()) break;
-
-        auto move = state.move_to_text(node->get_move());
-        auto tmpstate = FastState{state};
-        tmpstate.play_move(node->get_move());
-        auto pv = move + " " + get_pv(tmpstate, *node);
+        if (movecount >= 2 && !node->get_visits()) break;
 
-        myprintf("%4s -> %7d (V: %5.2f%%) (LCB: %5.2f%%) (N: %5.2f%%) PV: %s\n",
-                 move.c_str(), node->get_visits(),
-                 node->get_visits() ? node->get_raw_eval(color) * 100.0f : 0.0f,
-                 std::max(0.0f, node->get_eval_lcb(color) * 100.0f),
-                 node->get_policy() * 100.0f, pv.c_str());
+        const auto equivalents = state.board.expand_equivalent_move(
+            node->get_move(), node->get_visits(), symmetries);
+        for (const auto& equivalent : equivalents) {
+            if (++movecount > 2 && !equivalent.visits) {
+                continue;
+            }
+            auto move = state.move_to_text(equivalent.vertex);
+            auto tmpstate = FastState{state};
+            tmpstate.play_move(equivalent.vertex);
+            auto pv = move + " "
+                      + get_pv(tmpstate, *node, equivalent.symmetry);
+
+            myprintf(
+                "%4s -> %7lld (V: %5.2f%%) (LCB: %5.2f%%) (N: %5.2f%%) PV: %s\n",
+                move.c_str(), static_cast<long long>(equivalent.visits),
+                node->get_visits() ? node->get_raw_eval(color) * 100.0f : 0.0f,
+                std::max(0.0f, node->get_eval_lcb(color) * 100.0f),
+                node->get_policy() * 100.0f / equivalents.size(), pv.c_str());
+        }
     }
     tree_stats(parent);
 }
 
-void UCTSearch::output_analysis(const FastState& state, const UCTNode& parent) {
+void UCTSearch::output_analysis(const GameState& state, const UCTNode& parent) {
     // We need to make a copy of the data before sorting
     auto sortable_data = std::vector<OutputAnalysisData>();
 
@@ -336,11 +699,12 @@ void UCTSearch::output_analysis(const FastState& state, const UCTNode& parent) {
 
     const auto color = state.get_to_move();
 
-    auto max_visits = 0;
+    auto max_visits = std::int64_t{0};
     for (const auto& node : parent.get_children()) {
         max_visits = std::max(max_visits, node->get_visits());
     }
 
+    const auto symmetries = state.get_symmetries();
     for (const auto& node : parent.get_children()) {
         // Send only variations with visits, unless more moves were
         // requested explicitly.
@@ -348,21 +712,31 @@ void UCTSearch::output_analysis(const FastState& state, const UCTNode& parent) {
             && sortable_data.size() >= cfg_analyze_tags.post_move_count()) {
             continue;
         }
-        auto move = state.move_to_text(node->get_move());
-        auto tmpstate = FastState{state};
-        tmpstate.play_move(node->get_move());
-        auto rest_of_pv = get_pv(tmpstate, *node);
-        auto pv = move + (rest_of_pv.empty() ? "" : " " + rest_of_pv);
         auto move_eval = node->get_visits() ? node->get_raw_eval(color) : 0.0f;
-        auto policy = node->get_policy();
         auto lcb = node->get_eval_lcb(color);
         auto visits = node->get_visits();
         // Need at least 2 visits for valid LCB.
         auto lcb_ratio_exceeded =
             visits > 2 && visits > max_visits * cfg_lcb_min_visit_ratio;
-        // Store data in array
-        sortable_data.emplace_back(move, visits, move_eval, policy, pv, lcb,
-                                   lcb_ratio_exceeded);
+        const auto equivalents =
+            state.board.expand_equivalent_move(node->get_move(), visits,
+                                               symmetries);
+        for (const auto& equivalent : equivalents) {
+            // The same holds for each of the equivalent moves.
+            if (!equivalent.visits
+                && sortable_data.size() >= cfg_analyze_tags.post_move_count()) {
+                continue;
+            }
+            auto move = state.move_to_text(equivalent.vertex);
+            auto tmpstate = FastState{state};
+            tmpstate.play_move(equivalent.vertex);
+            auto rest_of_pv = get_pv(tmpstate, *node, equivalent.symmetry);
+            auto pv = move + (rest_of_pv.empty() ? "" : " " + rest_of_pv);
+            auto policy = node->get_policy() / equivalents.size();
+            // Store data in array
+            sortable_data.emplace_back(move, equivalent.visits, move_eval,
+                                       policy, pv, lcb, lcb_ratio_exceeded);
+        }
     }
     // Sort array to decide order
     std::stable_sort(rbegin(sortable_data), rend(sortable_data));
@@ -472,7 +846,7 @@ bool UCTSearch::should_resign(const passflag_t passflag, const float besteval) {
 int UCTSearch::get_best_move(const passflag_t passflag) {
     int color = m_rootstate.board.get_to_move();
 
-    auto max_visits = 0;
+    auto max_visits = std::int64_t{0};
     for (const auto& node : m_root->get_children()) {
         max_visits = std::max(max_visits, node->get_visits());
     }
@@ -599,10 +973,23 @@ int UCTSearch::get_best_move(const passflag_t passflag) {
         }
     }
 
+    // The child stands for all moves equivalent to it, play any of them
+    // so that games don't always take the same orientation.
+    if (bestmove != FastBoard::PASS && bestmove != FastBoard::RESIGN) {
+        const auto equivalents = m_rootstate.board.get_equivalent_vertices(
+            bestmove, m_rootstate.get_symmetries());
+        if (equivalents.size() > 1) {
+            auto pick = std::uniform_int_distribution<size_t>{
+                0, equivalents.size() - 1};
+            bestmove = equivalents[pick(Random::get_Rng())].first;
+        }
+    }
+
     return bestmove;
 }
 
-std::string UCTSearch::get_pv(FastState& state, const UCTNode& parent) {
+std::string UCTSearch::get_pv(FastState& state, const UCTNode& parent,
+                              const int symmetry) {
     if (!parent.has_children()) {
         return std::string();
     }
@@ -619,55 +1006,71 @@ std::string UCTSearch::get_pv(FastState& state, const UCTNode& parent) {
     if (best_child.first_visit()) {
         return std::string();
     }
-    auto best_move = best_child.get_move();
+    // Follow the line the tree holds, seen through 'symmetry'.
+    auto best_move =
+        state.board.get_symmetric_vertex(best_child.get_move(), symmetry);
     auto res = state.move_to_text(best_move);
 
     state.play_move(best_move);
 
-    auto next = get_pv(state, best_child);
+    auto next = get_pv(state, best_child, symmetry);
     if (!next.empty()) {
         res.append(" ").append(next);
     }
     return res;
 }
 
-std::string UCTSearch::get_analysis(const int playouts) {
+std::string UCTSearch::get_analysis(const std::int64_t playouts) {
     FastState tempstate = m_rootstate;
     int color = tempstate.board.get_to_move();
 
     auto pvstring = get_pv(tempstate, *m_root);
     float winrate = 100.0f * m_root->get_raw_eval(color);
-    return str(boost::format("Playouts: %d, Win: %5.2f%%, PV: %s")
-               % playouts % winrate % pvstring.c_str());
+    return str(boost::format("Playouts: %lld, Win: %5.2f%%, PV: %s")
+               % static_cast<long long>(playouts) % winrate % pvstring.c_str());
 }
 
 bool UCTSearch::is_running() const {
-    return m_run && UCTNodePointer::get_tree_size() < cfg_max_tree_size;
+    // The workers check the limits too, instead of playing on
+    // until the search loop next looks at them.
+    return m_run && m_playouts < m_maxplayouts
+           && m_root->get_visits() < visit_limit()
+           && (cfg_tree_eviction
+               || get_search_tree_size() < cfg_max_tree_size);
 }
 
-int UCTSearch::est_playouts_left(const int elapsed_centis,
-                                 const int time_for_move) const {
+std::int64_t UCTSearch::est_playouts_left(const int elapsed_centis,
+                                          const int time_for_move) const {
     auto playouts = m_playouts.load();
     const auto playouts_left =
-        std::max(0, std::min(m_maxplayouts - playouts,
-                             m_maxvisits - m_root->get_visits()));
-
-    // Wait for at least 1 second and 100 playouts
-    // so we get a reliable playout_rate.
-    if (elapsed_centis < 100 || playouts < 100) {
-        return playouts_left;
+        std::max(std::int64_t{0},
+                 std::min(m_maxplayouts - playouts,
+                          visit_limit() - m_root->get_visits()));
+
+    auto playout_rate = 0.0f;
+    if (m_prior_rate > 0.0f) {
+        // Start from what earlier searches managed and let
+        // the rate of this one take over as it runs.
+        playout_rate = (m_prior_rate * RATE_PRIOR_CENTIS + playouts)
+                       / (RATE_PRIOR_CENTIS + elapsed_centis);
+    } else {
+        // Wait for at least 1 second and 100 playouts
+        // so we get a reliable playout_rate.
+        if (elapsed_centis < 100 || playouts < 100) {
+            return playouts_left;
+        }
+        playout_rate = 1.0f * playouts / elapsed_centis;
     }
-    const auto playout_rate = 1.0f * playouts / elapsed_centis;
     const auto time_left = std::max(0, time_for_move - elapsed_centis);
-    return std::min(playouts_left,
-                    static_cast<int>(std::ceil(playout_rate * time_left)));
+    return std::min(playouts_left, static_cast<std::int64_t>(
+                                       std::ceil(playout_rate * time_left)));
 }
 
 size_t UCTSearch::prune_noncontenders(const int color, const int elapsed_centis,
                                       const int time_for_move,
                                       const bool prune) {
     auto lcb_max = 0.0f;
-    auto Nfirst = 0;
+    auto Nfirst = std::int64_t{0};
     // There are no cases where the root's children vector gets modified
     // during a multithreaded search, so it is safe to walk it here without
     // taking the (root) node lock.
@@ -719,17 +1122,8 @@ bool UCTSearch::have_alternate_moves(const int elapsed_centis,
     if (pruned < m_root->get_children().size() - 1) {
         return true;
     }
-    // If we cannot save up time anyway, use all of it. This
-    // behavior can be overruled by setting "fast" time management,
-    // which will cause Leela to quickly respond to obvious/forced moves.
-    // That comes at the cost of some playing strength as she now cannot
-    // think ahead about her next moves in the remaining time.
-    auto tc = m_rootstate.get_timecontrol();
-    if (!tc.can_accumulate_time(my_color)
-        || m_maxplayouts < UCTSearch::UNLIMITED_PLAYOUTS) {
-        if (cfg_timemanage != TimeManagement::FAST) {
-            return true;
-        }
+    if (!can_save_time()) {
+        return true;
     }
     // In a timed search we will essentially always exit because
     // the remaining time is too short to let another move win, so
@@ -742,17 +1136,86 @@ bool UCTSearch::have_alternate_moves(const int elapsed_centis,
     return false;
 }
 
+bool UCTSearch::can_save_time() const {
+    // If we cannot save up time anyway, use all of it. This
+    // behavior can be overruled by setting "fast" time management,
+    // which will cause Leela to quickly respond to obvious/forced moves.
+    // That comes at the cost of some playing strength as she now cannot
+    // think ahead about her next moves in the remaining time.
+    if (cfg_timemanage == TimeManagement::FAST) {
+        return true;
+    }
+    const auto& tc = m_rootstate.get_timecontrol();
+    return tc.can_accumulate_time(m_rootstate.get_to_move())
+           && m_maxplayouts >= UCTSearch::UNLIMITED_PLAYOUTS;
+}
+
+double UCTSearch::visit_divergence(
+    const std::vector<std::int64_t>& old_visits,
+    const std::vector<std::int64_t>& new_visits) {
+    assert(old_visits.size() == new_visits.size());
+    const auto old_total = std::accumulate(begin(old_visits), end(old_visits),
+                                           std::int64_t{0});
+    const auto new_total = std::accumulate(begin(new_visits), end(new_visits),
+                                           std::int64_t{0});
+    if (old_total == 0 || new_total <= old_total) {
+        return 0.0;
+    }
+
+    // KL(old || new) is finite, as visits only ever grow.
+    auto divergence = 0.0;
+    for (size_t i = 0; i < old_visits.size(); i++) {
+        if (old_visits[i] > 0) {
+            const auto p_old = old_visits[i] / double(old_total);
+            const auto p_new = new_visits[i] / double(new_total);
+            divergence += p_old * std::log(p_old / p_new);
+        }
+    }
+    return divergence / (new_total - old_total);
+}
+
+bool UCTSearch::visits_converged() {
+    if (cfg_timemanage != TimeManagement::CONVERGE || !can_save_time()
+        || m_playouts < m_converge_playouts + CONVERGE_INTERVAL) {
+        return false;
+    }
+
+    auto visits = std::vector<std::int64_t>{};
+    for (const auto& child : m_root->get_children()) {
+        visits.emplace_back(child->get_visits());
+    }
+    const auto first_sample =
+        m_converge_visits.size() != visits.size()
+        || std::accumulate(begin(m_converge_visits), end(m_converge_visits),
+                           std::int64_t{0}) == 0;
+    const auto divergence =
+        first_sample ? 0.0 : visit_divergence(m_converge_visits, visits);
+
+    m_converge_visits = std::move(visits);
+    m_converge_playouts = m_playouts;
+    if (first_sample || divergence >= cfg_kl_threshold) {
+        return false;
+    }
+    myprintf("Visits converged after %lld playouts, stopping early.\n",
+             static_cast<long long>(m_playouts.load()));
+    return true;
+}
+
 bool UCTSearch::stop_thinking(const int elapsed_centis,
                               const int time_for_move) const {
-    return m_playouts >= m_maxplayouts || m_root->get_visits() >= m_maxvisits
+    return m_playouts >= m_maxplayouts || m_root->get_visits() >= visit_limit()
            || elapsed_centis >= time_for_move;
 }
 
 void UCTWorker::operator()() {
     try {
+        // Copy the root position once, and take the moves of each
+        // playout back afterwards instead of copying it again.
+        auto currstate = std::make_unique<GameState>(m_rootstate);
+        currstate->set_unmake_point();
         do {
-            auto currstate = std::make_unique<GameState>(m_rootstate);
             auto result = m_search->play_simulation(*currstate, m_root);
+            currstate->unmake_moves();
             if (result.valid()) {
                 m_search->increment_playouts();
             }
@@ -777,21 +1240,63 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
     // set side to move
     m_rootstate.board.set_to_move(color);
 
+    const auto bookmove = get_book_move(passflag);
+    if (bookmove != FastBoard::NO_VERTEX) {
+        m_rootstate.stop_clock(color);
+        m_think_output =
+            str(boost::format("move %d, %c => %s (book)\n")
+                % m_rootstate.get_movenum()
+                % (color == FastBoard::BLACK ? 'B' : 'W')
+                % m_rootstate.move_to_text(bookmove).c_str());
+        m_last_rootstate = std::make_unique<GameState>(m_rootstate);
+        return bookmove;
+    }
+
+    const auto boardsize = m_rootstate.board.get_boardsize();
+    const auto movenum = m_rootstate.get_movenum();
+    // The share of the previous tree that survived tells how much of
+    // this search the NN cache will answer.
+    const auto reuse =
+        m_last_search_visits > 0
+            ? std::min(1.0f, float(m_root->get_visits()) / m_last_search_visits)
+            : 0.0f;
+    m_prior_rate = m_rate_model.get_rate(boardsize, movenum, reuse);
+
     auto time_for_move = m_rootstate.get_timecontrol().max_time_for_move(
-        m_rootstate.board.get_boardsize(), color, m_rootstate.get_movenum());
+        boardsize, color, movenum);
 
     myprintf("Thinking at most %.1f seconds...\n", time_for_move / 100.0f);
 
     // create a sorted list of legal moves (make sure we
     // play something legal and decent even in time trouble)
-    m_root->prepare_root_node(m_network, color, m_nodes, m_rootstate);
+    // Playout cap randomization: only some moves get the full search,
+    // the noise that comes with it, and make it into the training data.
+    m_full_search =
+        cfg_full_search_prob >= 1.0f
+        || std::uniform_real_distribution<float>{0.0f, 1.0f}(
+               Random::get_Rng())
+               < cfg_full_search_prob;
+    if (!m_full_search) {
+        myprintf("Fast search of %lld visits.\n",
+                 static_cast<long long>(visit_limit()));
+    }
+    m_root->prepare_root_node(m_network, color, m_nodes, m_rootstate,
+                              cfg_noise && m_full_search);
+
+    m_converge_visits.clear();
+    m_converge_playouts = 0;
+
+    // The workers don't know about moves to avoid or allow.
+    const auto coordinator = cfg_analyze_tags.has_move_restrictions()
+                                 ? nullptr
+                                 : GTP::s_coordinator.get();
+    if (coordinator) {
+        coordinator->start(m_rootstate);
+    }
 
     m_run = true;
-    int cpus = cfg_num_threads;
     ThreadGroup tg(thread_pool);
-    for (int i = 0; i < cpus; i++) {
-        tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
-    }
+    start_workers(tg);
 
     auto keeprunning = true;
     auto last_update = 0;
@@ -802,6 +1307,10 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
         Time elapsed;
         int elapsed_centis = Time::timediff_centis(start, elapsed);
 
+        if (coordinator) {
+            coordinator->merge(m_rootstate, *m_root);
+        }
+
         if (cfg_analyze_tags.interval_centis()
             && elapsed_centis - last_output
                    > cfg_analyze_tags.interval_centis()) {
@@ -815,9 +1324,12 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
             last_update = elapsed_centis;
             myprintf("%s\n", get_analysis(m_playouts.load()).c_str());
         }
+        trim_stashed_trees();
+        evict_if_full(tg);
         keeprunning = is_running();
         keeprunning &= !stop_thinking(elapsed_centis, time_for_move);
         keeprunning &= have_alternate_moves(elapsed_centis, time_for_move);
+        keeprunning &= !visits_converged();
     } while (keeprunning);
 
     // Make sure to post at least once.
@@ -830,6 +1342,10 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
     m_network.drain_evals();
     tg.wait_all();
     m_network.resume_evals();
+    if (coordinator) {
+        coordinator->stop();
+        coordinator->merge(m_rootstate, *m_root);
+    }
 
     // Reactivate all pruned root children.
     for (const auto& node : m_root->get_children()) {
@@ -844,13 +1360,23 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
     // Display search info.
     myprintf("\n");
     dump_stats(m_rootstate, *m_root);
-    Training::record(m_network, m_rootstate, *m_root);
+    if (m_full_search) {
+        Training::record(m_network, m_rootstate, *m_root);
+    }
 
     Time elapsed;
     int elapsed_centis = Time::timediff_centis(start, elapsed);
-    myprintf("%d visits, %d nodes, %d playouts, %.0f n/s\n\n",
-             m_root->get_visits(), m_nodes.load(), m_playouts.load(),
+    myprintf("%lld visits, %lld nodes, %lld playouts, %.0f n/s\n",
+             static_cast<long long>(m_root->get_visits()),
+             static_cast<long long>(m_nodes.load()),
+             static_cast<long long>(m_playouts.load()),
              (m_playouts * 100.0) / (elapsed_centis + 1));
+    m_rate_model.update(boardsize, movenum, reuse, m_playouts, elapsed_centis);
+    m_last_search_visits = m_root->get_visits();
+#ifndef NDEBUG
+    m_network.nncache_dump_stats();
+#endif
+    myprintf("\n");
 
 #ifdef USE_OPENCL
 #ifndef NDEBUG
@@ -874,6 +1400,112 @@ int UCTSearch::think(const int color, const passflag_t passflag) {
     return bestmove;
 }
 
+// Returns a move from the opening book, or NO_VERTEX to search instead.
+int UCTSearch::get_book_move(const passflag_t passflag) {
+    // Analysis wants to see a search, and restricted moves aren't
+    // something the book knows about.
+    if (!GTP::s_book
+        || m_rootstate.get_movenum() >= size_t(cfg_book_plies)
+        || cfg_analyze_tags.interval_centis()
+        || cfg_analyze_tags.has_move_restrictions()) {
+        return FastBoard::NO_VERTEX;
+    }
+
+    auto moves = Book::Moves{};
+    if (!GTP::s_book->probe(m_rootstate, moves)) {
+        return FastBoard::NO_VERTEX;
+    }
+
+    const auto color = m_rootstate.board.get_to_move();
+    auto legal = std::vector<std::pair<int, int>>{};
+    for (const auto& move : moves.visits) {
+        const auto allowed =
+            move.first == FastBoard::PASS
+                ? !(passflag & UCTSearch::NOPASS)
+                : m_rootstate.is_move_legal(color, move.first);
+        if (allowed) {
+            legal.emplace_back(move);
+        }
+    }
+    if (legal.empty()) {
+        return FastBoard::NO_VERTEX;
+    }
+
+    Training::record(m_network, m_rootstate, moves.visits, moves.winrate);
+
+    const auto bookmove = Book::pick_move(m_rootstate, legal);
+    myprintf("Book move %s, winrate %5.2f%% (%d moves in book).\n",
+             m_rootstate.move_to_text(bookmove).c_str(),
+             moves.winrate * 100.0f, int(moves.visits.size()));
+    return bookmove;
+}
+
+const UCTNode& UCTSearch::get_root() const {
+    return *m_root;
+}
+
+static constexpr char TREE_MAGIC[4] = {'L', 'Z', 'T', 'R'};
+static constexpr std::uint32_t TREE_VERSION = 2;
+
+void UCTSearch::save_tree(const std::string& filename) {
+    // Move the tree along to the current position first.
+    update_root();
+    m_last_rootstate = std::make_unique<GameState>(m_rootstate);
+    if (m_root->get_visits() == 0) {
+        throw std::runtime_error("No search tree for this position.");
+    }
+
+    auto out = std::ofstream{filename, std::ios::out | std::ios::binary};
+    out.write(TREE_MAGIC, sizeof(TREE_MAGIC));
+    const auto hash = m_rootstate.board.get_hash();
+    const auto komi = m_rootstate.get_komi();
+    const auto movenum = std::uint32_t(m_rootstate.get_movenum());
+    out.write(reinterpret_cast<const char*>(&TREE_VERSION),
+              sizeof(TREE_VERSION));
+    out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+    out.write(reinterpret_cast<const char*>(&komi), sizeof(komi));
+    out.write(reinterpret_cast<const char*>(&movenum), sizeof(movenum));
+    m_root->save(out);
+    out.close();
+    if (out.fail()) {
+        throw std::runtime_error("Cannot write file.");
+    }
+}
+
+void UCTSearch::load_tree(const std::string& filename) {
+    auto in = std::ifstream{filename, std::ios::in | std::ios::binary};
+    char magic[sizeof(TREE_MAGIC)];
+    auto version = std::uint32_t{};
+    auto hash = std::uint64_t{};
+    auto komi = 0.0f;
+    auto movenum = std::uint32_t{};
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&version), sizeof(version));
+    in.read(reinterpret_cast<char*>(&hash), sizeof(hash));
+    in.read(reinterpret_cast<char*>(&komi), sizeof(komi));
+    in.read(reinterpret_cast<char*>(&movenum), sizeof(movenum));
+    if (in.fail() || !std::equal(std::begin(magic), std::end(magic), TREE_MAGIC)
+        || version != TREE_VERSION) {
+        throw std::runtime_error("Not a search tree file.");
+    }
+    if (hash != m_rootstate.board.get_hash()
+        || komi != m_rootstate.get_komi()
+        || movenum != m_rootstate.get_movenum()) {
+        throw std::runtime_error("Search tree is for another position.");
+    }
+
+    auto root = std::make_unique<UCTNode>(FastBoard::PASS, 0.0f);
+    if (!root->load(in, m_rootstate.board)) {
+        throw std::runtime_error("Search tree file is damaged.");
+    }
+
+    wait_for_deletions();
+    m_root = std::move(root);
+    m_nodes = std::int64_t(m_root->count_nodes());
+    m_tree_pruned = false;
+    m_last_rootstate = std::make_unique<GameState>(m_rootstate);
+}
+
 // Brief output from last think() call.
 std::string UCTSearch::explain_last_think() const {
     return m_think_output;
@@ -887,19 +1519,28 @@ void UCTSearch::ponder() {
 
     update_root();
 
+    m_full_search = true;
     m_root->prepare_root_node(m_network, m_rootstate.board.get_to_move(),
-                              m_nodes, m_rootstate);
+                              m_nodes, m_rootstate, cfg_noise);
+
+    // The workers don't know about moves to avoid or allow.
+    const auto coordinator =
+        disable_reuse ? nullptr : GTP::s_coordinator.get();
+    if (coordinator) {
+        coordinator->start(m_rootstate);
+    }
 
     m_run = true;
     ThreadGroup tg(thread_pool);
-    for (auto i = size_t{0}; i < cfg_num_threads; i++) {
-        tg.add_task(UCTWorker(m_rootstate, this, m_root.get()));
-    }
+    start_workers(tg);
     Time start;
     auto keeprunning = true;
     auto last_output = 0;
     do {
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (coordinator) {
+            coordinator->merge(m_rootstate, *m_root);
+        }
         if (cfg_analyze_tags.interval_centis()) {
             Time elapsed;
             int elapsed_centis = Time::timediff_centis(start, elapsed);
@@ -909,6 +1550,8 @@ void UCTSearch::ponder() {
                 output_analysis(m_rootstate, *m_root);
             }
         }
+        trim_stashed_trees();
+        evict_if_full(tg);
         keeprunning = is_running();
         keeprunning &= !stop_thinking(0, 1);
     } while (!Utils::input_pending() && keeprunning);
@@ -923,12 +1566,19 @@ void UCTSearch::ponder() {
     m_network.drain_evals();
     tg.wait_all();
     m_network.resume_evals();
+    if (coordinator) {
+        coordinator->stop();
+        coordinator->merge(m_rootstate, *m_root);
+    }
 
     // Display search info.
     myprintf("\n");
     dump_stats(m_rootstate, *m_root);
 
-    myprintf("\n%d visits, %d nodes\n\n", m_root->get_visits(), m_nodes.load());
+    myprintf("\n%lld visits, %lld nodes\n\n",
+             static_cast<long long>(m_root->get_visits()),
+             static_cast<long long>(m_nodes.load()));
+    m_last_search_visits = m_root->get_visits();
 
     // Copy the root state. Use to check for tree re-use in future calls.
     if (!disable_reuse) {
@@ -936,17 +1586,22 @@ void UCTSearch::ponder() {
     }
 }
 
-void UCTSearch::set_playout_limit(const int playouts) {
+void UCTSearch::set_playout_limit(const std::int64_t playouts) {
     static_assert(
         std::is_convertible<decltype(playouts), decltype(m_maxplayouts)>::value,
         "Inconsistent types for playout amount.");
     m_maxplayouts = std::min(playouts, UNLIMITED_PLAYOUTS);
 }
 
-void UCTSearch::set_visit_limit(const int visits) {
+std::int64_t UCTSearch::visit_limit() const {
+    return m_full_search ? m_maxvisits : std::min(m_maxvisits, cfg_fast_visits);
+}
+
+void UCTSearch::set_visit_limit(const std::int64_t visits) {
     static_assert(
         std::is_convertible<decltype(visits), decltype(m_maxvisits)>::value,
         "Inconsistent types for visits amount.");
-    // Limit to type max / 2 to prevent overflow when multithreading.
+    // Limit to half of what a node can count to prevent overflow when
+    // multithreading.
     m_maxvisits = std::min(visits, UNLIMITED_PLAYOUTS);
 }
@@ -30,12 +30,15 @@
 #ifndef UCTSEARCH_H_INCLUDED
 #define UCTSEARCH_H_INCLUDED
 
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <future>
 #include <list>
 #include <memory>
 #include <string>
 #include <tuple>
+#include <vector>
 
 #include "FastBoard.h"
 #include "FastState.h"
@@ -72,9 +75,39 @@ private:
     float m_eval{0.0f};
 };
 
+/*
+    Playouts per centisecond reached by earlier searches, kept per phase of
+    the game and per fraction of the previous tree that was reused, as both
+    change the rate (NN cache hits, batch fill). Lets a search plan with a
+    realistic rate from its first moment instead of measuring it again.
+*/
+class PlayoutRateModel {
+public:
+    void update(int boardsize, size_t movenum, float reuse,
+                std::int64_t playouts, int centis);
+    // Returns 0 if nothing is known yet.
+    float get_rate(int boardsize, size_t movenum, float reuse) const;
+
+private:
+    static constexpr auto NUM_PHASES = 3;
+    static constexpr auto NUM_REUSE_BUCKETS = 4;
+    // Share of its weight an estimate keeps with each new sample.
+    static constexpr auto DECAY = 0.8f;
+
+    struct Bucket {
+        float rate{0.0f};
+        float weight{0.0f};
+    };
+
+    static int get_phase(int boardsize, size_t movenum);
+    static int get_reuse_bucket(float reuse);
+
+    std::array<std::array<Bucket, NUM_REUSE_BUCKETS>, NUM_PHASES> m_buckets;
+};
+
 namespace TimeManagement {
     enum enabled_t {
-        AUTO = -1, OFF = 0, ON = 1, FAST = 2, NO_PRUNING = 3
+        AUTO = -1, OFF = 0, ON = 1, FAST = 2, NO_PRUNING = 3, CONVERGE = 4
     };
 };
 
@@ -103,49 +136,133 @@ public:
     static constexpr size_t MIN_TREE_SPACE = 100'000'000;
 
     /*
-        Value representing unlimited visits or playouts. Due to
-        concurrent updates while multithreading, we need some
-        headroom within the native type.
+        With tree eviction enabled, cold subtrees are evicted once the
+        tree grows past EVICT_THRESHOLD of the maximum tree size, until
+        it is back down to EVICT_TARGET.
+    */
+    static constexpr float EVICT_THRESHOLD = 0.9f;
+    static constexpr float EVICT_TARGET = 0.7f;
+
+    /*
+        With "converge" time management, the root visit distribution is
+        sampled every CONVERGE_INTERVAL playouts. The search stops once the
+        KL divergence between two samples, per playout in between, drops
+        below cfg_kl_threshold.
     */
-    static constexpr auto UNLIMITED_PLAYOUTS =
-        std::numeric_limits<int>::max() / 2;
+    static constexpr int CONVERGE_INTERVAL = 100;
+
+    // KL divergence of the new root visit distribution from the old one,
+    // per playout in between.  0 if no playouts were added.
+    static double visit_divergence(const std::vector<std::int64_t>& old_visits,
+                                   const std::vector<std::int64_t>& new_visits);
+
+    /*
+        The rate measured in the current search counts as much as the
+        model's estimate once it has run for RATE_PRIOR_CENTIS.
+    */
+    static constexpr int RATE_PRIOR_CENTIS = 100;
+
+    /*
+        Trees of positions the search left are kept, so navigating back to
+        one of them resumes its search. At most MAX_STASHED_TREES of them,
+        taking up at most STASH_SHARE of the maximum tree size, and only
+        as long as the search of the current position leaves room.
+    */
+    static constexpr size_t MAX_STASHED_TREES = 8;
+    static constexpr float STASH_SHARE = 0.5f;
+
+    /*
+        Value representing unlimited visits or playouts. Searches stop
+        at this many root visits at the latest. Due to concurrent updates
+        while multithreading, we need some headroom within what the
+        node counters can hold.
+    */
+    static constexpr auto UNLIMITED_PLAYOUTS = UCTNode::MAX_VISITS / 2;
 
     UCTSearch(GameState& g, Network& network);
+    ~UCTSearch();
     int think(int color, passflag_t passflag = NORMAL);
-    void set_playout_limit(int playouts);
-    void set_visit_limit(int visits);
+    void set_playout_limit(std::int64_t playouts);
+    void set_visit_limit(std::int64_t visits);
     void ponder();
     bool is_running() const;
     void increment_playouts();
     std::string explain_last_think() const;
+    const UCTNode& get_root() const;
+    // Store the tree of the current position, or load one that was stored
+    // for it, so a search can continue where it left off.  Both throw
+    // std::runtime_error on failure.
+    void save_tree(const std::string& filename);
+    void load_tree(const std::string& filename);
     SearchResult play_simulation(GameState& currstate, UCTNode* node);
 
 private:
+    struct StashedTree {
+        std::unique_ptr<GameState> state;
+        std::unique_ptr<UCTNode> root;
+        // Tree size the stashed tree takes up.
+        size_t memory{0};
+    };
+
     float get_min_psa_ratio() const;
-    void dump_stats(const FastState& state, UCTNode& parent);
+    void dump_stats(const GameState& state, UCTNode& parent);
     void tree_stats(const UCTNode& node);
-    std::string get_pv(FastState& state, const UCTNode& parent);
-    std::string get_analysis(int playouts);
+    std::string get_pv(FastState& state, const UCTNode& parent,
+                       int symmetry = Network::IDENTITY_SYMMETRY);
+    std::string get_analysis(std::int64_t playouts);
     bool should_resign(passflag_t passflag, float besteval);
     bool have_alternate_moves(int elapsed_centis, int time_for_move);
-    int est_playouts_left(int elapsed_centis, int time_for_move) const;
+    // Whether stopping early leaves time for the coming moves.
+    bool can_save_time() const;
+    std::int64_t est_playouts_left(int elapsed_centis,
+                                   int time_for_move) const;
     size_t prune_noncontenders(int color, int elapsed_centis = 0,
                                int time_for_move = 0, bool prune = true);
     bool stop_thinking(int elapsed_centis = 0, int time_for_move = 0) const;
+    std::int64_t visit_limit() const;
+    bool visits_converged();
     int get_best_move(passflag_t passflag);
+    int get_book_move(passflag_t passflag);
     void update_root();
     bool advance_to_new_rootstate();
-    void output_analysis(const FastState& state, const UCTNode& parent);
+    void stash_tree(std::unique_ptr<UCTNode> root, const GameState& state);
+    std::unique_ptr<UCTNode> unstash_tree(const GameState& state);
+    void restore_stashed_children(UCTNode& node, const GameState& state);
+    std::unique_ptr<UCTNode> take_stashed(
+        std::list<StashedTree>::iterator it);
+    void trim_stashed_trees();
+    // Tree size without the stash.
+    size_t get_search_tree_size() const;
+    void wait_for_deletions();
+    void start_workers(Utils::ThreadGroup& tg);
+    void evict_if_full(Utils::ThreadGroup& tg);
+    void evict_cold_subtrees(size_t target_size);
+    void output_analysis(const GameState& state, const UCTNode& parent);
 
     GameState& m_rootstate;
     std::unique_ptr<GameState> m_last_rootstate;
     std::unique_ptr<UCTNode> m_root;
-    std::atomic<int> m_nodes{0};
-    std::atomic<int> m_playouts{0};
+    // Most recently left first.
+    std::list<StashedTree> m_stashed_trees;
+    std::atomic<size_t> m_stash_size{0};
+    std::atomic<std::int64_t> m_nodes{0};
+    std::atomic<std::int64_t> m_playouts{0};
     std::atomic<bool> m_run{false};
-    int m_maxplayouts;
-    int m_maxvisits;
+    // Set when nodes were expanded only partially to save memory.
+    std::atomic<bool> m_tree_pruned{false};
+    std::int64_t m_maxplayouts;
+    std::int64_t m_maxvisits;
     std::string m_think_output;
+    // Root visit distribution at the last convergence check.
+    std::vector<std::int64_t> m_converge_visits;
+    std::int64_t m_converge_playouts{0};
+    PlayoutRateModel m_rate_model;
+    // Estimated playout rate for the current search, 0 if unknown.
+    float m_prior_rate{0.0f};
+    // Root visits when the previous search ended.
+    std::int64_t m_last_search_visits{0};
+    // Whether this search gets the full visits, see cfg_full_search_prob.
+    bool m_full_search{true};
 
     std::list<Utils::ThreadGroup> m_delete_futures;
 
@@ -48,6 +48,10 @@
 
 #include "GTP.h"
 
+constexpr size_t Utils::Task::INLINE_SIZE;
+constexpr size_t Utils::ThreadPool::MAX_THREADS;
+constexpr size_t Utils::ThreadPool::ANY_THREAD;
+
 Utils::ThreadPool thread_pool;
 
 auto constexpr z_entries = 1000;
@@ -29,14 +29,24 @@
 
 #include "config.h"
 
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
 #include "Zobrist.h"
 
+#include "Network.h"
 #include "Random.h"
 
+static_assert(Zobrist::NUM_SYMMETRIES == Network::NUM_SYMMETRIES,
+              "Symmetry count mismatch");
+
 std::array<std::array<std::uint64_t, FastBoard::NUM_VERTICES>,     4> Zobrist::zobrist;
 std::array<std::uint64_t, FastBoard::NUM_VERTICES>                    Zobrist::zobrist_ko;
 std::array<std::array<std::uint64_t, FastBoard::NUM_VERTICES * 2>, 2> Zobrist::zobrist_pris;
 std::array<std::uint64_t, 5>                                          Zobrist::zobrist_pass;
+std::array<std::unique_ptr<const Zobrist::SymmetryTables>, BOARD_SIZE + 1> Zobrist::zobrist_sym;
 
 void Zobrist::init_zobrist(Random& rng) {
     for (int i = 0; i < 4; i++) {
@@ -58,4 +68,30 @@ void Zobrist::init_zobrist(Random& rng) {
     for (int i = 0; i < 5; i++) {
         Zobrist::zobrist_pass[i] = rng.randuint64();
     }
+
+    for (auto size = 1; size <= BOARD_SIZE; size++) {
+        if (!is_supported_board_size(size)) {
+            continue;
+        }
+        auto tables = std::make_unique<SymmetryTables>();
+        const auto side = size + 2;
+        for (int j = 0; j < FastBoard::NUM_VERTICES; j++) {
+            const auto x = j % side - 1;
+            const auto y = j / side - 1;
+            const auto on_board = x >= 0 && x < size && y >= 0 && y < size;
+            for (int sym = 0; sym < NUM_SYMMETRIES; sym++) {
+                auto vertex = j;
+                if (on_board) {
+                    const auto newvtx = Network::get_symmetry({x, y}, sym,
+                                                              size);
+                    vertex = (newvtx.second + 1) * side + newvtx.first + 1;
+                }
+                for (int i = 0; i < 4; i++) {
+                    tables->stones[i][j][sym] = Zobrist::zobrist[i][vertex];
+                }
+                tables->ko[j][sym] = Zobrist::zobrist_ko[vertex];
+            }
+        }
+        Zobrist::zobrist_sym[size] = std::move(tables);
+    }
 }
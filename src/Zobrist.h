@@ -33,6 +33,7 @@
 
 #include <array>
 #include <cstdint>
+#include <memory>
 
 #include "FastBoard.h"
 #include "Random.h"
@@ -47,6 +48,18 @@ public:
     static std::array<std::array<std::uint64_t, FastBoard::NUM_VERTICES * 2>, 2> zobrist_pris;
     static std::array<std::uint64_t, 5>                                          zobrist_pass;
 
+    // zobrist and zobrist_ko with each of the board symmetries applied to
+    // the vertex.  Symmetries are innermost so that updating all of them
+    // touches a single cache line.
+    static constexpr auto NUM_SYMMETRIES = 8;
+    using SymmetryKeys = std::array<std::uint64_t, NUM_SYMMETRIES>;
+    struct SymmetryTables {
+        std::array<std::array<SymmetryKeys, FastBoard::NUM_VERTICES>, 4> stones;
+        std::array<SymmetryKeys, FastBoard::NUM_VERTICES>                ko;
+    };
+    // Indexed by board size, only there for the supported ones.
+    static std::array<std::unique_ptr<const SymmetryTables>, BOARD_SIZE + 1> zobrist_sym;
+
     static void init_zobrist(Random& rng);
 };
 
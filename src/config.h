@@ -42,8 +42,10 @@
 #endif
 
 /*
- * BOARD_SIZE: Define size of the board to compile Leela with, must be an odd
-   number due to winograd tiles
+ * BOARD_SIZE: Define the largest size of the board to compile Leela with,
+   must be an odd number due to winograd tiles.  The network code is also
+   compiled for the smaller of 9x9, 13x13 and 19x19, the weights file
+   selects the size at runtime.
  */
 static constexpr auto BOARD_SIZE = 19;
 static_assert(BOARD_SIZE % 2 == 1,
@@ -52,6 +54,11 @@ static_assert(BOARD_SIZE % 2 == 1,
 static constexpr auto NUM_INTERSECTIONS = BOARD_SIZE * BOARD_SIZE;
 static constexpr auto POTENTIAL_MOVES = NUM_INTERSECTIONS + 1; // including pass
 
+constexpr bool is_supported_board_size(const int size) {
+    return size == BOARD_SIZE
+           || (size < BOARD_SIZE && (size == 9 || size == 13 || size == 19));
+}
+
 /*
  * KOMI: Define the default komi to use when training.
  */
@@ -29,24 +29,60 @@
 #include "config.h"
 
 #include <algorithm>
+#include <boost/asio.hpp>
+#include <chrono>
+#include <cmath>
 #include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <gtest/gtest.h>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
 #include <memory>
 #include <regex>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "Book.h"
+#include "Coordinator.h"
+#include "ForwardPipe.h"
 #include "GTP.h"
 #include "GameState.h"
 #include "NNCache.h"
+#include "Network.h"
 #include "Random.h"
+#include "SMP.h"
 #include "ThreadPool.h"
+#include "Timing.h"
+#include "Training.h"
+#include "UCTNode.h"
+#include "UCTSearch.h"
 #include "Utils.h"
 #include "Zobrist.h"
 
 using namespace Utils;
 
+// A random legal move that doesn't fill an own eye, or a pass.
+static int random_move(const FastState& state, Random& rng) {
+    const auto color = state.get_to_move();
+    const auto first = rng.randuint64(NUM_INTERSECTIONS);
+    for (auto j = 0; j < NUM_INTERSECTIONS; j++) {
+        const auto idx = (first + j) % NUM_INTERSECTIONS;
+        const auto vertex =
+            state.board.get_vertex(idx % BOARD_SIZE, idx / BOARD_SIZE);
+        if (state.is_move_legal(color, vertex)
+            && !state.board.is_eye(color, vertex)) {
+            return vertex;
+        }
+    }
+    return FastBoard::PASS;
+}
+
 void expect_regex(const std::string& s, const std::string& re,
                   const bool positive = true) {
     auto m = std::regex_search(s, std::regex(re));
@@ -61,6 +97,56 @@ void expect_regex(const std::string& s, const std::string& re,
     }
 }
 
+// Runs the evaluations of another pipe, and queues prefetches until the
+// test runs them, as a batching pipe would in its spare slots.
+class PrefetchPipe : public ForwardPipe {
+public:
+    explicit PrefetchPipe(std::unique_ptr<ForwardPipe>&& pipe)
+        : m_pipe(std::move(pipe)) {}
+
+    virtual void initialize(const int channels, const int board_size) {
+        m_pipe->initialize(channels, board_size);
+    }
+    virtual void forward(const std::vector<float>& input,
+                         std::vector<float>& output_pol,
+                         std::vector<float>& output_val) {
+        m_pipe->forward(input, output_pol, output_val);
+    }
+    virtual bool accepts_prefetch() const {
+        return m_accepts;
+    }
+    virtual void prefetch(std::vector<float>&& input, PrefetchCallback done) {
+        m_queue.emplace_back(std::move(input), std::move(done));
+    }
+    virtual void push_weights(
+        const unsigned int filter_size, const unsigned int channels,
+        const unsigned int outputs,
+        std::shared_ptr<const ForwardPipeWeights> weights) {
+        m_pipe->push_weights(filter_size, channels, outputs, weights);
+    }
+
+    size_t queued() const {
+        return m_queue.size();
+    }
+    void run_prefetches() {
+        auto output_pol = std::vector<float>(Network::OUTPUTS_POLICY
+                                             * NUM_INTERSECTIONS);
+        auto output_val = std::vector<float>(Network::OUTPUTS_VALUE
+                                             * NUM_INTERSECTIONS);
+        for (const auto& entry : m_queue) {
+            m_pipe->forward(entry.first, output_pol, output_val);
+            entry.second(output_pol, output_val);
+        }
+        m_queue.clear();
+    }
+
+    bool m_accepts{true};
+
+private:
+    std::unique_ptr<ForwardPipe> m_pipe;
+    std::vector<std::pair<std::vector<float>, PrefetchCallback>> m_queue;
+};
+
 class LeelaEnv : public ::testing::Environment {
 public:
     ~LeelaEnv() {}
@@ -118,6 +204,40 @@ public:
     void test_analyze_cmd(const std::string& cmd, bool valid, int who,
                           int interval, int avoidlen, int avoidcolor,
                           int avoiduntil);
+    // Buffers that playing a move can grow.
+    static std::vector<const void*> move_buffers(const GameState& state) {
+        return {state.m_move_history.data(), state.m_ko_hashes.data()};
+    }
+    static size_t checkpoint_count(const GameState& state) {
+        return state.m_checkpoints.size();
+    }
+    // Evaluations of the same position shared between threads.
+    static bool wait_in_flight(const GameState& state,
+                               Network::Netresult& result) {
+        return GTP::s_network->wait_in_flight(&state, result);
+    }
+    static void finish_in_flight(const GameState& state,
+                                 const Network::Netresult* result) {
+        GTP::s_network->finish_in_flight(state.board.get_hash(), result);
+    }
+    // Waits until 'count' more requesters wait for another's result.
+    static void wait_for_waiters(const int before, const int count) {
+        while (GTP::s_network->m_dedup_evals < before + count) {
+            std::this_thread::yield();
+        }
+    }
+    static int dedup_evals() {
+        return GTP::s_network->m_dedup_evals;
+    }
+    static PrefetchPipe& install_prefetch_pipe(Network& network) {
+        auto pipe = std::make_unique<PrefetchPipe>(std::move(network.m_forward));
+        auto& ref = *pipe;
+        network.m_forward = std::move(pipe);
+        return ref;
+    }
+    static size_t training_records() {
+        return Training::m_data.size();
+    }
 
 private:
     std::unique_ptr<GameState> m_gamestate;
@@ -158,6 +278,238 @@ TEST_F(LeelaTest, Transposition) {
     EXPECT_EQ(ko_hash, maingame.board.get_ko_hash());
 }
 
+TEST_F(LeelaTest, SymmetryHash) {
+    auto maingame = get_gamestate();
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b E5");
+    GTP::execute(maingame, "play w F5");
+    GTP::execute(maingame, "play b D4");
+    GTP::execute(maingame, "play w F3");
+    GTP::execute(maingame, "play b E3");
+    GTP::execute(maingame, "play w G4");
+    GTP::execute(maingame, "play b Q16");
+    GTP::execute(maingame, "play w E4");
+    GTP::execute(maingame, "play b F4"); // capture, leaves a ko
+    std::string output = testing::internal::GetCapturedStdout();
+
+    ASSERT_NE(maingame.m_komove, FastBoard::NO_VERTEX);
+    for (auto sym = 0; sym < Network::NUM_SYMMETRIES; sym++) {
+        EXPECT_EQ(maingame.board.calc_symmetry_hash(maingame.m_komove, sym),
+                  maingame.get_symmetry_hash(sym));
+    }
+    EXPECT_EQ(maingame.board.get_hash(),
+              maingame.get_symmetry_hash(Network::IDENTITY_SYMMETRY));
+
+    // Smaller boards have tables of their own.
+    maingame.init_game(9, 7.5f);
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b E5");
+    GTP::execute(maingame, "play w D5");
+    GTP::execute(maingame, "play b H8");
+    GTP::execute(maingame, "play w E6");
+    output = testing::internal::GetCapturedStdout();
+
+    for (auto sym = 0; sym < Network::NUM_SYMMETRIES; sym++) {
+        EXPECT_EQ(maingame.board.calc_symmetry_hash(maingame.m_komove, sym),
+                  maingame.get_symmetry_hash(sym));
+    }
+}
+
+TEST_F(LeelaTest, LegalMoves) {
+    auto maingame = get_gamestate();
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b E5");
+    GTP::execute(maingame, "play w F5");
+    GTP::execute(maingame, "play b D4");
+    GTP::execute(maingame, "play w F3");
+    GTP::execute(maingame, "play b E3");
+    GTP::execute(maingame, "play w G4");
+    GTP::execute(maingame, "play b A2");
+    GTP::execute(maingame, "play w Q16");
+    GTP::execute(maingame, "play b B1"); // A1 is suicide for white
+    GTP::execute(maingame, "play w E4");
+    GTP::execute(maingame, "play b F4"); // capture, leaves a ko
+    std::string output = testing::internal::GetCapturedStdout();
+
+    EXPECT_FALSE(maingame.is_move_legal(FastBoard::WHITE,
+                                        maingame.board.text_to_move("A1")));
+    EXPECT_FALSE(maingame.is_move_legal(FastBoard::WHITE,
+                                        maingame.board.text_to_move("E4")));
+    for (auto color : {FastBoard::BLACK, FastBoard::WHITE}) {
+        const auto legal = maingame.get_legal_moves(color);
+        for (auto idx = 0; idx < NUM_INTERSECTIONS; idx++) {
+            const auto vertex =
+                maingame.board.get_vertex(idx % BOARD_SIZE, idx / BOARD_SIZE);
+            EXPECT_EQ(maingame.is_move_legal(color, vertex),
+                      legal.test(vertex));
+        }
+    }
+}
+
+TEST_F(LeelaTest, AreaScore) {
+    auto maingame = get_gamestate();
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b A2");
+    GTP::execute(maingame, "play w Q16");
+    GTP::execute(maingame, "play b B2");
+    GTP::execute(maingame, "play w pass");
+    GTP::execute(maingame, "play b B1");
+    std::string output = testing::internal::GetCapturedStdout();
+
+    // A1 is black's alone, the rest of the board is shared.
+    EXPECT_FLOAT_EQ(3.0f - 7.5f, maingame.final_score());
+}
+
+TEST_F(LeelaTest, PassAlive) {
+    auto maingame = get_gamestate();
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b A2");
+    GTP::execute(maingame, "play w Q16");
+    GTP::execute(maingame, "play b B2");
+    GTP::execute(maingame, "play w Q4");
+    GTP::execute(maingame, "play b C2");
+    GTP::execute(maingame, "play w D4");
+    GTP::execute(maingame, "play b D2");
+    GTP::execute(maingame, "play w D16");
+    GTP::execute(maingame, "play b D1");
+    GTP::execute(maingame, "play w K10");
+    GTP::execute(maingame, "play b B1");
+    std::string output = testing::internal::GetCapturedStdout();
+
+    // Two eyes at A1 and C1 make the black group unconditionally alive.
+    const auto& board = maingame.board;
+    const auto black = board.calc_pass_alive(FastBoard::BLACK);
+    EXPECT_EQ(8, black.count());
+    EXPECT_TRUE(black.test(board.get_vertex(0, 0)));
+    EXPECT_TRUE(black.test(board.get_vertex(2, 0)));
+    EXPECT_EQ(0, board.calc_pass_alive(FastBoard::WHITE).count());
+    EXPECT_EQ(2, board.calc_pass_alive_eyes(FastBoard::BLACK).count());
+    EXPECT_EQ(0, board.calc_pass_alive_eyes(FastBoard::WHITE).count());
+    // The eyes touch stones, the empty edge further along doesn't.
+    EXPECT_FALSE(board.calc_open_points().test(board.get_vertex(0, 0)));
+    EXPECT_TRUE(board.calc_open_points().test(board.get_vertex(9, 0)));
+
+    auto score = 0.0f;
+    EXPECT_FALSE(board.calc_settled_score(7.5f, score));
+}
+
+TEST_F(LeelaTest, PositionSymmetries) {
+    auto maingame = get_gamestate();
+    const auto& board = maingame.board;
+
+    // The empty board has every symmetry, the 4-4 points are one move.
+    auto symmetries = maingame.get_symmetries();
+    EXPECT_EQ(7, symmetries.size());
+    EXPECT_EQ(4, board.get_equivalent_vertices(board.get_vertex(3, 3),
+                                               symmetries)
+                     .size());
+    EXPECT_EQ(8, board.get_equivalent_vertices(board.get_vertex(3, 2),
+                                               symmetries)
+                     .size());
+    EXPECT_EQ(1, board.get_equivalent_vertices(FastBoard::PASS, symmetries)
+                     .size());
+
+    // Avoiding one of the 4-4 points leaves the others to play.
+    auto cmdstream = std::istringstream{"b avoid b d4 1"};
+    cfg_analyze_tags = AnalyzeTags{cmdstream, maingame};
+    EXPECT_EQ(0, maingame.get_symmetries().size());
+    const auto legal = maingame.get_legal_moves(FastBoard::BLACK);
+    EXPECT_FALSE(legal.test(board.get_vertex(3, 3)));
+    EXPECT_TRUE(legal.test(board.get_vertex(15, 15)));
+    cfg_analyze_tags = AnalyzeTags{};
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b K10");
+    EXPECT_EQ(7, maingame.get_symmetries().size());
+    GTP::execute(maingame, "play w D4");
+    symmetries = maingame.get_symmetries();
+    ASSERT_EQ(1, symmetries.size());
+    EXPECT_EQ(board.get_vertex(3, 15),
+              board.get_symmetric_vertex(board.get_vertex(15, 3),
+                                         symmetries[0]));
+    GTP::execute(maingame, "play b Q4");
+    EXPECT_EQ(0, maingame.get_symmetries().size());
+    testing::internal::GetCapturedStdout();
+}
+
+TEST_F(LeelaTest, SymmetricChildReuse) {
+    auto& game = get_gamestate();
+    const auto& board = game.board;
+    std::atomic<std::int64_t> nodes{0};
+    UCTNode root(FastBoard::PASS, 0.0f);
+    root.prepare_root_node(*GTP::s_network, FastBoard::BLACK, nodes, game,
+                           false);
+
+    // A 3-4 point is off the diagonals, so each of its equivalents is
+    // reached by exactly one symmetry.
+    const auto symmetries = game.get_symmetries();
+    const auto equivalents =
+        board.get_equivalent_vertices(board.get_vertex(3, 2), symmetries);
+    auto child = static_cast<UCTNode*>(nullptr);
+    for (const auto& node : root.get_children()) {
+        for (const auto& entry : equivalents) {
+            if (node.get_move() == entry.first) {
+                child = node.get();
+            }
+        }
+    }
+    ASSERT_NE(nullptr, child);
+    auto after = game;
+    after.play_move(child->get_move());
+    auto eval = 0.0f;
+    ASSERT_TRUE(child->create_children(*GTP::s_network, nodes, after, eval));
+    child->update(eval);
+
+    auto children_moves = [](const UCTNode& node) {
+        const auto& children = node.get_children();
+        auto moves = std::vector<int>{};
+        for (const auto& entry : children) {
+            moves.emplace_back(entry.get_move());
+        }
+        for (auto i = children.size(); i < children.total_size(); i++) {
+            moves.emplace_back(children.vertex(i));
+        }
+        return moves;
+    };
+    const auto moves = children_moves(*child);
+    const auto child_move = child->get_move();
+
+    // Play an equivalent the child doesn't stand for literally.
+    auto played = FastBoard::PASS;
+    auto symmetry = 0;
+    for (const auto sym : symmetries) {
+        if (board.get_symmetric_vertex(child->get_move(), sym)
+            != child->get_move()) {
+            played = board.get_symmetric_vertex(child->get_move(), sym);
+            symmetry = sym;
+            break;
+        }
+    }
+    auto node = root.find_child(game, played);
+    ASSERT_NE(nullptr, node);
+    EXPECT_EQ(played, node->get_move());
+    const auto mapped = children_moves(*node);
+    ASSERT_EQ(moves.size(), mapped.size());
+    for (auto i = size_t{0}; i < moves.size(); i++) {
+        EXPECT_EQ(board.get_symmetric_vertex(moves[i], symmetry), mapped[i]);
+    }
+
+    // Grafting it back maps it to the child's orientation again.
+    EXPECT_TRUE(root.restore_child(game, played, node));
+    auto restored = static_cast<UCTNode*>(nullptr);
+    for (const auto& entry : root.get_children()) {
+        if (entry.get_move() == child_move && entry.get_visits() > 0) {
+            restored = entry.get();
+        }
+    }
+    ASSERT_NE(nullptr, restored);
+    EXPECT_EQ(moves, children_moves(*restored));
+}
+
 TEST_F(LeelaTest, KoPntNotSame) {
     auto maingame = get_gamestate();
 
@@ -198,6 +550,225 @@ TEST_F(LeelaTest, KoPntNotSame) {
     EXPECT_NE(hash, maingame.board.get_hash());
 }
 
+TEST_F(LeelaTest, UnmakeMoves) {
+    auto maingame = get_gamestate();
+
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "play b Q16");
+    GTP::execute(maingame, "play w D16");
+    std::string output = testing::internal::GetCapturedStdout();
+
+    // Set after the last move, as GTP komi and genmove do.
+    maingame.set_komi(0.5f);
+    maingame.set_to_move(FastBoard::WHITE);
+
+    const auto movenum = maingame.get_movenum();
+    const auto hash = maingame.board.get_hash();
+    const auto history = maingame.get_move_history().size();
+
+    maingame.set_unmake_point();
+    for (auto i = 0; i < 2; i++) {
+        maingame.play_move(maingame.board.text_to_move("D4"));
+        maingame.play_move(maingame.board.text_to_move("Q4"));
+        maingame.play_move(FastBoard::PASS);
+        EXPECT_EQ(movenum + 3, maingame.get_movenum());
+        EXPECT_NE(hash, maingame.board.get_hash());
+
+        maingame.unmake_moves();
+        EXPECT_EQ(movenum, maingame.get_movenum());
+        EXPECT_EQ(hash, maingame.board.get_hash());
+        EXPECT_EQ(FastBoard::WHITE, maingame.get_to_move());
+        EXPECT_EQ(0.5f, maingame.get_komi());
+        EXPECT_EQ(history, maingame.get_move_history().size());
+        EXPECT_EQ(0, maingame.get_passes());
+    }
+}
+
+TEST_F(LeelaTest, UnmakeReusesBuffers) {
+    constexpr auto PLAYOUT_MOVES = 40;
+    auto rng = Random{42};
+    auto game = get_gamestate();
+    for (auto i = 0; i < 30; i++) {
+        game.play_move(random_move(game, rng));
+    }
+
+    // Playouts cross checkpoint intervals and grow the ko hash set.  Once
+    // the first one has sized the buffers, the others reuse them and take
+    // no checkpoints.
+    game.set_unmake_point();
+    const auto checkpoints = checkpoint_count(game);
+    auto buffers = std::vector<const void*>{};
+    for (auto i = 0; i < 10; i++) {
+        for (auto j = 0; j < PLAYOUT_MOVES; j++) {
+            game.play_move(random_move(game, rng));
+        }
+        EXPECT_EQ(checkpoints, checkpoint_count(game));
+        const auto grown = move_buffers(game);
+        game.unmake_moves();
+        EXPECT_EQ(grown, move_buffers(game));
+        if (i > 0) {
+            EXPECT_EQ(buffers, grown);
+        }
+        buffers = grown;
+    }
+
+    // Positions without checkpoints of their own can still be restored.
+    for (auto j = 0; j < PLAYOUT_MOVES; j++) {
+        game.play_move(random_move(game, rng));
+    }
+    const auto hash = game.board.get_hash();
+    game.undo_move();
+    game.forward_move();
+    EXPECT_EQ(hash, game.board.get_hash());
+}
+
+// Make/unmake against copying the position for every playout, run with
+// --gtest_also_run_disabled_tests --gtest_filter=*UnmakeScaling*
+TEST_F(LeelaTest, DISABLED_UnmakeScaling) {
+    constexpr auto PLAYOUTS_PER_THREAD = 20000;
+    constexpr auto PLAYOUT_MOVES = 20;
+
+    auto rng = Random{42};
+    auto root = get_gamestate();
+    for (auto i = 0; i < 100; i++) {
+        root.play_move(random_move(root, rng));
+    }
+
+    const auto max_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    for (const auto unmake : {false, true}) {
+        for (auto threads = 1u; threads <= max_threads; threads *= 2) {
+            const Time start;
+            auto workers = std::vector<std::thread>{};
+            for (auto t = 0u; t < threads; t++) {
+                workers.emplace_back([&root, unmake, t] {
+                    auto rng = Random{t};
+                    auto state = std::make_unique<GameState>(root);
+                    state->set_unmake_point();
+                    for (auto i = 0; i < PLAYOUTS_PER_THREAD; i++) {
+                        auto copy = unmake
+                                        ? std::unique_ptr<GameState>{}
+                                        : std::make_unique<GameState>(root);
+                        auto& currstate = unmake ? *state : *copy;
+                        for (auto j = 0; j < PLAYOUT_MOVES; j++) {
+                            currstate.play_move(random_move(currstate, rng));
+                        }
+                        if (unmake) {
+                            currstate.unmake_moves();
+                        }
+                    }
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+            const Time end;
+
+            const auto elapsed = Time::timediff_seconds(start, end);
+            std::cout << (unmake ? "unmake: " : "copy:   ") << threads
+                      << " thread(s): "
+                      << threads * PLAYOUTS_PER_THREAD / elapsed
+                      << " playouts/s" << std::endl;
+        }
+    }
+}
+
+TEST_F(LeelaTest, UndoReplaysHistory) {
+    auto maingame = get_gamestate();
+
+    // Long enough to cross a few checkpoints.
+    auto hashes = std::vector<std::uint64_t>{maingame.board.get_hash()};
+    for (auto i = 0; i < 50; i++) {
+        const auto x = (i * 7) % BOARD_SIZE;
+        const auto y = (i * 11 + i / BOARD_SIZE) % BOARD_SIZE;
+        auto vertex = maingame.board.get_vertex(x, y);
+        if (maingame.board.get_state(vertex) != FastBoard::EMPTY) {
+            vertex = FastBoard::PASS;
+        }
+        maingame.play_move(vertex);
+        hashes.push_back(maingame.board.get_hash());
+    }
+
+    auto replayed = maingame;
+    for (auto movenum = hashes.size() - 1; movenum > 0; movenum--) {
+        EXPECT_TRUE(replayed.undo_move());
+        EXPECT_EQ(hashes[movenum - 1], replayed.board.get_hash());
+    }
+    EXPECT_FALSE(replayed.undo_move());
+    while (replayed.forward_move()) {
+        EXPECT_EQ(hashes[replayed.get_movenum()], replayed.board.get_hash());
+    }
+    EXPECT_EQ(maingame.get_movenum(), replayed.get_movenum());
+
+    replayed.rewind();
+    for (auto i = 0; i < 30; i++) {
+        replayed.forward_move();
+    }
+    replayed.undo_move();
+    replayed.forward_move();
+    auto reference = maingame;
+    reference.rewind();
+    for (auto i = 0; i < 30; i++) {
+        reference.forward_move();
+    }
+    for (auto h = 0; h < int(GameState::HISTORY_BOARDS); h++) {
+        for (auto idx = 0; idx < NUM_INTERSECTIONS; idx++) {
+            const auto x = idx % BOARD_SIZE;
+            const auto y = idx / BOARD_SIZE;
+            EXPECT_EQ(reference.get_past_board(h).get_state(x, y),
+                      replayed.get_past_board(h).get_state(x, y));
+        }
+    }
+}
+
+TEST_F(LeelaTest, UndoKeepsGameSettings) {
+    auto maingame = get_gamestate();
+
+    maingame.set_fixed_handicap(4);
+    testing::internal::CaptureStdout();
+    GTP::execute(maingame, "komi 0.5");
+    GTP::execute(maingame, "play w D10");
+    GTP::execute(maingame, "play b Q10");
+    testing::internal::GetCapturedStdout();
+
+    EXPECT_TRUE(maingame.undo_move());
+    EXPECT_EQ(0.5f, maingame.get_komi());
+    EXPECT_EQ(4, maingame.get_handicap());
+    EXPECT_EQ(FastBoard::BLACK, maingame.get_to_move());
+    maingame.rewind();
+    EXPECT_EQ(0.5f, maingame.get_komi());
+    EXPECT_EQ(4, maingame.get_handicap());
+    EXPECT_EQ(FastBoard::WHITE, maingame.get_to_move());
+
+    // A search root with the side to move changed, as think() does.
+    maingame.set_to_move(FastBoard::BLACK);
+    const auto hash = maingame.board.get_hash();
+    maingame.set_unmake_point();
+    maingame.play_move(maingame.board.text_to_move("K10"));
+    maingame.play_move(maingame.board.text_to_move("C3"));
+    maingame.unmake_moves();
+    EXPECT_EQ(hash, maingame.board.get_hash());
+    EXPECT_EQ(0.5f, maingame.get_komi());
+    EXPECT_EQ(4, maingame.get_handicap());
+    EXPECT_EQ(FastBoard::BLACK, maingame.get_to_move());
+}
+
+TEST_F(LeelaTest, Superko) {
+    auto maingame = get_gamestate();
+
+    // Enough distinct positions to grow the ko hash set a few times.
+    for (auto y = 0; y < 8; y++) {
+        for (auto x = 0; x < BOARD_SIZE; x++) {
+            maingame.play_move(maingame.board.get_vertex(x, 2 * y));
+            EXPECT_FALSE(maingame.superko());
+        }
+    }
+    // A pass repeats the position.
+    maingame.play_move(FastBoard::PASS);
+    EXPECT_TRUE(maingame.superko());
+    maingame.play_move(maingame.board.get_vertex(0, 1));
+    EXPECT_FALSE(maingame.superko());
+}
+
 TEST_F(LeelaTest, MoveOnOccupiedPnt) {
     auto maingame = get_gamestate();
     std::string output;
@@ -376,3 +947,904 @@ TEST_F(LeelaTest, AnalyzeParseMinmoves) {
     // Expect to see at least 5 move priors
     expect_regex(result.first, "info.*?(prior\\s+\\d+\\s+.*?){5,}.*");
 }
+
+TEST_F(LeelaTest, SaveLoadTree) {
+    gtp_execute("clear_board");
+    gtp_execute("lz-setoption name pondering value false");
+    gtp_execute("lz-setoption name playouts value 20");
+    gtp_execute("play b q16");
+    gtp_execute("genmove w");
+    const auto last_move = gtp_execute("last_move").first;
+    expect_regex(gtp_execute("lz-save_tree tree1.bin").first, "^= ");
+
+    // The tree only fits the position it was saved for.
+    gtp_execute("undo");
+    expect_regex(gtp_execute("lz-load_tree tree1.bin").first,
+                 "another position");
+
+    // Saving a loaded tree gives back the same file.
+    std::smatch match;
+    ASSERT_TRUE(std::regex_search(last_move, match,
+                                  std::regex("white ([A-Z0-9]+)")));
+    gtp_execute("play w " + match[1].str());
+    expect_regex(gtp_execute("lz-load_tree tree1.bin").first, "^= ");
+    expect_regex(gtp_execute("lz-save_tree tree2.bin").first, "^= ");
+
+    auto read_file = [](const std::string& filename) {
+        std::ifstream in(filename, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+    const auto tree1 = read_file("tree1.bin");
+    EXPECT_GT(tree1.size(), 100);
+    EXPECT_EQ(tree1, read_file("tree2.bin"));
+
+    // A vertex outside the board is rejected, not trusted.  The root's
+    // move follows the magic, version, hash, komi and move number.
+    constexpr auto ROOT = 4 + 4 + 8 + 4 + 4;
+    const auto expect_damaged = [this](const std::string& damaged) {
+        std::ofstream("tree2.bin", std::ios::binary) << damaged;
+        expect_regex(gtp_execute("lz-load_tree tree2.bin").first, "damaged");
+    };
+    for (const auto off_board :
+         {std::int16_t{FastBoard::NUM_VERTICES}, std::int16_t{0}}) {
+        auto damaged = tree1;
+        std::memcpy(&damaged[ROOT], &off_board, sizeof(off_board));
+        expect_damaged(damaged);
+    }
+    // So are unknown status bytes, after the move and policy.
+    for (const auto status : {std::uint8_t{0x3}, std::uint8_t{0x10}}) {
+        auto damaged = tree1;
+        damaged[ROOT + 2 + 4] = char(status);
+        expect_damaged(damaged);
+    }
+    // And a child listed twice.  The children's vertex and policy pairs
+    // follow the node's fields, the last ones have no subtree.
+    {
+        constexpr auto COUNT = ROOT + 2 + 4 + 1 + 1 + 4 + 4 + 8 + 8 + 8;
+        constexpr auto PAIR = 2 + 4;
+        auto count = std::uint16_t{};
+        auto materialized = std::uint16_t{};
+        std::memcpy(&count, &tree1[COUNT], sizeof(count));
+        std::memcpy(&materialized, &tree1[COUNT + 2], sizeof(materialized));
+        ASSERT_GT(count, materialized + 1);
+        const auto last = COUNT + 2 + 2 + (count - 1) * PAIR;
+        auto damaged = tree1;
+        std::memcpy(&damaged[last], &damaged[last - PAIR], 2);
+        expect_damaged(damaged);
+    }
+
+    // A search sorts the root by visits, as analysis does.  Saving it at
+    // the same position must still give a tree that loads.
+    testing::internal::CaptureStderr();
+    {
+        auto& game = get_gamestate();
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(100);
+        search->think(game.get_to_move());
+        search->save_tree("tree1.bin");
+        EXPECT_NO_THROW(search->load_tree("tree1.bin"));
+        search->save_tree("tree2.bin");
+    }
+    testing::internal::GetCapturedStderr();
+    Training::clear_training();
+    EXPECT_EQ(read_file("tree1.bin"), read_file("tree2.bin"));
+    std::remove("tree1.bin");
+    std::remove("tree2.bin");
+}
+
+TEST_F(LeelaTest, UndoRestoresStashedTree) {
+    auto& game = get_gamestate();
+    game.play_move(game.board.text_to_move("Q16"));
+    const auto before = UCTNodePointer::get_tree_size();
+
+    testing::internal::CaptureStderr();
+    {
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(50);
+        const auto move = search->think(FastBoard::WHITE);
+        game.play_move(FastBoard::WHITE, move);
+
+        // Reuses the subtree of 'move', the rest of the tree is stashed.
+        search->think(FastBoard::BLACK);
+        const auto visits = search->get_root().get_visits();
+        EXPECT_GT(visits, 50);
+
+        // Stepping back grafts the tree searched after 'move' into the
+        // stashed tree of the position before it, under whichever of the
+        // moves equivalent to 'move' the stashed tree has a child for.
+        game.undo_move();
+        search->set_playout_limit(1);
+        search->think(FastBoard::WHITE);
+        const auto equivalents =
+            game.board.get_equivalent_vertices(move, game.get_symmetries());
+        auto restored = std::int64_t{0};
+        for (const auto& child : search->get_root().get_children()) {
+            for (const auto& equivalent : equivalents) {
+                if (child.get_move() == equivalent.first) {
+                    restored = std::max(restored, child.get_visits());
+                }
+            }
+        }
+        EXPECT_GE(restored, visits);
+
+        // The root counts the grafted visits as well, once.
+        auto children_visits = std::int64_t{0};
+        for (const auto& child : search->get_root().get_children()) {
+            children_visits += child.get_visits();
+        }
+        EXPECT_EQ(children_visits + 1, search->get_root().get_visits());
+    }
+    testing::internal::GetCapturedStderr();
+    Training::clear_training();
+
+    // Nothing of the live tree or the stash is left behind.
+    EXPECT_EQ(before, UCTNodePointer::get_tree_size());
+}
+
+TEST_F(LeelaTest, ProvenResultsPropagate) {
+    auto& game = get_gamestate();
+    testing::internal::CaptureStderr();
+    {
+        // Black holds the two left columns and white the rest, each with
+        // two single point eyes, and one dame point is left between them.
+        // Filling it settles the board, and white wins either way.
+        const auto dame = game.board.get_vertex(2, 9);
+        auto position = GameState{game};
+        for (auto y = 0; y < BOARD_SIZE; y++) {
+            for (auto x = 0; x < BOARD_SIZE; x++) {
+                const auto eye = (x == 0 && (y == 3 || y == 10))
+                                 || (x == 10 && (y == 5 || y == 14));
+                const auto vertex = position.board.get_vertex(x, y);
+                if (!eye && vertex != dame) {
+                    position.play_move(x < 2 ? FastBoard::BLACK
+                                             : FastBoard::WHITE,
+                                       vertex);
+                }
+            }
+        }
+        position.set_to_move(FastBoard::WHITE);
+        auto search = std::make_unique<UCTSearch>(position, *GTP::s_network);
+        search->set_playout_limit(100);
+
+        // White to move wins by filling the dame.
+        search->think(FastBoard::WHITE);
+        EXPECT_EQ(UCTNode::Proven::WHITE_WINS,
+                  search->get_root().get_proven());
+        for (const auto& child : search->get_root().get_children()) {
+            if (child.get_move() == dame) {
+                ASSERT_TRUE(child.is_inflated());
+                EXPECT_EQ(UCTNode::Proven::WHITE_WINS, child->get_proven());
+            }
+        }
+
+        // After white passes, black loses by filling the dame and by
+        // passing, the only moves it has.
+        position.play_move(FastBoard::WHITE, FastBoard::PASS);
+        search->think(FastBoard::BLACK);
+        EXPECT_EQ(UCTNode::Proven::WHITE_WINS,
+                  search->get_root().get_proven());
+        EXPECT_EQ(2, search->get_root().get_children().total_size());
+    }
+    {
+        // The same split, but with a dead black stone in a two point
+        // eye of white instead of the dame.  It counts for black until
+        // white captures it.
+        const auto dead = game.board.get_vertex(11, 14);
+        const auto eye = game.board.get_vertex(10, 14);
+        auto position = GameState{game};
+        for (auto y = 0; y < BOARD_SIZE; y++) {
+            for (auto x = 0; x < BOARD_SIZE; x++) {
+                const auto vertex = position.board.get_vertex(x, y);
+                if ((x == 0 && (y == 3 || y == 10)) || (x == 10 && y == 5)
+                    || vertex == dead || vertex == eye) {
+                    continue;
+                }
+                position.play_move(x < 2 ? FastBoard::BLACK
+                                         : FastBoard::WHITE,
+                                   vertex);
+            }
+        }
+        position.play_move(FastBoard::BLACK, dead);
+        auto score = 0.0f;
+        EXPECT_FALSE(position.board.calc_settled_score(0.0f, score));
+
+        // Black wins by a point and a half if the game is passed out,
+        // and loses by as much if white captures first.
+        position.set_komi(position.final_score() + position.get_komi()
+                          - 1.5f);
+        position.set_to_move(FastBoard::WHITE);
+        auto search = std::make_unique<UCTSearch>(position, *GTP::s_network);
+        search->set_playout_limit(300);
+        search->think(FastBoard::WHITE);
+        EXPECT_EQ(UCTNode::Proven::WHITE_WINS,
+                  search->get_root().get_proven());
+        for (const auto& child : search->get_root().get_children()) {
+            if (child.get_move() == FastBoard::PASS && child.is_inflated()) {
+                EXPECT_NE(UCTNode::Proven::WHITE_WINS, child->get_proven());
+            }
+        }
+
+        // After white passes, black ends the game and wins by passing.
+        position.play_move(FastBoard::WHITE, FastBoard::PASS);
+        search->think(FastBoard::BLACK);
+        EXPECT_EQ(UCTNode::Proven::BLACK_WINS,
+                  search->get_root().get_proven());
+    }
+    {
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(200);
+        search->think(FastBoard::BLACK);
+        auto expanded = std::vector<UCTNode*>{};
+        for (const auto& child : search->get_root().get_children()) {
+            if (child.is_inflated() && child->has_children()) {
+                expanded.push_back(child.get());
+            }
+        }
+        ASSERT_GE(expanded.size(), 2);
+
+        // One winning reply proves a node won for the side to move, one
+        // losing reply proves nothing while other replies are unknown.
+        const auto won = expanded[0];
+        won->inflate_all_children();
+        won->get_children()[0]->set_proven(UCTNode::Proven::WHITE_WINS);
+        won->update_proven(FastBoard::WHITE);
+        EXPECT_EQ(UCTNode::Proven::WHITE_WINS, won->get_proven());
+        const auto open = expanded[1];
+        open->inflate_all_children();
+        open->get_children()[0]->set_proven(UCTNode::Proven::BLACK_WINS);
+        open->update_proven(FastBoard::WHITE);
+        EXPECT_EQ(UCTNode::Proven::UNKNOWN, open->get_proven());
+
+        // A proven node returns its exact result without searching on.
+        auto children_visits = [](const UCTNode& node) {
+            auto visits = std::int64_t{0};
+            for (const auto& child : node.get_children()) {
+                visits += child.get_visits();
+            }
+            return visits;
+        };
+        const auto visits = won->get_visits();
+        const auto below = children_visits(*won);
+        auto state = game;
+        state.play_move(won->get_move());
+        const auto result = search->play_simulation(state, won);
+        ASSERT_TRUE(result.valid());
+        EXPECT_EQ(0.0f, result.eval());
+        EXPECT_EQ(visits + 1, won->get_visits());
+        EXPECT_EQ(below, children_visits(*won));
+    }
+    testing::internal::GetCapturedStderr();
+}
+
+TEST_F(LeelaTest, InFlightEvaluations) {
+    auto& game = get_gamestate();
+    game.play_move(game.board.text_to_move("Q16"));
+    auto index = [&game](const std::string& move) {
+        const auto xy = game.board.get_xy(game.board.text_to_move(move));
+        return xy.second * BOARD_SIZE + xy.first;
+    };
+    auto netresult = Network::Netresult{};
+    netresult.winrate = 0.42f;
+    netresult.policy[index("Q16")] = 0.5f;
+
+    // The first requester evaluates, the others get its result.
+    auto dedup = dedup_evals();
+    auto dummy = Network::Netresult{};
+    ASSERT_FALSE(wait_in_flight(game, dummy));
+    auto shared = std::vector<Network::Netresult>(2);
+    auto waiters = std::vector<std::thread>{};
+    for (auto& result : shared) {
+        waiters.emplace_back([&game, &result] {
+            EXPECT_TRUE(wait_in_flight(game, result));
+        });
+    }
+    wait_for_waiters(dedup, 2);
+    finish_in_flight(game, &netresult);
+    for (auto& waiter : waiters) {
+        waiter.join();
+    }
+    for (const auto& result : shared) {
+        EXPECT_EQ(netresult.winrate, result.winrate);
+        EXPECT_EQ(netresult.policy, result.policy);
+    }
+
+    // A failed evaluation fails its waiters the same way.
+    dedup = dedup_evals();
+    ASSERT_FALSE(wait_in_flight(game, dummy));
+    auto waiter = std::thread([&game] {
+        auto result = Network::Netresult{};
+        EXPECT_THROW(wait_in_flight(game, result), NetworkHaltException);
+    });
+    wait_for_waiters(dedup, 1);
+    try {
+        throw NetworkHaltException{};
+    } catch (NetworkHaltException&) {
+        finish_in_flight(game, nullptr);
+    }
+    waiter.join();
+
+    // In the opening a symmetric position shares the evaluation, with
+    // the policy mapped to its own orientation.
+    auto mirrored = get_gamestate();
+    mirrored.undo_move();
+    mirrored.play_move(mirrored.board.text_to_move("D16"));
+    dedup = dedup_evals();
+    ASSERT_FALSE(wait_in_flight(game, dummy));
+    auto result = Network::Netresult{};
+    waiter = std::thread([&mirrored, &result] {
+        EXPECT_TRUE(wait_in_flight(mirrored, result));
+    });
+    wait_for_waiters(dedup, 1);
+    finish_in_flight(game, &netresult);
+    waiter.join();
+    EXPECT_EQ(netresult.winrate, result.winrate);
+    EXPECT_EQ(0.5f, result.policy[index("D16")]);
+    EXPECT_EQ(0.0f, result.policy[index("Q16")]);
+}
+
+TEST_F(LeelaTest, PrefetchFillsCache) {
+    testing::internal::CaptureStderr();
+    auto network = std::make_unique<Network>();
+    network->initialize(cfg_max_playouts, "../src/tests/0k.txt");
+    auto& pipe = install_prefetch_pipe(*network);
+    cfg_prefetch = 3;
+
+    // Expanding a node queues its best children.
+    auto& game = get_gamestate();
+    game.play_move(game.board.text_to_move("Q16"));
+    std::atomic<std::int64_t> nodes{0};
+    auto eval = 0.0f;
+    UCTNode root(FastBoard::PASS, 0.0f);
+    ASSERT_TRUE(root.create_children(*network, nodes, game, eval));
+    EXPECT_EQ(3, pipe.queued());
+
+    // Once they ran, the best child comes from the cache and the other
+    // two were for nothing.
+    pipe.run_prefetches();
+    auto child = game;
+    child.play_move(root.get_children()[0].get_move());
+    network->get_output(&child, Network::Ensemble::RANDOM_SYMMETRY);
+    testing::internal::GetCapturedStderr();
+
+    testing::internal::CaptureStderr();
+    network->nncache_dump_stats();
+    expect_regex(testing::internal::GetCapturedStderr(),
+                 "3 prefetches, 1 hits, 2 wasted");
+
+    // Nothing is prepared for a pipe that would not take it.
+    pipe.m_accepts = false;
+    testing::internal::CaptureStderr();
+    UCTNode other(FastBoard::PASS, 0.0f);
+    ASSERT_TRUE(other.create_children(*network, nodes, child, eval));
+    testing::internal::GetCapturedStderr();
+    EXPECT_EQ(0, pipe.queued());
+}
+
+TEST_F(LeelaTest, BookRoundTrip) {
+    // Two stones that leave no symmetry, so each orientation differs.
+    auto& game = get_gamestate();
+    const auto black = game.board.text_to_move("Q16");
+    const auto white = game.board.text_to_move("D3");
+    game.play_move(FastBoard::BLACK, black);
+    game.play_move(FastBoard::WHITE, white);
+
+    cfg_max_playouts = 100;
+    testing::internal::CaptureStderr();
+    ASSERT_TRUE(Book::build(game, *GTP::s_network, "book.bin", 3));
+    testing::internal::GetCapturedStderr();
+
+    {
+        const Book book("book.bin");
+        EXPECT_EQ(1, book.size());
+        Book::Moves expected;
+        ASSERT_TRUE(book.probe(game, expected));
+        EXPECT_LE(expected.visits.size(), Book::MAX_MOVES);
+        for (size_t i = 1; i < expected.visits.size(); i++) {
+            EXPECT_GE(expected.visits[i - 1].second, expected.visits[i].second);
+        }
+
+        // Every orientation finds the same entry, with the moves turned
+        // the same way as the position.  One of them is stored as is, so
+        // this pins down the mapping back from the stored orientation.
+        for (auto sym = 0; sym < Network::NUM_SYMMETRIES; sym++) {
+            auto state = get_gamestate();
+            state.init_game(BOARD_SIZE, game.get_komi());
+            state.play_move(FastBoard::BLACK,
+                            game.board.get_symmetric_vertex(black, sym));
+            state.play_move(FastBoard::WHITE,
+                            game.board.get_symmetric_vertex(white, sym));
+            Book::Moves moves;
+            ASSERT_TRUE(book.probe(state, moves)) << "symmetry " << sym;
+            EXPECT_EQ(expected.winrate, moves.winrate);
+            ASSERT_EQ(expected.visits.size(), moves.visits.size());
+            for (size_t i = 0; i < moves.visits.size(); i++) {
+                const auto vertex = game.board.get_symmetric_vertex(
+                    expected.visits[i].first, sym);
+                EXPECT_EQ(vertex, moves.visits[i].first) << "symmetry " << sym;
+                EXPECT_EQ(expected.visits[i].second, moves.visits[i].second);
+            }
+        }
+
+        // Other positions and other komi are not in the book.
+        Book::Moves moves;
+        auto state = get_gamestate();
+        state.play_move(state.board.text_to_move("K10"));
+        EXPECT_FALSE(book.probe(state, moves));
+        state.undo_move();
+        state.set_komi(0.5f);
+        EXPECT_FALSE(book.probe(state, moves));
+    }
+
+    // A file cut short is refused rather than read past its end.
+    std::string data;
+    {
+        std::ifstream in("book.bin", std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    std::ofstream("book.bin", std::ios::binary)
+        << data.substr(0, data.size() - 1);
+    EXPECT_THROW(Book("book.bin"), std::runtime_error);
+    // So is a count that only matches the size once multiplied out, as
+    // the entries are of an even size.  It follows the magic, version,
+    // board size and komi.
+    constexpr auto COUNT = 4 + 4 + 4 + 4;
+    auto count = std::uint64_t{};
+    std::memcpy(&count, &data[COUNT], sizeof(count));
+    count += std::uint64_t{1} << 63;
+    std::memcpy(&data[COUNT], &count, sizeof(count));
+    std::ofstream("book.bin", std::ios::binary) << data;
+    EXPECT_THROW(Book("book.bin"), std::runtime_error);
+    std::remove("book.bin");
+}
+
+// Stands in for a leelaz serving GTP on a socket.  Answers every command,
+// and while analyzing reports D4 with visits growing from 'visits', as
+// if it had reused a tree with that many.
+// Answers like a worker running lz-analyze.  A hanging one acknowledges
+// lz-analyze and then ignores everything until the connection closes.
+static void fake_worker(boost::asio::ip::tcp::acceptor& acceptor,
+                        std::int64_t visits, const bool hang) {
+    boost::asio::ip::tcp::socket socket(acceptor.get_executor());
+    acceptor.accept(socket);
+    boost::asio::streambuf buffer;
+    std::istream input(&buffer);
+    auto error = boost::system::error_code{};
+    auto write = [&socket, &error](const std::string& text) {
+        boost::asio::write(socket, boost::asio::buffer(text), error);
+    };
+    while (boost::asio::read_until(socket, buffer, '\n', error)) {
+        auto line = std::string{};
+        std::getline(input, line);
+        if (line.empty()) {
+            continue;
+        } else if (line == "1 protocol_version") {
+            write("=1 2\n\n");
+        } else if (line.compare(0, 10, "lz-analyze") == 0) {
+            write("=\n");
+            if (hang) {
+                do {
+                    buffer.consume(buffer.size());
+                } while (boost::asio::read_until(socket, buffer, '\n', error));
+                return;
+            }
+            while (buffer.size() == 0 && socket.available() == 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                visits += 10;
+                write("info move D4 visits " + std::to_string(visits)
+                      + " winrate 6000 prior 1000 order 0 pv D4\n");
+            }
+            write("\n");
+        } else {
+            write("= \n\n");
+        }
+    }
+}
+
+TEST_F(LeelaTest, ConvergeStopsOnlyWhenTimeIsSaved) {
+    // Visits growing in proportion do not diverge at all.
+    EXPECT_GT(UCTSearch::visit_divergence({30, 10, 0}, {60, 20, 20}), 0.0);
+    EXPECT_DOUBLE_EQ(UCTSearch::visit_divergence({30, 10}, {60, 20}), 0.0);
+    EXPECT_DOUBLE_EQ(UCTSearch::visit_divergence({30, 10}, {30, 10}), 0.0);
+    const auto p_old = std::vector<double>{0.75, 0.25};
+    const auto p_new = std::vector<double>{0.5, 0.5};
+    const auto expected = (p_old[0] * std::log(p_old[0] / p_new[0])
+                           + p_old[1] * std::log(p_old[1] / p_new[1]))
+                          / 40;
+    EXPECT_DOUBLE_EQ(UCTSearch::visit_divergence({30, 10}, {40, 40}),
+                     expected);
+
+    cfg_timemanage = TimeManagement::CONVERGE;
+    cfg_kl_threshold = 1.0f;
+    auto& game = get_gamestate();
+    testing::internal::CaptureStderr();
+    {
+        // Without a playout limit the saved time goes to later moves.
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(UCTSearch::UNLIMITED_PLAYOUTS);
+        search->set_visit_limit(1000);
+        search->think(FastBoard::BLACK);
+        EXPECT_LT(search->get_root().get_visits(), 1000);
+    }
+    {
+        // A playout limit cannot be saved up, so the search uses it all.
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(400);
+        search->think(FastBoard::BLACK);
+        EXPECT_GE(search->get_root().get_visits(), 400);
+    }
+    testing::internal::GetCapturedStderr();
+}
+
+TEST_F(LeelaTest, FastSearchSkipsNoiseAndTraining) {
+    cfg_noise = true;
+    cfg_fast_visits = 50;
+    auto& game = get_gamestate();
+    game.play_move(game.board.text_to_move("Q16"));
+    Training::clear_training();
+
+    auto root_policies = [](const UCTNode& root) {
+        auto policies = std::map<int, float>{};
+        for (const auto& child : root.get_children()) {
+            policies[child.get_move()] = child.get_policy();
+        }
+        return policies;
+    };
+    testing::internal::CaptureStderr();
+    auto clean = std::map<int, float>{};
+    {
+        // The root policies straight from the (cached) network.
+        cfg_noise = false;
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(1);
+        search->think(FastBoard::WHITE);
+        clean = root_policies(search->get_root());
+        cfg_noise = true;
+    }
+    Training::clear_training();
+    {
+        // A full search adds noise and is recorded.
+        cfg_full_search_prob = 1.0f;
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(1);
+        search->think(FastBoard::WHITE);
+        EXPECT_NE(clean, root_policies(search->get_root()));
+        EXPECT_EQ(training_records(), 1);
+    }
+    Training::clear_training();
+    {
+        // A fast search stops at the fast visits, without either.
+        cfg_full_search_prob = 0.0f;
+        auto search = std::make_unique<UCTSearch>(game, *GTP::s_network);
+        search->set_playout_limit(1000);
+        search->think(FastBoard::WHITE);
+        EXPECT_GT(search->get_root().get_visits(), 0);
+        EXPECT_LE(search->get_root().get_visits(), cfg_fast_visits);
+        EXPECT_EQ(clean, root_policies(search->get_root()));
+        EXPECT_EQ(training_records(), 0);
+    }
+    testing::internal::GetCapturedStderr();
+    Training::clear_training();
+}
+
+TEST_F(LeelaTest, CoordinatorMergesWorkerVisits) {
+    constexpr auto REUSED_VISITS = 100000;
+
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor(
+        io, {boost::asio::ip::address_v4::loopback(), 0});
+    auto worker =
+        std::thread(fake_worker, std::ref(acceptor), REUSED_VISITS, false);
+
+    auto& game = get_gamestate();
+    game.play_move(game.board.text_to_move("Q16"));
+    game.play_move(game.board.text_to_move("C3"));
+    std::atomic<std::int64_t> nodes{0};
+    UCTNode root(FastBoard::PASS, 0.0f);
+    root.prepare_root_node(*GTP::s_network, FastBoard::BLACK, nodes, game,
+                           false);
+    const auto d4 = game.board.text_to_move("D4");
+    auto child_visits = [&root, d4]() {
+        for (const auto& child : root.get_children()) {
+            if (child.get_move() == d4) {
+                return child.get_visits();
+            }
+        }
+        return std::int64_t{0};
+    };
+
+    {
+        Coordinator coordinator(
+            "127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()));
+        for (auto search = 0; search < 2; search++) {
+            // The first report only sets the baseline, wait for visits
+            // from the ones after it however long the worker takes.
+            const auto before = child_visits();
+            const auto deadline =
+                std::chrono::steady_clock::now() + std::chrono::seconds(10);
+            coordinator.start(game);
+            for (auto i = 0;
+                 i < 10
+                 || (child_visits() == before
+                     && std::chrono::steady_clock::now() < deadline);
+                 i++) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                coordinator.merge(game, root);
+            }
+            coordinator.stop();
+            coordinator.merge(game, root);
+
+            // Only what the worker searched since it started counts.
+            EXPECT_GT(child_visits(), before);
+            EXPECT_LT(child_visits(), REUSED_VISITS);
+        }
+    }
+    worker.join();
+
+    for (const auto& child : root.get_children()) {
+        if (child.get_move() == d4) {
+            EXPECT_NEAR(0.6f, child->get_raw_eval(FastBoard::BLACK), 1e-3);
+        }
+    }
+}
+
+TEST_F(LeelaTest, CoordinatorDropsHungWorker) {
+    boost::asio::io_context io;
+    boost::asio::ip::tcp::acceptor acceptor(
+        io, {boost::asio::ip::address_v4::loopback(), 0});
+    auto worker = std::thread(fake_worker, std::ref(acceptor), 0, true);
+
+    auto& game = get_gamestate();
+    const auto began = std::chrono::steady_clock::now();
+    {
+        Coordinator coordinator(
+            "127.0.0.1:" + std::to_string(acceptor.local_endpoint().port()),
+            std::chrono::milliseconds(200));
+        coordinator.start(game);
+        coordinator.stop();
+        // A lost worker is not asked again.
+        coordinator.start(game);
+        coordinator.stop();
+    }
+    worker.join();
+    EXPECT_LT(std::chrono::steady_clock::now() - began,
+              std::chrono::seconds(5));
+}
+
+// NUMA placement benchmark, run with
+// --gtest_also_run_disabled_tests --gtest_filter=*NumaScaling*
+// Runs the same number of evaluation threads packed on one node and spread
+// over all nodes, with the weights replicated per node as with --numa.
+TEST_F(LeelaTest, DISABLED_NumaScaling) {
+    constexpr auto EVALS_PER_THREAD = 200;
+
+    const auto numa = cfg_numa;
+    cfg_numa = true;
+    Network network;
+    network.initialize(1, "../src/tests/0k.txt");
+
+    const auto nodes = SMP::get_num_numa_nodes();
+    const auto threads = std::max(SMP::get_num_cpus() / nodes, size_t{1});
+    const auto& state = get_gamestate();
+
+    auto layouts = std::vector<size_t>{1};
+    if (nodes > 1) {
+        layouts.push_back(nodes);
+    }
+    for (const auto used_nodes : layouts) {
+        Utils::ThreadPool pool;
+        for (auto i = size_t{0}; i < threads; i++) {
+            const auto node = i * used_nodes / threads;
+            pool.add_thread([node] { SMP::bind_to_numa_node(node); });
+        }
+
+        const Time start;
+        Utils::ThreadGroup tg(pool);
+        for (auto i = size_t{0}; i < threads; i++) {
+            tg.add_pinned_task(i, [&network, &state] {
+                for (auto j = 0; j < EVALS_PER_THREAD; j++) {
+                    network.get_output(&state, Network::DIRECT,
+                                       j % Network::NUM_SYMMETRIES, false,
+                                       false);
+                }
+            });
+        }
+        tg.wait_all();
+        const Time end;
+
+        const auto elapsed = Time::timediff_seconds(start, end);
+        std::cout << threads << " thread(s) on " << used_nodes << "/" << nodes
+                  << " node(s): " << threads * EVALS_PER_THREAD / elapsed
+                  << " evals/s" << std::endl;
+    }
+    cfg_numa = numa;
+}
+
+TEST(PlayoutRateModelTest, UpdateAndFallbacks) {
+    // Move 10 is early in the game, 100 the middle and 300 the end.
+    PlayoutRateModel model;
+    EXPECT_EQ(0.0f, model.get_rate(19, 10, 0.0f));
+    model.update(19, 10, 0.0f, 0, 100);
+    model.update(19, 10, 0.0f, 1000, 0);
+    EXPECT_EQ(0.0f, model.get_rate(19, 10, 0.0f));
+
+    model.update(19, 10, 0.0f, 1000, 100);
+    EXPECT_FLOAT_EQ(10.0f, model.get_rate(19, 10, 0.0f));
+    // Other amounts of reuse and other phases fall back to what is known.
+    EXPECT_FLOAT_EQ(10.0f, model.get_rate(19, 10, 0.9f));
+    EXPECT_FLOAT_EQ(10.0f, model.get_rate(19, 300, 0.0f));
+
+    model.update(19, 10, 0.9f, 3000, 100);
+    EXPECT_FLOAT_EQ(10.0f, model.get_rate(19, 10, 0.0f));
+    EXPECT_FLOAT_EQ(30.0f, model.get_rate(19, 10, 0.9f));
+    // Without a sample of its own, a bucket takes the phase's average
+    // weighed by search time.
+    EXPECT_FLOAT_EQ(20.0f, model.get_rate(19, 10, 0.4f));
+
+    model.update(19, 100, 0.0f, 10000, 200);
+    EXPECT_FLOAT_EQ(50.0f, model.get_rate(19, 100, 0.9f));
+    // Nothing for the phase at all, so the whole game counts.
+    EXPECT_FLOAT_EQ(35.0f, model.get_rate(19, 300, 0.0f));
+
+    // Older samples lose weight.
+    model.update(19, 10, 0.0f, 2000, 100);
+    EXPECT_FLOAT_EQ((10.0f * 80 + 2000) / 180, model.get_rate(19, 10, 0.0f));
+}
+
+TEST(UCTNodeTest, UpdateStatistics) {
+    const auto evals = std::vector<float>{0.5f, 0.25f, 0.875f, 0.1f, 0.6f};
+
+    UCTNode node(FastBoard::PASS, 1.0f);
+    auto sum = 0.0;
+    for (const auto eval : evals) {
+        node.update(eval);
+        sum += eval;
+    }
+    const auto mean = sum / evals.size();
+    auto squared_diff = 1e-4;
+    for (const auto eval : evals) {
+        squared_diff += (eval - mean) * (eval - mean);
+    }
+
+    EXPECT_EQ(node.get_visits(), 5);
+    EXPECT_NEAR(node.get_raw_eval(FastBoard::BLACK), mean, 1e-6);
+    EXPECT_NEAR(node.get_raw_eval(FastBoard::WHITE), 1.0 - mean, 1e-6);
+    EXPECT_NEAR(node.get_eval_variance(), squared_diff / 4, 1e-6);
+
+    // Virtual losses count as visits lost for the side to move.
+    node.virtual_loss();
+    EXPECT_EQ(node.get_visits(), 5);
+    const auto with_loss = sum / (5 + UCTNode::VIRTUAL_LOSS_COUNT);
+    EXPECT_NEAR(node.get_eval(FastBoard::BLACK), with_loss, 1e-6);
+    node.virtual_loss_undo();
+    EXPECT_NEAR(node.get_eval(FastBoard::BLACK), mean, 1e-6);
+}
+
+TEST(UCTNodeTest, VisitsPastIntMax) {
+    const auto many = std::int64_t{std::numeric_limits<int>::max()};
+
+    UCTNode node(FastBoard::PASS, 1.0f);
+    node.add_visits(many, 0.75f);
+    node.update(0.75f);
+    node.update(0.75f);
+
+    EXPECT_EQ(node.get_visits(), many + 2);
+    EXPECT_NEAR(node.get_raw_eval(FastBoard::BLACK), 0.75, 1e-6);
+    EXPECT_NEAR(node.get_eval_variance(), 0.0, 1e-6);
+    node.virtual_loss();
+    EXPECT_EQ(node.get_visits(), many + 2);
+    node.virtual_loss_undo();
+    EXPECT_EQ(node.get_visits(), many + 2);
+}
+
+TEST(UCTNodeTest, LazyChildren) {
+    auto nodelist = std::vector<Network::PolicyVertexPair>{};
+    for (auto i = 0; i < 100; i++) {
+        nodelist.emplace_back(1.0f - i / 100.0f, i);
+    }
+    const auto tree_size = UCTNodePointer::get_tree_size();
+    {
+        UCTNodeChildren children;
+        children.add(begin(nodelist), begin(nodelist) + 50);
+        EXPECT_EQ(0, children.size());
+        EXPECT_EQ(50, children.total_size());
+
+        // Materializing a child makes all better ones exist too, and the
+        // segments they live in don't move.
+        const auto first = &children.materialize(0);
+        const auto twentieth = &children.materialize(20);
+        EXPECT_EQ(twentieth, &children[20]);
+        EXPECT_EQ(21, children.size());
+        EXPECT_EQ(first, &children[0]);
+        children.add(begin(nodelist) + 50, end(nodelist));
+        EXPECT_EQ(100, children.total_size());
+        EXPECT_FLOAT_EQ(nodelist[21].first, children.policy(21));
+
+        // Reordering the materialized children leaves the others alone.
+        std::reverse(children.begin(), children.end());
+        EXPECT_EQ(21, children.vertex(21));
+        children.materialize_all();
+        auto vertex = 0;
+        for (const auto& child : children) {
+            EXPECT_EQ(vertex < 21 ? 20 - vertex : vertex, child.get_move());
+            vertex++;
+        }
+        EXPECT_EQ(100, vertex);
+
+        children.erase(children.begin() + 10, children.end());
+        EXPECT_EQ(10, children.size());
+        EXPECT_EQ(10, children.total_size());
+        EXPECT_GT(UCTNodePointer::get_tree_size(), tree_size);
+    }
+    EXPECT_EQ(tree_size, UCTNodePointer::get_tree_size());
+}
+
+// Backup contention benchmark, run with
+// --gtest_also_run_disabled_tests --gtest_filter=*BackupScaling*
+// Every thread repeatedly does what a playout does to the root and one of
+// a few top children, which is where all the search threads collide.
+TEST(UCTNodeTest, DISABLED_BackupScaling) {
+    constexpr auto BACKUPS_PER_THREAD = 200'000;
+    constexpr auto CHILDREN = 4;
+
+    for (auto threads = 1; threads <= 128; threads *= 2) {
+        UCTNode root(FastBoard::PASS, 1.0f);
+        std::vector<std::unique_ptr<UCTNode>> children;
+        for (auto i = 0; i < CHILDREN; i++) {
+            children.emplace_back(std::make_unique<UCTNode>(i, 0.25f));
+        }
+
+        const Time start;
+        std::vector<std::thread> workers;
+        for (auto t = 0; t < threads; t++) {
+            workers.emplace_back([&root, &children, t] {
+                auto& child = *children[t % CHILDREN];
+                for (auto i = 0; i < BACKUPS_PER_THREAD; i++) {
+                    child.virtual_loss();
+                    child.get_eval(FastBoard::BLACK);
+                    child.update(0.5f);
+                    child.virtual_loss_undo();
+                    root.update(0.5f);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        const Time end;
+
+        EXPECT_EQ(root.get_visits(), threads * BACKUPS_PER_THREAD);
+        const auto elapsed = Time::timediff_seconds(start, end);
+        std::cout << threads << " thread(s): "
+                  << threads * BACKUPS_PER_THREAD / elapsed / 1e6
+                  << " M backups/s" << std::endl;
+    }
+}
+
+// Board update microbenchmark, run with
+// --gtest_also_run_disabled_tests --gtest_filter=*RandomPlayouts*
+// Plays uniformly random legal moves that don't fill own eyes until both
+// sides pass, and scores the final position.
+TEST(FastStateTest, DISABLED_RandomPlayouts) {
+    constexpr auto PLAYOUTS = 2000;
+    auto rng = Random{42};
+
+    auto moves = size_t{0};
+    auto score = 0.0f;
+    const Time start;
+    for (auto i = 0; i < PLAYOUTS; i++) {
+        auto state = FastState{};
+        state.init_game(BOARD_SIZE, KOMI);
+        while (state.get_passes() < 2
+               && state.get_movenum() < 3 * NUM_INTERSECTIONS) {
+            state.play_move(random_move(state, rng));
+        }
+        moves += state.get_movenum();
+        score += state.final_score();
+    }
+    const Time end;
+
+    const auto elapsed = Time::timediff_seconds(start, end);
+    std::cout << PLAYOUTS / elapsed << " playouts/s, "
+              << moves / elapsed / 1e6 << " M moves/s, mean score "
+              << score / PLAYOUTS << std::endl;
+}
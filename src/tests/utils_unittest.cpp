@@ -27,13 +27,20 @@
     work.
 */
 
+#include <atomic>
 #include <boost/math/distributions/chi_squared.hpp>
+#include <chrono>
 #include <cstddef>
 #include <gtest/gtest.h>
+#include <iostream>
 #include <limits>
+#include <stdexcept>
+#include <thread>
 #include <vector>
 
 #include "Random.h"
+#include "ThreadPool.h"
+#include "Timing.h"
 #include "Utils.h"
 
 // Test should fail about this often from distribution not looking uniform.
@@ -140,3 +147,90 @@ TEST(UtilsTest, Randuint64_max) {
     auto p = randomlyDistributedProbability(count, expected);
     EXPECT_PRED2(rngBucketsLookRandom, p, ALPHA);
 }
+
+TEST(UtilsTest, ThreadPoolRunsAllTasks) {
+    Utils::ThreadPool pool;
+    pool.initialize(4);
+
+    std::atomic<int> count{0};
+    Utils::ThreadGroup tg(pool);
+    for (auto i = 0; i < 10000; i++) {
+        tg.add_task([&count]() { count++; });
+    }
+    // Tasks queued from inside the pool go to the local deque and
+    // must still be picked up.
+    for (auto i = size_t{0}; i < 4; i++) {
+        tg.add_task_on(i, [&pool, &count]() {
+            Utils::ThreadGroup inner(pool);
+            for (auto j = 0; j < 100; j++) {
+                inner.add_task([&count]() { count++; });
+            }
+            inner.wait_all();
+        });
+    }
+    tg.wait_all();
+    EXPECT_EQ(count.load(), 10400);
+
+    auto result = pool.add_task([](int x) { return x * 2; }, 21);
+    EXPECT_EQ(result.get(), 42);
+}
+
+TEST(UtilsTest, PinnedTasksAreNotStolen) {
+    constexpr auto THREADS = size_t{4};
+    constexpr auto TASKS = 100;
+
+    Utils::ThreadPool pool;
+    pool.initialize(THREADS);
+    std::atomic<int> misplaced{0};
+    std::atomic<int> done{0};
+    Utils::ThreadGroup tg(pool);
+    for (auto i = 0; i < TASKS; i++) {
+        // Everything queued on worker 0, so the others go stealing.
+        tg.add_pinned_task(0, [&pool, &misplaced, &done] {
+            if (pool.current_thread() != 0) {
+                misplaced++;
+            }
+            done++;
+        });
+        tg.add_task_on(0, [] {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        });
+    }
+    tg.wait_all();
+    EXPECT_EQ(misplaced, 0);
+    EXPECT_EQ(done, TASKS);
+}
+
+TEST(UtilsTest, ThreadGroupPropagatesException) {
+    Utils::ThreadPool pool;
+    pool.initialize(2);
+
+    Utils::ThreadGroup tg(pool);
+    tg.add_task([]() { throw std::runtime_error("task failed"); });
+    tg.add_task([]() {});
+    EXPECT_THROW(tg.wait_all(), std::runtime_error);
+}
+
+// Scheduling overhead microbenchmark, run with
+// --gtest_also_run_disabled_tests --gtest_filter=*ThreadPoolOverhead*
+TEST(UtilsTest, DISABLED_ThreadPoolOverhead) {
+    constexpr auto TASKS = 1'000'000;
+    for (auto threads : {1, 2, 4, 8}) {
+        Utils::ThreadPool pool;
+        pool.initialize(threads);
+
+        std::atomic<int> count{0};
+        const Time start;
+        Utils::ThreadGroup tg(pool);
+        for (auto i = 0; i < TASKS; i++) {
+            tg.add_task([&count]() { count++; });
+        }
+        tg.wait_all();
+        const Time end;
+
+        EXPECT_EQ(count.load(), TASKS);
+        const auto elapsed = Time::timediff_seconds(start, end);
+        std::cout << threads << " thread(s): " << 1e9 * elapsed / TASKS
+                  << " ns/task" << std::endl;
+    }
+}